@@ -9,8 +9,13 @@
 #include "log.h"
 #include "spa-pod.h"
 #include "proxy.h"
+#include "error.h"
 #include <pipewire/pipewire.h>
 #include <spa/support/log.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
 
 /*!
  * \defgroup wplog Debug Logging
@@ -164,6 +169,12 @@
  * \brief The generic form of all the logging macros
  * \remark Don't use this directly, use one of the other logging macros
  */
+/*!
+ * \struct WpLogCallSite
+ * \brief The per-call-site state of the logging macros, which caches
+ *   whether the category (log domain) of the call site is enabled and the
+ *   log domain as a GQuark, for the flight recorder
+ */
 /*! \} */
 
 static GString *spa_dbg_str = NULL;
@@ -181,6 +192,13 @@ static gboolean output_is_journal = FALSE;
 static GPatternSpec **enabled_categories = NULL;
 static gint enabled_level = 4; /* MESSAGE */
 
+/* enabled_categories and the verdicts that were computed from them for each
+   log domain; the generation is increased every time they are reconfigured,
+   invalidating the verdicts that are cached in the call sites */
+static GRWLock categories_lock;
+static GHashTable *category_verdicts = NULL;
+static gint categories_generation = 1;
+
 struct common_fields
 {
   const gchar *log_domain;
@@ -405,6 +423,8 @@ wp_log_set_level (const gchar * level_str)
   gchar **tokens = NULL;
   gchar **categories = NULL;
 
+  g_rw_lock_writer_lock (&categories_lock);
+
   /* reset to defaults */
   enabled_level = 4; /* MESSAGE */
   if (enabled_categories) {
@@ -413,6 +433,7 @@ wp_log_set_level (const gchar * level_str)
       g_pattern_spec_free (*pspec);
     g_clear_pointer (&enabled_categories, g_free);
   }
+  g_clear_pointer (&category_verdicts, g_hash_table_unref);
 
   if (level_str && level_str[0] != '\0') {
     /* level:category1,category2 */
@@ -433,9 +454,16 @@ wp_log_set_level (const gchar * level_str)
       for (gint i = 0; i < n_tokens; i++)
         enabled_categories[i] = g_pattern_spec_new (categories[i]);
       enabled_categories[n_tokens] = NULL;
+
+      category_verdicts = g_hash_table_new_full (g_str_hash, g_str_equal,
+          g_free, NULL);
     }
   }
 
+  /* invalidate the verdicts cached in the call sites */
+  g_atomic_int_inc (&categories_generation);
+  g_rw_lock_writer_unlock (&categories_lock);
+
   /* set the log level also on the spa_log */
   wp_spa_log_get_instance()->level = level_index_to_spa (enabled_level);
 
@@ -446,19 +474,15 @@ wp_log_set_level (const gchar * level_str)
 }
 
 static gboolean
-is_category_enabled(const gchar *log_domain)
+match_category (const gchar *log_domain)
 {
   GPatternSpec **cat = enabled_categories;
   guint len;
   g_autofree gchar *reverse_domain = NULL;
 
-  if (!enabled_categories)
-    return true;
-
   len = strlen (log_domain);
   reverse_domain = g_strreverse (g_strndup (log_domain, len));
 
-  cat = enabled_categories;
   while (*cat && !g_pattern_match (*cat, len, log_domain, reverse_domain))
     cat++;
 
@@ -466,6 +490,662 @@ is_category_enabled(const gchar *log_domain)
   return (*cat != NULL);
 }
 
+static gboolean
+is_category_enabled (const gchar *log_domain)
+{
+  gpointer verdict = GINT_TO_POINTER (TRUE);
+  gboolean found = TRUE;
+
+  /* the patterns are matched only the first time a domain is seen */
+  g_rw_lock_reader_lock (&categories_lock);
+  if (category_verdicts)
+    found = g_hash_table_lookup_extended (category_verdicts, log_domain,
+        NULL, &verdict);
+  g_rw_lock_reader_unlock (&categories_lock);
+
+  if (G_UNLIKELY (!found)) {
+    g_rw_lock_writer_lock (&categories_lock);
+    if (category_verdicts &&
+        !g_hash_table_lookup_extended (category_verdicts, log_domain,
+            NULL, &verdict)) {
+      verdict = GINT_TO_POINTER (match_category (log_domain));
+      g_hash_table_insert (category_verdicts, g_strdup (log_domain), verdict);
+    }
+    g_rw_lock_writer_unlock (&categories_lock);
+  }
+
+  return GPOINTER_TO_INT (verdict);
+}
+
+/*
+ * Flight recorder
+ *
+ * A ring of fixed-size binary records that captures the messages of the
+ * logging macros, wp_log_structured_standard() and spa_log up to a configured
+ * level, in all categories, without writing them anywhere, so that recent
+ * activity can be dumped on demand. Messages are truncated to fit in the
+ * record; nothing is allocated.
+ */
+
+#define FLIGHT_RECORD_MESSAGE_SIZE 104
+
+struct flight_record
+{
+  gint seq;           /* position + 1 of the record; 0 while being written */
+  gint level;         /* index in log_level_info */
+  GQuark domain;
+  gint64 time;
+  GType object_type;
+  gconstpointer object;
+  gchar message[FLIGHT_RECORD_MESSAGE_SIZE];
+};
+
+static struct {
+  struct flight_record *records;
+  guint size;          /* a power of 2 */
+  gint pos;
+  gint level;          /* the highest recorded level index; -1 if inactive */
+} flight_recorder = { .level = -1 };
+
+static inline gboolean
+flight_recorder_wants (gint level)
+{
+  return level <= g_atomic_int_get (&flight_recorder.level);
+}
+
+static G_GNUC_PRINTF (5, 0) void
+flight_recorder_add (GQuark domain, gint level,
+    GType object_type, gconstpointer object,
+    const gchar *message_format, va_list args)
+{
+  struct flight_record *records = g_atomic_pointer_get (&flight_recorder.records);
+  guint pos = g_atomic_int_add (&flight_recorder.pos, 1);
+  struct flight_record *rec = &records[pos & (flight_recorder.size - 1)];
+
+  g_atomic_int_set (&rec->seq, 0);
+  rec->level = level;
+  rec->domain = domain;
+  rec->time = g_get_real_time ();
+  rec->object_type = object_type;
+  rec->object = object;
+  g_vsnprintf (rec->message, sizeof (rec->message), message_format, args);
+  g_atomic_int_set (&rec->seq, (gint) (pos + 1));
+}
+
+/*!
+ * \brief Starts the flight recorder
+ *
+ * The flight recorder keeps the last \a n_records log messages up to
+ * \a max_level in memory, in all categories, regardless of what is enabled for
+ * output, so that they can be written to a file with
+ * wp_log_flight_recorder_dump() when something goes wrong. Messages are kept
+ * in a compact form and truncated to about 100 characters. Messages up to
+ * \a max_level are formatted even if their category is not enabled for output;
+ * messages above it cost only a level comparison, as when the recorder is
+ * inactive.
+ *
+ * It can be started only once and stays active for the lifetime of the
+ * process.
+ *
+ * \ingroup wplog
+ * \param n_records the number of records to keep; rounded up to a power of 2
+ * \param max_level the most verbose level to record, ex. G_LOG_LEVEL_DEBUG
+ * \returns TRUE if the recorder was started, FALSE if it was already active
+ */
+gboolean
+wp_log_flight_recorder_start (guint n_records, GLogLevelFlags max_level)
+{
+  guint size = 1;
+
+  g_return_val_if_fail (n_records > 0, FALSE);
+
+  if (wp_log_flight_recorder_is_active ())
+    return FALSE;
+
+  while (size < n_records)
+    size <<= 1;
+
+  flight_recorder.size = size;
+  if (!g_atomic_pointer_compare_and_exchange (&flight_recorder.records,
+          NULL, g_new0 (struct flight_record, size)))
+    return FALSE;
+
+  /* the level enables recording, so it is set after the records exist */
+  g_atomic_int_set (&flight_recorder.level, log_level_index (max_level));
+  return TRUE;
+}
+
+/*!
+ * \brief Checks if the flight recorder is active
+ * \ingroup wplog
+ * \returns whether wp_log_flight_recorder_start() was called
+ */
+gboolean
+wp_log_flight_recorder_is_active (void)
+{
+  return g_atomic_pointer_get (&flight_recorder.records) != NULL;
+}
+
+/*!
+ * \brief Writes the records of the flight recorder to a file, as text,
+ *   from the oldest to the newest
+ *
+ * \ingroup wplog
+ * \param filename the file to write to; it is overwritten if it exists
+ * \param error (out) (optional): the error that occurred, if any
+ * \returns TRUE on success, FALSE if the recorder is not active or the file
+ *   could not be written
+ */
+gboolean
+wp_log_flight_recorder_dump (const gchar * filename, GError ** error)
+{
+  struct flight_record *records =
+      g_atomic_pointer_get (&flight_recorder.records);
+  g_autoptr (GString) str = NULL;
+  guint end, start;
+
+  if (!records) {
+    g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVARIANT,
+        "the flight recorder is not active");
+    return FALSE;
+  }
+
+  end = g_atomic_int_get (&flight_recorder.pos);
+  start = end > flight_recorder.size ? end - flight_recorder.size : 0;
+  str = g_string_sized_new ((end - start) * 160);
+
+  for (guint pos = start; pos != end; pos++) {
+    struct flight_record *slot = &records[pos & (flight_recorder.size - 1)];
+    struct flight_record copy;
+    struct flight_record *rec = &copy;
+    gchar time_buf[128];
+    time_t secs;
+    struct tm tm;
+
+    /* skip records that are being written or were overwritten meanwhile;
+       the sequence is checked again after copying, as a writer may have
+       started overwriting the record while it was being copied */
+    if ((guint) g_atomic_int_get (&slot->seq) != pos + 1)
+      continue;
+    memcpy (&copy, slot, sizeof (copy));
+    if ((guint) g_atomic_int_get (&slot->seq) != pos + 1)
+      continue;
+    copy.message[sizeof (copy.message) - 1] = '\0';
+
+    secs = (time_t) (rec->time / G_USEC_PER_SEC);
+    localtime_r (&secs, &tm);
+    strftime (time_buf, sizeof (time_buf), "%H:%M:%S", &tm);
+
+    g_string_append_printf (str, "%s %s.%06d %18.18s ",
+        log_level_info[rec->level].name, time_buf,
+        (gint) (rec->time % G_USEC_PER_SEC),
+        g_quark_to_string (rec->domain));
+    if (rec->object_type)
+      g_string_append_printf (str, "<%s:%p> ",
+          g_type_name (rec->object_type), rec->object);
+    g_string_append (str, rec->message);
+    g_string_append_c (str, '\n');
+  }
+
+  return g_file_set_contents (filename, str->str, str->len, error);
+}
+
+/* the verdict about the category of the call site, cached in its state
+   together with the generation it was computed in */
+static inline gboolean
+call_site_category_is_enabled (WpLogCallSite * site, const gchar * log_domain)
+{
+  gint generation = g_atomic_int_get (&categories_generation);
+  gint state = g_atomic_int_get (&site->state);
+  gboolean enabled;
+
+  if (G_LIKELY ((state >> 1) == generation))
+    return state & 1;
+
+  enabled = is_category_enabled (log_domain ? log_domain : "default");
+  g_atomic_int_set (&site->state, (generation << 1) | (enabled ? 1 : 0));
+  return enabled;
+}
+
+/*!
+ * \brief Used internally by the debug logging macros to figure out if the
+ * call site should log a message. Avoid using it directly.
+ *
+ * The level is checked first; the verdict about the category of the call site
+ * is cached in \a site, so that it is computed only once per call site, until
+ * the enabled categories are changed with wp_log_set_level(). Messages up to
+ * the level of the flight recorder are accepted in all categories.
+ *
+ * \ingroup wplog
+ * \param site the call site
+ * \param log_level the log level of the message
+ * \param log_domain the log domain of the call site
+ * \returns whether messages from this call site should be logged
+ */
+gboolean
+wp_log_call_site_is_enabled (WpLogCallSite * site, GLogLevelFlags log_level,
+    const gchar * log_domain)
+{
+  gint level = log_level_index (log_level);
+
+  if (G_UNLIKELY (flight_recorder_wants (level)))
+    return TRUE;
+
+  return level <= enabled_level &&
+      call_site_category_is_enabled (site, log_domain);
+}
+
+/*
+ * Asynchronous output
+ *
+ * When WIREPLUMBER_LOG_ASYNC is set, the writer formats the records on the
+ * calling thread and pushes them to a lock-free ring buffer, which is drained
+ * by a dedicated thread that does the actual (potentially slow) writing to
+ * stderr or the journal. The ring is a bounded multi-producer queue (based on
+ * Dmitry Vyukov's design) with a single consumer: the writer thread or, after
+ * it has stopped the writer thread from popping, the crash handler.
+ */
+
+#define LOG_RING_SIZE 4096 /* must be a power of 2 */
+
+typedef enum {
+  LOG_OVERFLOW_DROP,
+  LOG_OVERFLOW_BLOCK,
+} LogOverflowPolicy;
+
+struct log_record
+{
+  GLogLevelFlags log_level;
+  gchar *line;        /* formatted line, for stderr */
+  GLogField *fields;  /* a copy of the fields, for the journal */
+  gsize n_fields;
+  const gchar *text;  /* what the crash handler writes: the line or
+                         the message of the fields */
+  gsize text_len;
+};
+
+struct log_slot
+{
+  gint seq;
+  struct log_record *record;
+};
+
+static struct {
+  struct log_slot slots[LOG_RING_SIZE];
+  gint enqueue_pos;
+  gint dequeue_pos;
+
+  LogOverflowPolicy overflow;
+  gint n_dropped;
+  gint n_pushed;
+  gint n_written;
+
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  gint writer_sleeping;
+  gint n_waiting;
+
+  /* set by the crash handler, which then waits until writer_popping is unset
+     to become the only consumer */
+  gint stopped;
+  gint writer_popping;
+} log_ring;
+
+static gboolean use_async = FALSE;
+
+static gboolean
+log_ring_push (struct log_record *record)
+{
+  guint pos = g_atomic_int_get (&log_ring.enqueue_pos);
+  struct log_slot *slot;
+
+  for (;;) {
+    gint diff;
+    slot = &log_ring.slots[pos & (LOG_RING_SIZE - 1)];
+    diff = (gint) ((guint) g_atomic_int_get (&slot->seq) - pos);
+
+    if (diff == 0) {
+      if (g_atomic_int_compare_and_exchange (&log_ring.enqueue_pos,
+              (gint) pos, (gint) (pos + 1)))
+        break;
+      pos = g_atomic_int_get (&log_ring.enqueue_pos);
+    } else if (diff < 0) {
+      return FALSE; /* full */
+    } else {
+      pos = g_atomic_int_get (&log_ring.enqueue_pos);
+    }
+  }
+
+  slot->record = record;
+  g_atomic_int_set (&slot->seq, (gint) (pos + 1));
+  return TRUE;
+}
+
+static struct log_record *
+log_ring_pop (void)
+{
+  guint pos = g_atomic_int_get (&log_ring.dequeue_pos);
+  struct log_slot *slot;
+  struct log_record *record;
+
+  for (;;) {
+    gint diff;
+    slot = &log_ring.slots[pos & (LOG_RING_SIZE - 1)];
+    diff = (gint) ((guint) g_atomic_int_get (&slot->seq) - (pos + 1));
+
+    if (diff == 0) {
+      if (g_atomic_int_compare_and_exchange (&log_ring.dequeue_pos,
+              (gint) pos, (gint) (pos + 1)))
+        break;
+      pos = g_atomic_int_get (&log_ring.dequeue_pos);
+    } else if (diff < 0) {
+      return NULL; /* empty */
+    } else {
+      pos = g_atomic_int_get (&log_ring.dequeue_pos);
+    }
+  }
+
+  record = slot->record;
+  g_atomic_int_set (&slot->seq, (gint) (pos + LOG_RING_SIZE));
+  return record;
+}
+
+static gboolean
+log_ring_is_empty (void)
+{
+  guint pos = g_atomic_int_get (&log_ring.dequeue_pos);
+  struct log_slot *slot = &log_ring.slots[pos & (LOG_RING_SIZE - 1)];
+  return (gint) ((guint) g_atomic_int_get (&slot->seq) - (pos + 1)) < 0;
+}
+
+/* wakes up the writer thread, the producers that wait for space and
+   the threads that wait for a flush */
+static void
+log_ring_wake_up (void)
+{
+  g_mutex_lock (&log_ring.lock);
+  g_cond_broadcast (&log_ring.cond);
+  g_mutex_unlock (&log_ring.lock);
+}
+
+static inline gsize
+field_value_size (const GLogField *field)
+{
+  if (field->length >= 0)
+    return field->length;
+  return field->value ? strlen (field->value) + 1 : 1;
+}
+
+static struct log_record *
+log_record_new (GLogLevelFlags log_level, struct common_fields *cf,
+    const GLogField *fields, gsize n_fields)
+{
+  struct log_record *record;
+
+  if (!output_is_journal) {
+    /* format on the calling thread, so that the timestamp is accurate */
+    FILE *s;
+    gchar *line = NULL;
+    gsize size = 0;
+
+    if (!(s = open_memstream (&line, &size)))
+      return NULL;
+    write_debug_message (s, cf);
+    fclose (s);
+
+    record = g_new0 (struct log_record, 1);
+    record->line = line;
+    record->text = line;
+    record->text_len = size;
+  } else {
+    /* copy the fields and their data in a single allocation; values are
+       kept aligned, as some of them are read as GType or pointers */
+    gsize data_size = 0;
+    guint8 *data;
+
+    for (gsize i = 0; i < n_fields; i++) {
+      data_size += SPA_ROUND_UP_N (strlen (fields[i].key) + 1, 8);
+      data_size += SPA_ROUND_UP_N (field_value_size (&fields[i]), 8);
+    }
+
+    record = g_malloc0 (sizeof (struct log_record) +
+        n_fields * sizeof (GLogField) + data_size);
+    record->fields = (GLogField *) (record + 1);
+    record->n_fields = n_fields;
+    data = (guint8 *) (record->fields + n_fields);
+
+    for (gsize i = 0; i < n_fields; i++) {
+      gsize len = strlen (fields[i].key) + 1;
+      record->fields[i].key = memcpy (data, fields[i].key, len);
+      data += SPA_ROUND_UP_N (len, 8);
+
+      len = field_value_size (&fields[i]);
+      record->fields[i].value =
+          memcpy (data, fields[i].value ? fields[i].value : "", len);
+      record->fields[i].length = fields[i].length;
+      data += SPA_ROUND_UP_N (len, 8);
+
+      if (strcmp (fields[i].key, "MESSAGE") == 0 && fields[i].value) {
+        record->text = record->fields[i].value;
+        record->text_len = strlen (record->text);
+      }
+    }
+  }
+
+  record->log_level = log_level;
+  return record;
+}
+
+static void
+log_record_free (struct log_record *record)
+{
+  free (record->line);
+  g_free (record);
+}
+
+static void
+log_record_write (struct log_record *record)
+{
+  if (record->line) {
+    fputs (record->line, stderr);
+    return;
+  }
+
+  if (g_log_writer_journald (record->log_level, record->fields,
+          record->n_fields, NULL) != G_LOG_WRITER_HANDLED) {
+    struct common_fields cf = {0};
+    extract_common_fields (&cf, record->fields, record->n_fields);
+    cf.log_level = log_level_index (record->log_level);
+    if (!cf.log_domain)
+      cf.log_domain = "default";
+    write_debug_message (stderr, &cf);
+  }
+}
+
+/* pops the next record, unless the crash handler has taken over the ring */
+static struct log_record *
+log_writer_pop (void)
+{
+  struct log_record *record = NULL;
+
+  g_atomic_int_set (&log_ring.writer_popping, 1);
+  if (!g_atomic_int_get (&log_ring.stopped))
+    record = log_ring_pop ();
+  g_atomic_int_set (&log_ring.writer_popping, 0);
+  return record;
+}
+
+static gpointer
+log_writer_thread (gpointer data)
+{
+  for (;;) {
+    struct log_record *record;
+    guint n_dropped;
+
+    while ((record = log_writer_pop ())) {
+      log_record_write (record);
+      log_record_free (record);
+      g_atomic_int_inc (&log_ring.n_written);
+
+      if (g_atomic_int_get (&log_ring.n_waiting) > 0)
+        log_ring_wake_up ();
+    }
+
+    n_dropped = g_atomic_int_and ((guint *) &log_ring.n_dropped, 0);
+    if (n_dropped > 0)
+      fprintf (stderr, "(%u log messages were dropped)\n", n_dropped);
+    fflush (stderr);
+
+    /* sleep until there are more records to write */
+    g_mutex_lock (&log_ring.lock);
+    g_cond_broadcast (&log_ring.cond);
+    g_atomic_int_set (&log_ring.writer_sleeping, 1);
+    if (log_ring_is_empty ()) {
+      g_cond_wait_until (&log_ring.cond, &log_ring.lock,
+          g_get_monotonic_time () + 100 * G_TIME_SPAN_MILLISECOND);
+    }
+    g_atomic_int_set (&log_ring.writer_sleeping, 0);
+    g_mutex_unlock (&log_ring.lock);
+  }
+
+  return NULL;
+}
+
+static void
+log_ring_enqueue (struct log_record *record)
+{
+  while (!log_ring_push (record)) {
+    if (log_ring.overflow == LOG_OVERFLOW_DROP) {
+      g_atomic_int_inc (&log_ring.n_dropped);
+      log_record_free (record);
+      return;
+    }
+
+    /* wait for the writer thread to make space */
+    g_mutex_lock (&log_ring.lock);
+    g_atomic_int_inc (&log_ring.n_waiting);
+    g_cond_broadcast (&log_ring.cond);
+    g_cond_wait_until (&log_ring.cond, &log_ring.lock,
+        g_get_monotonic_time () + 10 * G_TIME_SPAN_MILLISECOND);
+    g_atomic_int_add (&log_ring.n_waiting, -1);
+    g_mutex_unlock (&log_ring.lock);
+  }
+
+  g_atomic_int_inc (&log_ring.n_pushed);
+  if (g_atomic_int_get (&log_ring.writer_sleeping))
+    log_ring_wake_up ();
+}
+
+/* waits until everything that was pushed so far has been written */
+static void
+log_ring_flush (void)
+{
+  gint target = g_atomic_int_get (&log_ring.n_pushed);
+  gint64 end = g_get_monotonic_time () + G_TIME_SPAN_SECOND;
+
+  if (!log_ring.thread || g_thread_self () == log_ring.thread)
+    return;
+
+  g_mutex_lock (&log_ring.lock);
+  g_atomic_int_inc (&log_ring.n_waiting);
+  g_cond_broadcast (&log_ring.cond);
+  while ((gint) (g_atomic_int_get (&log_ring.n_written) - target) < 0) {
+    if (!g_cond_wait_until (&log_ring.cond, &log_ring.lock, end))
+      break;
+  }
+  g_atomic_int_add (&log_ring.n_waiting, -1);
+  g_mutex_unlock (&log_ring.lock);
+}
+
+static void
+log_ring_flush_at_exit (void)
+{
+  log_ring_flush ();
+}
+
+static const int crash_signals[] = {
+  SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT,
+};
+static struct sigaction crash_old_actions[G_N_ELEMENTS (crash_signals)];
+
+/* writes whatever is left in the ring and lets the signal go on with the
+   previously installed action; the records are formatted when they are
+   queued, so this only needs write(2), which is async-signal-safe */
+static void
+log_ring_crash_handler (int sig)
+{
+  struct log_record *record;
+  guint i;
+
+  /* stop the writer thread from popping and wait for a pop that is in
+     progress; if it does not finish, the crash happened in the writer
+     thread itself and the ring is left alone */
+  g_atomic_int_set (&log_ring.stopped, 1);
+  for (i = 0; g_atomic_int_get (&log_ring.writer_popping) && i < 100; i++) {
+    struct timespec ts = { 0, 10 * 1000 * 1000 };
+    nanosleep (&ts, NULL);
+  }
+
+  while (i < 100 && (record = log_ring_pop ())) {
+    if (record->text_len > 0) {
+      G_GNUC_UNUSED ssize_t r =
+          write (STDERR_FILENO, record->text, record->text_len);
+      if (!record->line)
+        r = write (STDERR_FILENO, "\n", 1);
+    }
+  }
+
+  /* the signal is delivered again to the previous handler
+     when this one returns */
+  for (i = 0; i < G_N_ELEMENTS (crash_signals); i++) {
+    if (crash_signals[i] == sig)
+      sigaction (sig, &crash_old_actions[i], NULL);
+  }
+  raise (sig);
+}
+
+static void
+log_ring_start (LogOverflowPolicy overflow)
+{
+  for (guint i = 0; i < LOG_RING_SIZE; i++)
+    log_ring.slots[i].seq = i;
+  log_ring.overflow = overflow;
+  log_ring.thread = g_thread_new ("wp-log-writer", log_writer_thread, NULL);
+
+  atexit (log_ring_flush_at_exit);
+}
+
+/*!
+ * \brief Installs handlers for SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT
+ *   that write the messages still queued for asynchronous output to stderr
+ *   before the process terminates
+ *
+ * The library never installs signal handlers on its own; this is meant to be
+ * called once by the application that owns the process, like the daemon.
+ * The handlers only write the messages that were already formatted and then
+ * raise the signal again with the previously installed actions. They have no
+ * effect unless asynchronous output is enabled with WIREPLUMBER_LOG_ASYNC.
+ *
+ * \ingroup wplog
+ * \since 0.4.18
+ */
+void
+wp_log_install_crash_handler (void)
+{
+  static gsize installed = 0;
+
+  if (g_once_init_enter (&installed)) {
+    struct sigaction sa = {0};
+
+    sa.sa_handler = log_ring_crash_handler;
+    sigemptyset (&sa.sa_mask);
+    for (guint i = 0; i < G_N_ELEMENTS (crash_signals); i++)
+      sigaction (crash_signals[i], &sa, &crash_old_actions[i]);
+    g_once_init_leave (&installed, TRUE);
+  }
+}
+
 /*!
  * \brief WirePlumber's GLogWriterFunc
  *
@@ -489,8 +1169,16 @@ wp_log_writer_default (GLogLevelFlags log_level,
 
   /* one-time initialization */
   if (g_once_init_enter (&initialized)) {
+    const gchar *async = g_getenv ("WIREPLUMBER_LOG_ASYNC");
+
     use_color = g_log_writer_supports_color (fileno (stderr));
     output_is_journal = g_log_writer_is_journald (fileno (stderr));
+
+    if (async && async[0] != '\0') {
+      log_ring_start (g_str_equal (async, "block") ?
+          LOG_OVERFLOW_BLOCK : LOG_OVERFLOW_DROP);
+      use_async = TRUE;
+    }
     g_once_init_leave (&initialized, TRUE);
   }
 
@@ -506,7 +1194,7 @@ wp_log_writer_default (GLogLevelFlags log_level,
     cf.log_domain = "default";
 
   /* check if debug category is enabled */
-  if (!is_category_enabled(cf.log_domain))
+  if (!is_category_enabled (cf.log_domain))
     return G_LOG_WRITER_UNHANDLED;
 
   if (G_UNLIKELY (!cf.message))
@@ -518,6 +1206,21 @@ wp_log_writer_default (GLogLevelFlags log_level,
         format_message (&cf);
   }
 
+  if (use_async) {
+    /* fatal messages are written synchronously, after everything that was
+       queued before them, as the process is about to abort */
+    if (log_level & (G_LOG_FLAG_FATAL | G_LOG_LEVEL_ERROR)) {
+      log_ring_flush ();
+    } else {
+      struct log_record *record =
+          log_record_new (log_level, &cf, fields, n_fields);
+      if (record) {
+        log_ring_enqueue (record);
+        return G_LOG_WRITER_HANDLED;
+      }
+    }
+  }
+
   /* write complete field information to the journal if we are logging to it */
   if (output_is_journal &&
       g_log_writer_journald (log_level, fields, n_fields, user_data) == G_LOG_WRITER_HANDLED)
@@ -527,21 +1230,11 @@ wp_log_writer_default (GLogLevelFlags log_level,
   return G_LOG_WRITER_HANDLED;
 }
 
-/*!
- * \brief Used internally by the debug logging macros. Avoid using it directly.
- * \ingroup wplog
- */
-void
-wp_log_structured_standard (
-    const gchar *log_domain,
-    GLogLevelFlags log_level,
-    const gchar *file,
-    const gchar *line,
-    const gchar *func,
-    GType object_type,
-    gconstpointer object,
-    const gchar *message_format,
-    ...)
+static G_GNUC_PRINTF (8, 0) void
+log_structured_valist (const gchar *log_domain, GLogLevelFlags log_level,
+    const gchar *file, const gchar *line, const gchar *func,
+    GType object_type, gconstpointer object,
+    const gchar *message_format, va_list args)
 {
   g_autofree gchar *message = NULL;
   GLogField fields[8] = {
@@ -552,7 +1245,6 @@ wp_log_structured_standard (
     { "MESSAGE", NULL, -1 },
   };
   gsize n_fields = 5;
-  va_list args;
 
   if (log_domain != NULL) {
     fields[n_fields].key = "GLIB_DOMAIN";
@@ -575,13 +1267,102 @@ wp_log_structured_standard (
     n_fields++;
   }
 
-  va_start (args, message_format);
   fields[4].value = message = g_strdup_vprintf (message_format, args);
-  va_end (args);
 
   g_log_structured_array (log_level, fields, n_fields);
 }
 
+/*!
+ * \brief Used internally by the debug logging macros. Avoid using it directly.
+ *
+ * This reuses the category verdict cached in \a site by
+ * wp_log_call_site_is_enabled() and the log domain of the call site, which is
+ * interned only once for the flight recorder.
+ *
+ * \ingroup wplog
+ * \since 0.4.18
+ */
+void
+wp_log_structured_call_site (WpLogCallSite * site,
+    const gchar *log_domain,
+    GLogLevelFlags log_level,
+    const gchar *file,
+    const gchar *line,
+    const gchar *func,
+    GType object_type,
+    gconstpointer object,
+    const gchar *message_format,
+    ...)
+{
+  gint level = log_level_index (log_level);
+  va_list args;
+
+  if (flight_recorder_wants (level)) {
+    GQuark domain = (GQuark) g_atomic_int_get ((gint *) &site->domain);
+
+    if (G_UNLIKELY (domain == 0)) {
+      domain = g_quark_from_string (log_domain ? log_domain : "default");
+      g_atomic_int_set ((gint *) &site->domain, (gint) domain);
+    }
+
+    va_start (args, message_format);
+    flight_recorder_add (domain, level, object_type, object,
+        message_format, args);
+    va_end (args);
+  }
+
+  /* errors and criticals may be fatal, so they always need to go through */
+  if (!(log_level & (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL)) &&
+      (level > enabled_level ||
+          !call_site_category_is_enabled (site, log_domain)))
+    return;
+
+  va_start (args, message_format);
+  log_structured_valist (log_domain, log_level, file, line, func,
+      object_type, object, message_format, args);
+  va_end (args);
+}
+
+/*!
+ * \brief Used internally by the debug logging macros. Avoid using it directly.
+ * \ingroup wplog
+ */
+void
+wp_log_structured_standard (
+    const gchar *log_domain,
+    GLogLevelFlags log_level,
+    const gchar *file,
+    const gchar *line,
+    const gchar *func,
+    GType object_type,
+    gconstpointer object,
+    const gchar *message_format,
+    ...)
+{
+  gint level = log_level_index (log_level);
+  va_list args;
+
+  if (flight_recorder_wants (level)) {
+    va_start (args, message_format);
+    flight_recorder_add (
+        g_quark_from_string (log_domain ? log_domain : "default"), level,
+        object_type, object, message_format, args);
+    va_end (args);
+  }
+
+  /* avoid formatting the message if it is going to be filtered out;
+     errors and criticals may be fatal, so they always need to go through */
+  if (!(log_level & (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL)) &&
+      (level > enabled_level ||
+          !is_category_enabled (log_domain ? log_domain : "default")))
+    return;
+
+  va_start (args, message_format);
+  log_structured_valist (log_domain, log_level, file, line, func,
+      object_type, object, message_format, args);
+  va_end (args);
+}
+
 static G_GNUC_PRINTF (7, 0) void
 wp_spa_log_logtv (void *object,
     enum spa_log_level level,
@@ -607,12 +1388,24 @@ wp_spa_log_logtv (void *object,
   GLogLevelFlags log_level = log_level_info[log_level_idx].log_level;
   fields[0].value = log_level_info[log_level_idx].priority;
 
-  sprintf (line_str, "%d", line);
-  fields[4].value = message = g_strdup_vprintf (fmt, args);
-
   if (topic)
     fields[5].value = topic->topic;
 
+  if (flight_recorder_wants (log_level_idx)) {
+    va_list copy;
+    va_copy (copy, args);
+    flight_recorder_add (g_quark_from_string (fields[5].value), log_level_idx,
+        0, NULL, fmt, copy);
+    va_end (copy);
+  }
+
+  /* avoid formatting the message if it is going to be filtered out */
+  if (log_level_idx > enabled_level || !is_category_enabled (fields[5].value))
+    return;
+
+  sprintf (line_str, "%d", line);
+  fields[4].value = message = g_strdup_vprintf (fmt, args);
+
   g_log_structured_array (log_level, fields, SPA_N_ELEMENTS (fields));
 }
 
@@ -660,7 +1453,7 @@ wp_spa_log_log (void *object,
 static void
 wp_spa_log_topic_init (void *object, struct spa_log_topic *topic)
 {
-  if (is_category_enabled(topic->topic)) {
+  if (is_category_enabled (topic->topic)) {
     topic->has_custom_level = false;
   } else {
     topic->has_custom_level = true;
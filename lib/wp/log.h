@@ -23,6 +23,18 @@ G_BEGIN_DECLS
 WP_API
 gboolean wp_log_level_is_enabled (GLogLevelFlags log_level) G_GNUC_PURE;
 
+typedef struct _WpLogCallSite WpLogCallSite;
+struct _WpLogCallSite
+{
+  /*< private >*/
+  gint state;
+  GQuark domain;
+};
+
+WP_API
+gboolean wp_log_call_site_is_enabled (WpLogCallSite * site,
+    GLogLevelFlags log_level, const gchar * log_domain);
+
 WP_API
 void wp_log_set_level (const gchar * level_str);
 
@@ -36,11 +48,21 @@ void wp_log_structured_standard (const gchar *log_domain,
     const gchar *func, GType object_type, gconstpointer object,
     const gchar *message_format, ...) G_GNUC_PRINTF (8, 9);
 
+WP_API
+void wp_log_structured_call_site (WpLogCallSite * site,
+    const gchar *log_domain, GLogLevelFlags log_level, const gchar *file,
+    const gchar *line, const gchar *func, GType object_type,
+    gconstpointer object, const gchar *message_format, ...)
+    G_GNUC_PRINTF (9, 10);
+
 #define wp_log(level, type, object, ...) \
 ({ \
-  if (G_UNLIKELY (wp_log_level_is_enabled (level))) \
-    wp_log_structured_standard (G_LOG_DOMAIN, level, __FILE__, \
-        G_STRINGIFY (__LINE__), G_STRFUNC, type, object, __VA_ARGS__); \
+  static WpLogCallSite _wp_log_call_site = { 0 }; \
+  if (G_UNLIKELY (wp_log_call_site_is_enabled (&_wp_log_call_site, \
+          level, G_LOG_DOMAIN))) \
+    wp_log_structured_call_site (&_wp_log_call_site, G_LOG_DOMAIN, level, \
+        __FILE__, G_STRINGIFY (__LINE__), G_STRFUNC, type, object, \
+        __VA_ARGS__); \
 })
 
 #define wp_critical(...) \
@@ -82,6 +104,19 @@ void wp_log_structured_standard (const gchar *log_domain,
 #define wp_trace_boxed(type, object, ...) \
     wp_log (WP_LOG_LEVEL_TRACE, type, object, __VA_ARGS__)
 
+WP_API
+void wp_log_install_crash_handler (void);
+
+WP_API
+gboolean wp_log_flight_recorder_start (guint n_records,
+    GLogLevelFlags max_level);
+
+WP_API
+gboolean wp_log_flight_recorder_is_active (void);
+
+WP_API
+gboolean wp_log_flight_recorder_dump (const gchar * filename, GError ** error);
+
 struct spa_log;
 
 WP_API
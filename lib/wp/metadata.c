@@ -61,92 +61,184 @@ static guint32 signals[N_SIGNALS] = {0};
 
 /* data structure */
 
+/*
+ * Items are stored in a two-level index (subject -> key -> item) for O(1)
+ * lookups, while also being linked in insertion order, both globally and
+ * per subject, so that iterators can return them in the order they were set.
+ *
+ * Items are refcounted; iterators keep a ref on the items that they are going
+ * to return, so that changes that happen while iterating do not invalidate
+ * the items (and their strings) that the caller is holding.
+ */
+
 struct item
 {
   uint32_t subject;
   gchar *key;
   gchar *type;
   gchar *value;
+
+  GList *link;          /* in WpMetadataPrivate.items */
+  GList *subject_link;  /* in struct subject.items */
+};
+
+struct subject
+{
+  GQueue items;     /* element-type: struct item (no ref) */
+  GHashTable *keys; /* item->key -> struct item */
+};
+
+typedef struct _WpMetadataPrivate WpMetadataPrivate;
+struct _WpMetadataPrivate
+{
+  struct pw_metadata *iface;
+  struct spa_hook listener;
+  GQueue items;         /* element-type: struct item (owned) */
+  GHashTable *subjects; /* subject id -> struct subject */
+  gboolean remove_listener;
 };
 
 static void
-set_item (struct item * item, uint32_t subject, const char * key,
-    const char * type, const char * value)
+item_clear (struct item * item)
+{
+  g_free (item->key);
+  g_free (item->type);
+  g_free (item->value);
+}
+
+static struct item *
+item_new (uint32_t subject, const char * key, const char * type,
+    const char * value)
 {
+  struct item *item = g_rc_box_new0 (struct item);
   item->subject = subject;
   item->key = g_strdup (key);
   item->type = g_strdup (type);
   item->value = g_strdup (value);
+  return item;
+}
+
+static struct item *
+item_ref (struct item * item)
+{
+  return g_rc_box_acquire (item);
 }
 
 static void
-clear_item (struct item * item)
+item_unref (struct item * item)
 {
-  g_free (item->key);
-  g_free (item->type);
-  g_free (item->value);
-  spa_zero (*item);
+  g_rc_box_release_full (item, (GDestroyNotify) item_clear);
+}
+
+static void
+subject_free (struct subject * s)
+{
+  g_queue_clear (&s->items);
+  g_hash_table_unref (s->keys);
+  g_slice_free (struct subject, s);
 }
 
 static struct item *
-find_item (struct pw_array * metadata, uint32_t subject, const char * key)
+find_item (WpMetadataPrivate * priv, uint32_t subject, const char * key)
 {
-  struct item *item;
+  struct subject *s =
+      g_hash_table_lookup (priv->subjects, GUINT_TO_POINTER (subject));
+  return s ? g_hash_table_lookup (s->keys, key) : NULL;
+}
 
-  pw_array_for_each (item, metadata) {
-    if (item->subject == subject && (key == NULL || !strcmp (item->key, key))) {
-      return item;
-    }
+static void
+set_item (WpMetadataPrivate * priv, uint32_t subject, const char * key,
+    const char * type, const char * value)
+{
+  struct item *item = item_new (subject, key, type, value);
+  struct subject *s =
+      g_hash_table_lookup (priv->subjects, GUINT_TO_POINTER (subject));
+  struct item *old = s ? g_hash_table_lookup (s->keys, key) : NULL;
+
+  if (old) {
+    /* replace the old item in place, keeping the insertion order */
+    g_queue_insert_after (&priv->items, old->link, item);
+    item->link = old->link->next;
+    g_queue_insert_after (&s->items, old->subject_link, item);
+    item->subject_link = old->subject_link->next;
+
+    g_queue_delete_link (&priv->items, old->link);
+    g_queue_delete_link (&s->items, old->subject_link);
+    g_hash_table_replace (s->keys, item->key, item);
+    item_unref (old);
+    return;
+  }
+
+  if (!s) {
+    s = g_slice_new0 (struct subject);
+    g_queue_init (&s->items);
+    s->keys = g_hash_table_new (g_str_hash, g_str_equal);
+    g_hash_table_insert (priv->subjects, GUINT_TO_POINTER (subject), s);
   }
-  return NULL;
+
+  g_queue_push_tail (&priv->items, item);
+  item->link = g_queue_peek_tail_link (&priv->items);
+  g_queue_push_tail (&s->items, item);
+  item->subject_link = g_queue_peek_tail_link (&s->items);
+  g_hash_table_insert (s->keys, item->key, item);
 }
 
-static int
-clear_subject (struct pw_array * metadata, uint32_t subject)
+static void
+remove_item (WpMetadataPrivate * priv, struct item * item)
+{
+  struct subject *s =
+      g_hash_table_lookup (priv->subjects, GUINT_TO_POINTER (item->subject));
+
+  g_hash_table_remove (s->keys, item->key);
+  g_queue_delete_link (&s->items, item->subject_link);
+  g_queue_delete_link (&priv->items, item->link);
+
+  if (g_queue_is_empty (&s->items))
+    g_hash_table_remove (priv->subjects, GUINT_TO_POINTER (item->subject));
+
+  item_unref (item);
+}
+
+static guint
+clear_subject (WpMetadataPrivate * priv, uint32_t subject)
 {
+  struct subject *s;
   struct item *item;
-  uint32_t removed = 0;
+  guint removed = 0;
 
-  while (true) {
-    item = find_item (metadata, subject, NULL);
-    if (item == NULL)
-      break;
-    clear_item (item);
-    pw_array_remove (metadata, item);
+  if (!g_hash_table_steal_extended (priv->subjects, GUINT_TO_POINTER (subject),
+          NULL, (gpointer *) &s))
+    return 0;
+
+  while ((item = g_queue_pop_head (&s->items))) {
+    g_queue_delete_link (&priv->items, item->link);
+    item_unref (item);
     removed++;
   }
+  subject_free (s);
 
   return removed;
 }
 
 static void
-clear_items (struct pw_array * metadata)
+clear_items (WpMetadataPrivate * priv)
 {
   struct item *item;
 
-  pw_array_consume (item, metadata) {
-    clear_item (item);
-    pw_array_remove (metadata, item);
-  }
-  pw_array_reset (metadata);
+  g_hash_table_remove_all (priv->subjects);
+  while ((item = g_queue_pop_head (&priv->items)))
+    item_unref (item);
 }
 
-typedef struct _WpMetadataPrivate WpMetadataPrivate;
-struct _WpMetadataPrivate
-{
-  struct pw_metadata *iface;
-  struct spa_hook listener;
-  struct pw_array metadata;
-  gboolean remove_listener;
-};
-
 G_DEFINE_TYPE_WITH_PRIVATE (WpMetadata, wp_metadata, WP_TYPE_GLOBAL_PROXY)
 
 static void
 wp_metadata_init (WpMetadata * self)
 {
   WpMetadataPrivate *priv = wp_metadata_get_instance_private (self);
-  pw_array_init (&priv->metadata, 4096);
+  g_queue_init (&priv->items);
+  priv->subjects = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) subject_free);
 }
 
 static void
@@ -155,7 +247,8 @@ wp_metadata_finalize (GObject * object)
   WpMetadataPrivate *priv =
       wp_metadata_get_instance_private (WP_METADATA (object));
 
-  pw_array_clear (&priv->metadata);
+  clear_items (priv);
+  g_clear_pointer (&priv->subjects, g_hash_table_unref);
 
   G_OBJECT_CLASS (wp_metadata_parent_class)->finalize (object);
 }
@@ -213,7 +306,7 @@ metadata_event_property (void *object, uint32_t subject, const char *key,
   struct item *item = NULL;
 
   if (key == NULL) {
-    if (clear_subject (&priv->metadata, subject) > 0) {
+    if (clear_subject (priv, subject) > 0) {
       wp_debug_object (self, "remove id:%d", subject);
       g_signal_emit (self, signals[SIGNAL_CHANGED], 0, subject, NULL, NULL,
           NULL);
@@ -221,26 +314,18 @@ metadata_event_property (void *object, uint32_t subject, const char *key,
     return 0;
   }
 
-  item = find_item (&priv->metadata, subject, key);
-  if (item == NULL) {
-    if (value == NULL)
-      return 0;
-    item = pw_array_add (&priv->metadata, sizeof (*item));
-    if (item == NULL)
-      return -errno;
-  } else {
-    clear_item (item);
-  }
-
   if (value != NULL) {
     if (type == NULL)
       type = "string";
-    set_item (item, subject, key, type, value);
+    set_item (priv, subject, key, type, value);
     wp_debug_object (self, "add id:%d key:%s type:%s value:%s",
         subject, key, type, value);
   } else {
+    item = find_item (priv, subject, key);
+    if (item == NULL)
+      return 0;
     type = NULL;
-    pw_array_remove (&priv->metadata, item);
+    remove_item (priv, item);
     wp_debug_object (self, "remove id:%d key:%s", subject, key);
   }
 
@@ -290,7 +375,7 @@ wp_metadata_pw_proxy_destroyed (WpProxy * proxy)
     spa_hook_remove (&priv->listener);
     priv->remove_listener = FALSE;
   }
-  clear_items (&priv->metadata);
+  clear_items (priv);
   wp_object_update_features (WP_OBJECT (self), 0, WP_METADATA_FEATURE_DATA);
 
   WP_PROXY_CLASS (wp_metadata_parent_class)->pw_proxy_destroyed (proxy);
@@ -322,36 +407,27 @@ wp_metadata_class_init (WpMetadataClass * klass)
 struct metadata_iterator_data
 {
   WpMetadata *metadata;
-  const struct item *item;
-  guint32 subject;
+  GPtrArray *items; /* element-type: struct item (owned) */
+  guint index;
 };
 
 static void
 metadata_iterator_reset (WpIterator *it)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
-  WpMetadataPrivate *priv =
-      wp_metadata_get_instance_private (it_data->metadata);
-
-  it_data->item = pw_array_first (&priv->metadata);
+  it_data->index = 0;
 }
 
 static gboolean
 metadata_iterator_next (WpIterator *it, GValue *item)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
-  WpMetadataPrivate *priv =
-      wp_metadata_get_instance_private (it_data->metadata);
-
-  while (pw_array_check (&priv->metadata, it_data->item)) {
-    if ((it_data->subject == PW_ID_ANY ||
-            it_data->subject == it_data->item->subject)) {
-      g_value_init (item, G_TYPE_POINTER);
-      g_value_set_pointer (item, (gpointer) it_data->item);
-      it_data->item++;
-      return TRUE;
-    }
-    it_data->item++;
+
+  if (it_data->index < it_data->items->len) {
+    g_value_init (item, G_TYPE_POINTER);
+    g_value_set_pointer (item,
+        g_ptr_array_index (it_data->items, it_data->index++));
+    return TRUE;
   }
   return FALSE;
 }
@@ -361,19 +437,13 @@ metadata_iterator_fold (WpIterator *it, WpIteratorFoldFunc func, GValue *ret,
     gpointer data)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
-  WpMetadataPrivate *priv =
-      wp_metadata_get_instance_private (it_data->metadata);
-  const struct item *i;
-
-  pw_array_for_each (i, &priv->metadata) {
-    if ((it_data->subject == PW_ID_ANY ||
-            it_data->subject == it_data->item->subject)) {
-      g_auto (GValue) item = G_VALUE_INIT;
-      g_value_init (&item, G_TYPE_POINTER);
-      g_value_set_pointer (&item, (gpointer) i);
-      if (!func (&item, ret, data))
-        return FALSE;
-    }
+
+  for (guint i = 0; i < it_data->items->len; i++) {
+    g_auto (GValue) item = G_VALUE_INIT;
+    g_value_init (&item, G_TYPE_POINTER);
+    g_value_set_pointer (&item, g_ptr_array_index (it_data->items, i));
+    if (!func (&item, ret, data))
+      return FALSE;
   }
   return TRUE;
 }
@@ -382,6 +452,7 @@ static void
 metadata_iterator_finalize (WpIterator *it)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
+  g_clear_pointer (&it_data->items, g_ptr_array_unref);
   g_object_unref (it_data->metadata);
 }
 
@@ -416,6 +487,7 @@ wp_metadata_new_iterator (WpMetadata * self, guint32 subject)
   WpMetadataPrivate *priv;
   g_autoptr (WpIterator) it = NULL;
   struct metadata_iterator_data *it_data;
+  GList *link = NULL;
 
   g_return_val_if_fail (self != NULL, NULL);
   priv = wp_metadata_get_instance_private (self);
@@ -424,8 +496,22 @@ wp_metadata_new_iterator (WpMetadata * self, guint32 subject)
       sizeof (struct metadata_iterator_data));
   it_data = wp_iterator_get_user_data (it);
   it_data->metadata = g_object_ref (self);
-  it_data->item = pw_array_first (&priv->metadata);
-  it_data->subject = subject;
+  it_data->items =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) item_unref);
+  it_data->index = 0;
+
+  if (subject == PW_ID_ANY) {
+    link = priv->items.head;
+  } else {
+    struct subject *s =
+        g_hash_table_lookup (priv->subjects, GUINT_TO_POINTER (subject));
+    if (s)
+      link = s->items.head;
+  }
+
+  for (; link; link = link->next)
+    g_ptr_array_add (it_data->items, item_ref (link->data));
+
   return g_steal_pointer (&it);
 }
 
@@ -470,20 +556,20 @@ const gchar *
 wp_metadata_find (WpMetadata * self, guint32 subject, const gchar * key,
   const gchar ** type)
 {
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) val = G_VALUE_INIT;
-  it = wp_metadata_new_iterator (self, subject);
-  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
-    const gchar *k = NULL, *t = NULL, *v = NULL;
-    wp_metadata_iterator_item_extract (&val, NULL, &k, &t, &v);
-    if (g_strcmp0 (k, key) == 0) {
-      if (type)
-        *type = t;
-      g_value_unset (&val);
-      return v;
-    }
-  }
-  return NULL;
+  WpMetadataPrivate *priv;
+  struct item *item;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  priv = wp_metadata_get_instance_private (self);
+
+  item = find_item (priv, subject, key);
+  if (!item)
+    return NULL;
+
+  if (type)
+    *type = item->type;
+  return item->value;
 }
 
 /*!
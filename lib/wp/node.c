@@ -16,6 +16,7 @@
 #include "private/pipewire-object-mixin.h"
 
 #include <pipewire/impl.h>
+#include <spa/param/format.h>
 
 /*! \defgroup wpnode WpNode */
 /*!
@@ -100,8 +101,22 @@ struct _WpNode
 {
   WpGlobalProxy parent;
   WpObjectManager *ports_om;
+
+  /* unique among all nodes, changes every time EnumFormat changes */
+  guint formats_serial;
+  /* formats_serial of other nodes -> common format flags */
+  GHashTable *formats_cache;
+};
+
+enum {
+  COMMON_FORMAT_CHECKED = (1 << 0),
+  COMMON_FORMAT_FOUND = (1 << 1),
+  COMMON_ENCODED_FORMAT_CHECKED = (1 << 2),
+  COMMON_ENCODED_FORMAT_FOUND = (1 << 3),
 };
 
+#define FORMATS_CACHE_MAX_SIZE 64
+
 static void wp_node_pw_object_mixin_priv_interface_init (
     WpPwObjectMixinPrivInterface * iface);
 
@@ -111,9 +126,44 @@ G_DEFINE_TYPE_WITH_CODE (WpNode, wp_node, WP_TYPE_GLOBAL_PROXY,
     G_IMPLEMENT_INTERFACE (WP_TYPE_PW_OBJECT_MIXIN_PRIV,
         wp_node_pw_object_mixin_priv_interface_init))
 
+static guint
+wp_node_next_formats_serial (void)
+{
+  static guint serial = 0;
+  return (guint) g_atomic_int_add (&serial, 1) + 1;
+}
+
+static void
+wp_node_invalidate_formats (WpNode * self)
+{
+  self->formats_serial = wp_node_next_formats_serial ();
+  g_hash_table_remove_all (self->formats_cache);
+}
+
+static void
+wp_node_on_params_changed (WpNode * self, const gchar * param_name)
+{
+  if (!g_strcmp0 (param_name, "EnumFormat"))
+    wp_node_invalidate_formats (self);
+}
+
 static void
 wp_node_init (WpNode * self)
 {
+  self->formats_serial = wp_node_next_formats_serial ();
+  self->formats_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_signal_connect (self, "params-changed",
+      G_CALLBACK (wp_node_on_params_changed), NULL);
+}
+
+static void
+wp_node_finalize (GObject * object)
+{
+  WpNode *self = WP_NODE (object);
+
+  g_clear_pointer (&self->formats_cache, g_hash_table_unref);
+
+  G_OBJECT_CLASS (wp_node_parent_class)->finalize (object);
 }
 
 static void
@@ -228,6 +278,9 @@ wp_node_deactivate (WpObject * object, WpObjectFeatures features)
 {
   wp_pw_object_mixin_deactivate (object, features);
 
+  if (features & WP_PIPEWIRE_OBJECT_FEATURE_PARAM_FORMAT)
+    wp_node_invalidate_formats (WP_NODE (object));
+
   if (features & WP_NODE_FEATURE_PORTS) {
     WpNode *self = WP_NODE (object);
     g_clear_object (&self->ports_om);
@@ -256,6 +309,7 @@ wp_node_pw_proxy_destroyed (WpProxy * proxy)
   WpNode *self = WP_NODE (proxy);
 
   wp_pw_object_mixin_handle_pw_proxy_destroyed (proxy);
+  wp_node_invalidate_formats (self);
 
   g_clear_object (&self->ports_om);
   wp_object_update_features (WP_OBJECT (self), 0, WP_NODE_FEATURE_PORTS);
@@ -270,6 +324,7 @@ wp_node_class_init (WpNodeClass * klass)
   WpObjectClass *wpobject_class = (WpObjectClass *) klass;
   WpProxyClass *proxy_class = (WpProxyClass *) klass;
 
+  object_class->finalize = wp_node_finalize;
   object_class->get_property = wp_node_get_property;
 
   wpobject_class->get_supported_features = wp_node_get_supported_features;
@@ -634,6 +689,100 @@ wp_node_send_command (WpNode * self, const gchar * command)
   pw_node_send_command (wp_proxy_get_pw_proxy (WP_PROXY (self)), &cmd);
 }
 
+static gboolean
+format_is_raw (WpSpaPod * format)
+{
+  const struct spa_pod *pod = wp_spa_pod_get_spa_pod (format);
+  const struct spa_pod_prop *prop;
+  guint32 subtype;
+
+  if (!spa_pod_is_object (pod))
+    return FALSE;
+
+  prop = spa_pod_find_prop (pod, NULL, SPA_FORMAT_mediaSubtype);
+  return prop && spa_pod_get_id (&prop->value, &subtype) >= 0 &&
+      subtype == SPA_MEDIA_SUBTYPE_raw;
+}
+
+static gboolean
+wp_node_find_common_format (WpNode * self, WpNode * other,
+    gboolean encoded_only)
+{
+  g_autoptr (WpIterator) it = NULL;
+  g_autoptr (WpIterator) other_it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+  g_auto (GValue) other_item = G_VALUE_INIT;
+
+  it = wp_pipewire_object_enum_params_sync (WP_PIPEWIRE_OBJECT (self),
+      "EnumFormat", NULL);
+  other_it = wp_pipewire_object_enum_params_sync (WP_PIPEWIRE_OBJECT (other),
+      "EnumFormat", NULL);
+  if (!it || !other_it)
+    return FALSE;
+
+  for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
+    WpSpaPod *format = g_value_get_boxed (&item);
+
+    if (encoded_only && format_is_raw (format))
+      continue;
+
+    wp_iterator_reset (other_it);
+    for (; wp_iterator_next (other_it, &other_item);
+        g_value_unset (&other_item)) {
+      if (wp_spa_pod_intersects (format, g_value_get_boxed (&other_item)))
+        return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/*!
+ * \brief Checks if this node and \a other have at least one format in common
+ *
+ * This intersects the cached EnumFormat params of both nodes with each other,
+ * so both nodes need to have the WP_PIPEWIRE_OBJECT_FEATURE_PARAM_FORMAT
+ * feature enabled. The result is cached until the EnumFormat params of
+ * either node change.
+ *
+ * \ingroup wpnode
+ * \since 0.4.18
+ * \param self the node
+ * \param other the other node
+ * \param encoded_only TRUE to ignore the raw formats of \a self, so that
+ *   only encoded formats (as used for passthrough) are considered
+ * \returns TRUE if there is a common format, FALSE otherwise
+ */
+gboolean
+wp_node_has_common_format (WpNode * self, WpNode * other,
+    gboolean encoded_only)
+{
+  gpointer key;
+  guint flags;
+  guint checked = encoded_only ?
+      COMMON_ENCODED_FORMAT_CHECKED : COMMON_FORMAT_CHECKED;
+  guint found = encoded_only ?
+      COMMON_ENCODED_FORMAT_FOUND : COMMON_FORMAT_FOUND;
+
+  g_return_val_if_fail (WP_IS_NODE (self), FALSE);
+  g_return_val_if_fail (WP_IS_NODE (other), FALSE);
+
+  key = GUINT_TO_POINTER (other->formats_serial);
+  flags = GPOINTER_TO_UINT (g_hash_table_lookup (self->formats_cache, key));
+
+  if (!(flags & checked)) {
+    flags |= checked;
+    if (wp_node_find_common_format (self, other, encoded_only))
+      flags |= found;
+
+    /* entries of nodes that have changed since are never looked up again */
+    if (g_hash_table_size (self->formats_cache) >= FORMATS_CACHE_MAX_SIZE)
+      g_hash_table_remove_all (self->formats_cache);
+    g_hash_table_insert (self->formats_cache, key, GUINT_TO_POINTER (flags));
+  }
+
+  return (flags & found) != 0;
+}
+
 /*! \defgroup wpimplnode WpImplNode */
 
 enum {
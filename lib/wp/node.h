@@ -90,6 +90,10 @@ WpPort * wp_node_lookup_port_full (WpNode * self, WpObjectInterest * interest);
 WP_API
 void wp_node_send_command (WpNode * self, const gchar *command);
 
+WP_API
+gboolean wp_node_has_common_format (WpNode * self, WpNode * other,
+    gboolean encoded_only);
+
 /*!
  * \brief The WpImplNode GType
  * \ingroup wpimplnode
@@ -14,6 +14,7 @@
 #include "proxy-interfaces.h"
 #include "log.h"
 #include "error.h"
+#include "private/registry.h"
 
 #include <pipewire/pipewire.h>
 
@@ -30,6 +31,19 @@
  * are satisfied.
  */
 
+/* a constraint value (or a subject value) in native form;
+   the active member is defined by the constraint's subject_type */
+union constraint_value
+{
+  gboolean b;
+  gint32 i;
+  guint32 u;
+  gint64 x;
+  guint64 t;
+  gdouble d;
+  gchar *s;
+};
+
 struct constraint
 {
   WpConstraintType type;
@@ -37,6 +51,17 @@ struct constraint
   gchar subject_type; /* a basic GVariantType as a single char */
   gchar *subject;
   GVariant *value;
+
+  /* compiled by _validate(), so that matching does not need to look at
+     the GVariant: the value unpacked in native form (1 item for EQUALS and
+     NOT_EQUALS, 2 for IN_RANGE, N for IN_LIST) or the pattern for MATCHES */
+  union constraint_value *values;
+  guint n_values;
+  GPatternSpec *pattern;
+
+  /* G_PROPERTY lookup cache; the pspec of the last object type matched */
+  GType pspec_type;
+  GParamSpec *pspec;
 };
 
 struct _WpObjectInterest
@@ -239,6 +264,11 @@ wp_object_interest_add_constraint (WpObjectInterest * self,
   c->subject_type = '\0';
   c->subject = g_strdup (subject);
   c->value = value ? g_variant_ref_sink (value) : NULL;
+  c->values = NULL;
+  c->n_values = 0;
+  c->pattern = NULL;
+  c->pspec_type = G_TYPE_INVALID;
+  c->pspec = NULL;
 
   /* mark as invalid to force validation */
   self->valid = FALSE;
@@ -257,6 +287,20 @@ wp_object_interest_ref (WpObjectInterest *self)
   return self;
 }
 
+static void
+constraint_clear_compiled (struct constraint * c)
+{
+  if (c->values && c->subject_type == 's') {
+    for (guint i = 0; i < c->n_values; i++)
+      g_free (c->values[i].s);
+  }
+  g_clear_pointer (&c->values, g_free);
+  c->n_values = 0;
+  g_clear_pointer (&c->pattern, g_pattern_spec_free);
+  c->pspec_type = G_TYPE_INVALID;
+  c->pspec = NULL;
+}
+
 static void
 wp_object_interest_free (WpObjectInterest * self)
 {
@@ -265,6 +309,7 @@ wp_object_interest_free (WpObjectInterest * self)
   g_return_if_fail (self != NULL);
 
   pw_array_for_each (c, &self->constraints) {
+    constraint_clear_compiled (c);
     g_clear_pointer (&c->subject, g_free);
     g_clear_pointer (&c->value, g_variant_unref);
   }
@@ -286,6 +331,50 @@ wp_object_interest_unref (WpObjectInterest * self)
     wp_object_interest_free (self);
 }
 
+static void
+variant_to_constraint_value (gchar type, GVariant * variant,
+    union constraint_value * val)
+{
+  switch (type) {
+    case 'b': val->b = g_variant_get_boolean (variant); break;
+    case 'i': val->i = g_variant_get_int32 (variant); break;
+    case 'u': val->u = g_variant_get_uint32 (variant); break;
+    case 'x': val->x = g_variant_get_int64 (variant); break;
+    case 't': val->t = g_variant_get_uint64 (variant); break;
+    case 'd': val->d = g_variant_get_double (variant); break;
+    case 's': val->s = g_variant_dup_string (variant, NULL); break;
+    default: g_return_if_reached ();
+  }
+}
+
+/* unpacks the value of an already validated constraint */
+static void
+constraint_compile (struct constraint * c)
+{
+  switch (c->verb) {
+    case WP_CONSTRAINT_VERB_EQUALS:
+    case WP_CONSTRAINT_VERB_NOT_EQUALS:
+      c->n_values = 1;
+      c->values = g_new0 (union constraint_value, 1);
+      variant_to_constraint_value (c->subject_type, c->value, c->values);
+      break;
+    case WP_CONSTRAINT_VERB_IN_LIST:
+    case WP_CONSTRAINT_VERB_IN_RANGE:
+      c->n_values = g_variant_n_children (c->value);
+      c->values = g_new0 (union constraint_value, c->n_values);
+      for (guint i = 0; i < c->n_values; i++) {
+        g_autoptr (GVariant) child = g_variant_get_child_value (c->value, i);
+        variant_to_constraint_value (c->subject_type, child, &c->values[i]);
+      }
+      break;
+    case WP_CONSTRAINT_VERB_MATCHES:
+      c->pattern = g_pattern_spec_new (g_variant_get_string (c->value, NULL));
+      break;
+    default:
+      break;
+  }
+}
+
 /*!
  * \brief Validates the interest, ensuring that the interest GType
  * is a valid object and that all the constraints have been expressed properly.
@@ -323,6 +412,9 @@ wp_object_interest_validate (WpObjectInterest * self, GError ** error)
   pw_array_for_each (c, &self->constraints) {
     const GVariantType *value_type = NULL;
 
+    /* drop the compiled form of any previous validation */
+    constraint_clear_compiled (c);
+
     if (c->type <= WP_CONSTRAINT_TYPE_NONE ||
         c->type > WP_CONSTRAINT_TYPE_G_PROPERTY) {
       g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVARIANT,
@@ -505,6 +597,8 @@ wp_object_interest_validate (WpObjectInterest * self, GError ** error)
     /* cache the type that the property must have */
     if (value_type)
       c->subject_type = *g_variant_type_peek_string (value_type);
+
+    constraint_compile (c);
   }
 
   return (self->valid = TRUE);
@@ -526,26 +620,25 @@ subject_type_to_gtype (gchar type)
 }
 
 static inline gboolean
-property_string_to_gvalue (gchar subj_type, const gchar * str, GValue * val)
+property_string_to_value (gchar subj_type, const gchar * str,
+    union constraint_value * val)
 {
-  g_value_init (val, subject_type_to_gtype (subj_type));
-
   switch (subj_type) {
     case 'b':
       if (!strcmp (str, "true") || !strcmp (str, "1"))
-        g_value_set_boolean (val, TRUE);
+        val->b = TRUE;
       else if (!strcmp (str, "false") || !strcmp (str, "0"))
-        g_value_set_boolean (val, FALSE);
+        val->b = FALSE;
       else {
         wp_trace ("failed to convert '%s' to boolean", str);
         return FALSE;
       }
       break;
     case 's':
-      g_value_set_static_string (val, str);
+      val->s = (gchar *) str;
       break;
 
-#define CASE_NUMBER(l, T, convert) \
+#define CASE_NUMBER(l, m, T, convert) \
     case l: { \
       g##T number; \
       errno = 0; \
@@ -554,14 +647,14 @@ property_string_to_gvalue (gchar subj_type, const gchar * str, GValue * val)
         wp_trace ("failed to convert '%s' to " #T, str); \
         return FALSE; \
       } \
-      g_value_set_##T (val, number); \
+      val->m = number; \
       break; \
     }
-    CASE_NUMBER ('i', int, strtol (str, NULL, 10))
-    CASE_NUMBER ('u', uint, strtoul (str, NULL, 10))
-    CASE_NUMBER ('x', int64, strtoll (str, NULL, 10))
-    CASE_NUMBER ('t', uint64, strtoull (str, NULL, 10))
-    CASE_NUMBER ('d', double, strtod (str, NULL))
+    CASE_NUMBER ('i', i, int, strtol (str, NULL, 10))
+    CASE_NUMBER ('u', u, uint, strtoul (str, NULL, 10))
+    CASE_NUMBER ('x', x, int64, strtoll (str, NULL, 10))
+    CASE_NUMBER ('t', t, uint64, strtoull (str, NULL, 10))
+    CASE_NUMBER ('d', d, double, strtod (str, NULL))
 #undef CASE_NUMBER
     default:
       g_return_val_if_reached (FALSE);
@@ -569,27 +662,39 @@ property_string_to_gvalue (gchar subj_type, const gchar * str, GValue * val)
   return TRUE;
 }
 
+static inline void
+gvalue_to_value (gchar subj_type, const GValue * gvalue,
+    union constraint_value * val)
+{
+  switch (subj_type) {
+    case 'b': val->b = g_value_get_boolean (gvalue); break;
+    case 'i': val->i = g_value_get_int (gvalue); break;
+    case 'u': val->u = g_value_get_uint (gvalue); break;
+    case 'x': val->x = g_value_get_int64 (gvalue); break;
+    case 't': val->t = g_value_get_uint64 (gvalue); break;
+    case 'd': val->d = g_value_get_double (gvalue); break;
+    case 's': val->s = (gchar *) g_value_get_string (gvalue); break;
+    default: g_return_if_reached ();
+  }
+}
+
 static inline gboolean
-constraint_verb_equals (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_value_equals (gchar subj_type, const union constraint_value * subj,
+    const union constraint_value * check)
 {
   switch (subj_type) {
-    case 'd': {
-      gdouble a = g_value_get_double (subj_val);
-      gdouble b = g_variant_get_double (check_val);
-      return G_APPROX_VALUE (a, b, FLT_EPSILON);
-    }
+    case 'd':
+      return G_APPROX_VALUE (subj->d, check->d, FLT_EPSILON);
     case 's':
-      return !g_strcmp0 (g_value_get_string (subj_val),
-                         g_variant_get_string (check_val, NULL));
-#define CASE_BASIC(l, T, R) \
+      return !g_strcmp0 (subj->s, check->s);
+#define CASE_BASIC(l, m) \
     case l: \
-      return (g_value_get_##T (subj_val) == g_variant_get_##R (check_val));
-    CASE_BASIC ('b', boolean, boolean)
-    CASE_BASIC ('i', int, int32)
-    CASE_BASIC ('u', uint, uint32)
-    CASE_BASIC ('x', int64, int64)
-    CASE_BASIC ('t', uint64, uint64)
+      return (subj->m == check->m);
+    CASE_BASIC ('b', b)
+    CASE_BASIC ('i', i)
+    CASE_BASIC ('u', u)
+    CASE_BASIC ('x', x)
+    CASE_BASIC ('t', t)
 #undef CASE_BASIC
     default:
       g_return_val_if_reached (FALSE);
@@ -597,63 +702,57 @@ constraint_verb_equals (gchar subj_type, const GValue * subj_val,
 }
 
 static inline gboolean
-constraint_verb_matches (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_verb_equals (const struct constraint * c,
+    const union constraint_value * subj)
 {
-  switch (subj_type) {
-    case 's': {
-      const gchar *check_str = g_variant_get_string (check_val, NULL);
-      const gchar *subj_str = g_value_get_string (subj_val);
-      if (!check_str || !subj_str)
+  return constraint_value_equals (c->subject_type, subj, c->values);
+}
+
+static inline gboolean
+constraint_verb_matches (const struct constraint * c,
+    const union constraint_value * subj)
+{
+  switch (c->subject_type) {
+    case 's':
+      if (!subj->s)
         return FALSE;
-      return g_pattern_match_simple (check_str, subj_str);
-    }
+      return g_pattern_match_string (c->pattern, subj->s);
     default:
       g_return_val_if_reached (FALSE);
   }
-  return TRUE;
 }
 
 static inline gboolean
-constraint_verb_in_list (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_verb_in_list (const struct constraint * c,
+    const union constraint_value * subj)
 {
-  GVariantIter iter;
-  g_autoptr (GVariant) child = NULL;
-
-  g_variant_iter_init (&iter, check_val);
-  while ((child = g_variant_iter_next_value (&iter))) {
-    if (constraint_verb_equals (subj_type, subj_val, child))
+  for (guint i = 0; i < c->n_values; i++) {
+    if (constraint_value_equals (c->subject_type, subj, &c->values[i]))
       return TRUE;
-    g_variant_unref (child);
   }
   return FALSE;
 }
 
 static inline gboolean
-constraint_verb_in_range (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_verb_in_range (const struct constraint * c,
+    const union constraint_value * subj)
 {
-  switch (subj_type) {
-#define CASE_RANGE(l, t, T) \
-    case l: { \
-      g##T val, min, max; \
-      g_variant_get (check_val, "("#t#t")", &min, &max); \
-      val = g_value_get_##T (subj_val); \
-      if (val < min || val > max) \
-        return FALSE; \
-      break; \
-    }
-    CASE_RANGE('i', i, int)
-    CASE_RANGE('u', u, uint)
-    CASE_RANGE('x', x, int64)
-    CASE_RANGE('t', t, uint64)
-    CASE_RANGE('d', d, double)
+  const union constraint_value *min = &c->values[0];
+  const union constraint_value *max = &c->values[1];
+
+  switch (c->subject_type) {
+#define CASE_RANGE(l, m) \
+    case l: \
+      return !(subj->m < min->m || subj->m > max->m);
+    CASE_RANGE ('i', i)
+    CASE_RANGE ('u', u)
+    CASE_RANGE ('x', x)
+    CASE_RANGE ('t', t)
+    CASE_RANGE ('d', d)
 #undef CASE_RANGE
     default:
       g_return_val_if_reached (FALSE);
   }
-  return TRUE;
 }
 
 /*!
@@ -775,6 +874,7 @@ wp_object_interest_matches_full (WpObjectInterest * self,
   pw_array_for_each (c, &self->constraints) {
     WpProperties *lookup_props = pw_global_props;
     g_auto (GValue) value = G_VALUE_INIT;
+    union constraint_value subj = { 0 };
     gboolean exists = FALSE;
 
     /* return early if the match failed and CHECK_ALL is not specified */
@@ -795,16 +895,22 @@ wp_object_interest_matches_full (WpObjectInterest * self,
           exists = !!(lookup_str = wp_properties_get (lookup_props, c->subject));
 
         if (exists && c->subject_type)
-          property_string_to_gvalue (c->subject_type, lookup_str, &value);
+          property_string_to_value (c->subject_type, lookup_str, &subj);
         break;
       }
       case WP_CONSTRAINT_TYPE_G_PROPERTY: {
         GType value_type;
         GParamSpec *pspec = NULL;
 
-        if (object)
-          exists = !!(pspec = g_object_class_find_property (
-              G_OBJECT_GET_CLASS (object), c->subject));
+        if (object) {
+          /* objects of the same type share the pspec; cache it */
+          if (c->pspec_type != G_OBJECT_TYPE (object)) {
+            c->pspec = g_object_class_find_property (
+                G_OBJECT_GET_CLASS (object), c->subject);
+            c->pspec_type = G_OBJECT_TYPE (object);
+          }
+          exists = !!(pspec = c->pspec);
+        }
 
         if (exists && c->subject_type) {
           g_value_init (&value, pspec->value_type);
@@ -827,6 +933,7 @@ wp_object_interest_matches_full (WpObjectInterest * self,
               continue;
             }
           }
+          gvalue_to_value (c->subject_type, &value, &subj);
         }
 
         break;
@@ -840,27 +947,27 @@ wp_object_interest_matches_full (WpObjectInterest * self,
     switch (c->verb) {
       case WP_CONSTRAINT_VERB_EQUALS:
         if (!exists ||
-            !constraint_verb_equals (c->subject_type, &value, c->value))
+            !constraint_verb_equals (c, &subj))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_NOT_EQUALS:
         if (exists &&
-            constraint_verb_equals (c->subject_type, &value, c->value))
+            constraint_verb_equals (c, &subj))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_MATCHES:
         if (!exists ||
-            !constraint_verb_matches (c->subject_type, &value, c->value))
+            !constraint_verb_matches (c, &subj))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_IN_LIST:
         if (!exists ||
-            !constraint_verb_in_list (c->subject_type, &value, c->value))
+            !constraint_verb_in_list (c, &subj))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_IN_RANGE:
         if (!exists ||
-            !constraint_verb_in_range (c->subject_type, &value, c->value))
+            !constraint_verb_in_range (c, &subj))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_IS_PRESENT:
@@ -877,3 +984,233 @@ wp_object_interest_matches_full (WpObjectInterest * self,
   }
   return result;
 }
+
+/*
+ * \brief Gets the GType that this interest is declared on
+ *
+ * \param self the object interest
+ * \returns the GType of the objects that \a self is interested in
+ */
+GType
+wp_object_interest_get_gtype (WpObjectInterest * self)
+{
+  g_return_val_if_fail (self != NULL, G_TYPE_INVALID);
+  return self->gtype;
+}
+
+/*
+ * \brief Finds a WP_CONSTRAINT_VERB_EQUALS constraint of type
+ * WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY on the specified \a subject and
+ * returns its value, formatted as a property string
+ *
+ * This is used by the registry to index interests by the values that they
+ * require on well-known global properties. String values are returned as-is;
+ * integer values are only formatted when \a allow_numbers is TRUE, since their
+ * string representation is only reliable on properties with a canonical
+ * formatting (such as "object.id", which is always set by the registry)
+ *
+ * \param self the object interest, which must have been validated already
+ * \param subject the property name to look for
+ * \param allow_numbers whether integer values are acceptable
+ * \returns (transfer full)(nullable): the required value of \a subject, or
+ *   NULL if there is no such constraint
+ */
+gchar *
+wp_object_interest_get_equals_string (WpObjectInterest * self,
+    const gchar * subject, gboolean allow_numbers)
+{
+  struct constraint *c;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->valid, NULL);
+
+  pw_array_for_each (c, &self->constraints) {
+    if (c->type != WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY ||
+        c->verb != WP_CONSTRAINT_VERB_EQUALS ||
+        g_strcmp0 (c->subject, subject) != 0)
+      continue;
+
+    switch (c->subject_type) {
+      case 's':
+        return g_variant_dup_string (c->value, NULL);
+      case 'i':
+        if (allow_numbers)
+          return g_strdup_printf ("%d", g_variant_get_int32 (c->value));
+        break;
+      case 'u':
+        if (allow_numbers)
+          return g_strdup_printf ("%u", g_variant_get_uint32 (c->value));
+        break;
+      case 'x':
+        if (allow_numbers)
+          return g_strdup_printf ("%" G_GINT64_FORMAT,
+              g_variant_get_int64 (c->value));
+        break;
+      case 't':
+        if (allow_numbers)
+          return g_strdup_printf ("%" G_GUINT64_FORMAT,
+              g_variant_get_uint64 (c->value));
+        break;
+      default:
+        break;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * \brief If the interest requires the property \a subject (of the given
+ * \a type) to be equal to a certain value, returns that value as the string
+ * that the property would hold
+ *
+ * This is used by object managers to look up objects in their property
+ * indexes. String values are returned as-is. Integer values are returned in
+ * their canonical form, with \a numeric set to TRUE, because properties
+ * that hold the same number in another form also match; they are only
+ * returned if they are in the range where all the integer types behave the
+ * same, which covers ids and other small numbers
+ *
+ * \param self the object interest, which must have been validated already
+ * \param type the constraint type to look for
+ * \param subject the property name to look for
+ * \param numeric (out): whether the value is a number
+ * \returns (transfer full)(nullable): the required value of \a subject, or
+ *   NULL if there is no such constraint
+ */
+gchar *
+wp_object_interest_get_equals_key (WpObjectInterest * self,
+    WpConstraintType type, const gchar * subject, gboolean * numeric)
+{
+  struct constraint *c;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->valid, NULL);
+
+  pw_array_for_each (c, &self->constraints) {
+    gint64 value = -1;
+
+    if (c->type != type ||
+        c->verb != WP_CONSTRAINT_VERB_EQUALS ||
+        g_strcmp0 (c->subject, subject) != 0)
+      continue;
+
+    switch (c->subject_type) {
+      case 's':
+        *numeric = FALSE;
+        return g_variant_dup_string (c->value, NULL);
+      case 'i':
+        value = g_variant_get_int32 (c->value);
+        break;
+      case 'u':
+        value = g_variant_get_uint32 (c->value);
+        break;
+      case 'x':
+        value = g_variant_get_int64 (c->value);
+        break;
+      case 't':
+        value = MIN (g_variant_get_uint64 (c->value), (guint64) G_MAXINT64);
+        break;
+      default:
+        break;
+    }
+
+    if (value >= 0 && value <= G_MAXINT32) {
+      *numeric = TRUE;
+      return g_strdup_printf ("%" G_GINT64_FORMAT, value);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * \brief If the interest requires \a subject to be equal to a non-negative
+ * integer, with a constraint of the given \a type, returns that integer
+ *
+ * This is used by object managers to look up objects by their ids. Values
+ * are accepted both as integers and as strings holding an integer, since
+ * properties are strings and GObject properties are compared after being
+ * converted to the type of the constraint
+ *
+ * \param self the object interest, which must have been validated already
+ * \param type the constraint type to look for
+ * \param subject the property name to look for
+ * \param id (out): the required value of \a subject
+ * \returns TRUE if there is such a constraint, FALSE otherwise
+ */
+gboolean
+wp_object_interest_get_equals_id (WpObjectInterest * self,
+    WpConstraintType type, const gchar * subject, guint64 * id)
+{
+  struct constraint *c;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (self->valid, FALSE);
+
+  pw_array_for_each (c, &self->constraints) {
+    gint64 value = -1;
+
+    if (c->type != type ||
+        c->verb != WP_CONSTRAINT_VERB_EQUALS ||
+        g_strcmp0 (c->subject, subject) != 0)
+      continue;
+
+    switch (c->subject_type) {
+      case 'i':
+        value = g_variant_get_int32 (c->value);
+        break;
+      case 'u':
+        value = g_variant_get_uint32 (c->value);
+        break;
+      case 'x':
+        value = g_variant_get_int64 (c->value);
+        break;
+      case 't':
+        *id = g_variant_get_uint64 (c->value);
+        return TRUE;
+      case 's':
+        if (g_ascii_string_to_unsigned (g_variant_get_string (c->value, NULL),
+                10, 0, G_MAXUINT64, id, NULL))
+          return TRUE;
+        break;
+      default:
+        break;
+    }
+
+    if (value >= 0) {
+      *id = value;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/*
+ * \brief Appends to \a key a string that describes the interest completely,
+ * so that two interests have the same key only if they are structurally
+ * identical (same GType and same constraints, in the same order)
+ *
+ * This is used by the registry to find object managers that are interested
+ * in exactly the same objects, so that they can share their objects
+ *
+ * \param self the object interest, which must have been validated already
+ * \param key the string to append the key to
+ */
+void
+wp_object_interest_append_key (WpObjectInterest * self, GString * key)
+{
+  struct constraint *c;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->valid);
+
+  g_string_append_printf (key, "%s{", g_type_name (self->gtype));
+  pw_array_for_each (c, &self->constraints) {
+    g_autofree gchar *subject = g_strescape (c->subject, NULL);
+    g_autofree gchar *value =
+        c->value ? g_variant_print (c->value, TRUE) : NULL;
+
+    g_string_append_printf (key, "%d,%d,\"%s\",%s;", c->type, c->verb,
+        subject, value ? value : "-");
+  }
+  g_string_append_c (key, '}');
+}
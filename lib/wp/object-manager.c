@@ -11,6 +11,7 @@
 #include "object-manager.h"
 #include "log.h"
 #include "proxy-interfaces.h"
+#include "session-item.h"
 #include "private/registry.h"
 
 #include <pipewire/pipewire.h>
@@ -52,6 +53,13 @@
  * \c installed signal has been emitted. That signal is emitted asynchronously
  * after all the initial objects have been prepared.
  *
+ * Object managers that are installed on the same WpCore with identical
+ * interests and requested features share their objects internally, so that
+ * each object is matched and prepared only once for all of them. If the
+ * objects are available already, an object manager that is installed later
+ * emits \c object-added for them before wp_core_install_object_manager()
+ * returns.
+ *
  * \gproperties
  *
  * \gproperty{core, WpCore *, G_PARAM_READABLE, The core}
@@ -111,6 +119,50 @@
  * Flags: G_SIGNAL_RUN_FIRST
  * \endparblock
  *
+ * \par objects-added
+ * \parblock
+ * \code
+ * void
+ * objects_added_callback (WpObjectManager * self,
+ *                         GPtrArray * objects,
+ *                         gpointer user_data)
+ * \endcode
+ *
+ * Emitted right before \c objects-changed with all the objects that have been
+ * added since the last emission, in the order they were added. When many
+ * objects appear together (for example, all the ports of a new device), this
+ * allows handling them all at once instead of one by one. Objects that were
+ * added and removed again in the meantime are not included. Only objects that
+ * are added while there is a handler connected are collected.
+ *
+ * Parameters:
+ * - `objects` - (element-type GObject): the objects that were added
+ *
+ * Flags: G_SIGNAL_RUN_FIRST
+ * \since 0.4.18
+ * \endparblock
+ *
+ * \par objects-removed
+ * \parblock
+ * \code
+ * void
+ * objects_removed_callback (WpObjectManager * self,
+ *                           GPtrArray * objects,
+ *                           gpointer user_data)
+ * \endcode
+ *
+ * Emitted right before \c objects-added with all the objects that have been
+ * removed since the last emission, in the order they were removed. The
+ * objects are kept alive until the emission is over, but they are no longer
+ * managed by this object manager.
+ *
+ * Parameters:
+ * - `objects` - (element-type GObject): the objects that were removed
+ *
+ * Flags: G_SIGNAL_RUN_FIRST
+ * \since 0.4.18
+ * \endparblock
+ *
  * \par objects-changed
  * \parblock
  * \code
@@ -128,6 +180,121 @@
  * \endparblock
  */
 
+/*
+ * Id indexes:
+ *
+ * Lookups and filtered iterators that require an object to have a specific
+ * bound-id or object.serial are very common (default-nodes, mixer-api and
+ * many scripts do them on every event), so the object manager can index its
+ * objects by these ids. An index is built the first time that an interest
+ * with such a constraint is used and is then kept up to date.
+ *
+ * Objects whose id cannot be determined when they are added (for instance,
+ * proxies that are not bound yet, or objects that are not proxies at all)
+ * are kept in the "unindexed" set and are always checked, so that using the
+ * index never changes the result. Candidates from the index are checked
+ * against the whole interest as well.
+ */
+typedef enum {
+  ID_INDEX_BOUND_ID,
+  ID_INDEX_SERIAL,
+  N_ID_INDEXES
+} IdIndexKind;
+
+static const struct {
+  WpConstraintType type;
+  const gchar *subject;
+} id_index_keys[N_ID_INDEXES] = {
+  [ID_INDEX_BOUND_ID] = { WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id" },
+  [ID_INDEX_SERIAL] = { WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "object.serial" },
+};
+
+struct id_index
+{
+  GHashTable *by_id; // guint64* -> object
+  GHashTable *by_object; // object -> guint64* (owned by by_id)
+  GHashTable *unindexed; // set of objects
+};
+
+/*
+ * Property indexes:
+ *
+ * Indexes that are requested with wp_object_manager_add_index() map the
+ * values of a property to the objects that have them, and are updated when
+ * objects are added, removed or emit notify::properties.
+ *
+ * Objects that do not have the property are not indexed, since they cannot
+ * match an equality constraint. Numbers are looked up in their canonical
+ * form ("42"), but properties are converted to numbers leniently when
+ * matching, so a numeric lookup also checks the objects whose value is not
+ * a number in canonical form ("042", "42abc", "abc"...).
+ */
+struct prop_index
+{
+  WpConstraintType type;
+  gchar *subject;
+  GHashTable *by_value; // value -> set of objects
+  GHashTable *values; // object -> value
+  GHashTable *non_numeric; // set of objects whose value is not canonical
+};
+
+/*
+ * Object stores:
+ *
+ * Many object managers, especially the ones of different scripts, are
+ * interested in exactly the same objects (all the devices, the "default"
+ * metadata...). The objects of an object manager are kept in a WpObjectStore,
+ * which is shared by all the installed object managers that have structurally
+ * identical interests and requested features, so that the registry matches
+ * the interests, prepares the objects and maintains the objects array and
+ * the indexes only once for all of them. Each object manager remains a view
+ * of the store, with its own signals.
+ *
+ * A store is shared only while the interests of its views do not change; an
+ * object manager that gets a new interest or requests more features after
+ * being installed moves to a store of its own.
+ */
+
+/* an emission of object-added on the views of a store */
+struct store_emission
+{
+  struct store_emission *prev;
+  gpointer object; // NULL if the object was removed during the emission
+  GPtrArray *views; // element-type: WpObjectManager*, the views to notify
+  guint pos; // the views before this position have been notified
+};
+
+struct _WpObjectStore
+{
+  grefcount ref;
+  /* the key in the registry's object_stores_index, while it can be shared;
+     see wp_object_store_make_key() */
+  gchar *key;
+
+  /* element-type: WpObjectInterest* */
+  GPtrArray *interests;
+  /* element-type: <GType, WpProxyFeatures> */
+  GHashTable *features;
+  /* the object managers that show this store, without a ref,
+     in the order they were installed */
+  GPtrArray *views;
+
+  /* objects that we are interested in, without a ref */
+  GPtrArray *objects;
+  /* object -> its position in objects, for quick removal */
+  GHashTable *object_positions;
+  /* built on demand; see id_index_new() */
+  struct id_index *id_indexes[N_ID_INDEXES];
+  /* element-type: struct prop_index* */
+  GPtrArray *prop_indexes;
+  guint pending_objects;
+  /* proxy -> the features being activated on it, for the pending objects */
+  GHashTable *activating;
+
+  /* the innermost object-added emission that is in progress */
+  struct store_emission *emission;
+};
+
 struct _WpObjectManager
 {
   GObject parent;
@@ -137,12 +304,14 @@ struct _WpObjectManager
   GPtrArray *interests;
   /* element-type: <GType, WpProxyFeatures> */
   GHashTable *features;
-  /* objects that we are interested in, without a ref */
-  GPtrArray *objects;
+  /* the objects that we are interested in */
+  WpObjectStore *store;
+  /* the objects to emit objects-added & objects-removed for, with a ref */
+  GPtrArray *added_batch;
+  GPtrArray *removed_batch;
 
   gboolean installed;
   gboolean changed;
-  guint pending_objects;
   GSource *idle_source;
 };
 
@@ -154,6 +323,8 @@ enum {
 enum {
   SIGNAL_OBJECT_ADDED,
   SIGNAL_OBJECT_REMOVED,
+  SIGNAL_OBJECTS_ADDED,
+  SIGNAL_OBJECTS_REMOVED,
   SIGNAL_OBJECTS_CHANGED,
   SIGNAL_INSTALLED,
   LAST_SIGNAL,
@@ -163,6 +334,335 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE (WpObjectManager, wp_object_manager, G_TYPE_OBJECT)
 
+/* a distinct type, so that bindings know that all the elements are objects */
+typedef GPtrArray WpObjectArray;
+G_DEFINE_BOXED_TYPE (WpObjectArray, wp_object_array,
+    g_ptr_array_ref, g_ptr_array_unref)
+
+/* returns the id of the given kind that the object has right now, if any */
+static gboolean
+object_get_id (gpointer object, IdIndexKind kind, guint64 * id)
+{
+  switch (kind) {
+    case ID_INDEX_BOUND_ID:
+      if (WP_IS_PROXY (object) &&
+          (wp_object_get_active_features (WP_OBJECT (object)) &
+              WP_PROXY_FEATURE_BOUND)) {
+        guint32 bound_id = wp_proxy_get_bound_id (WP_PROXY (object));
+        *id = bound_id;
+        return bound_id != SPA_ID_INVALID;
+      }
+      return FALSE;
+
+    case ID_INDEX_SERIAL:
+      if (WP_IS_GLOBAL_PROXY (object)) {
+        g_autoptr (WpProperties) props =
+            wp_global_proxy_get_global_properties (WP_GLOBAL_PROXY (object));
+        const gchar *serial = props ?
+            wp_properties_get (props, PW_KEY_OBJECT_SERIAL) : NULL;
+        return serial &&
+            g_ascii_string_to_unsigned (serial, 10, 0, G_MAXUINT64, id, NULL);
+      }
+      return FALSE;
+
+    default:
+      g_return_val_if_reached (FALSE);
+  }
+}
+
+static void
+id_index_add (struct id_index * idx, IdIndexKind kind, gpointer object)
+{
+  guint64 id;
+
+  /* ids are unique, but keep any duplicate in the unindexed set, to be safe */
+  if (object_get_id (object, kind, &id) &&
+      !g_hash_table_contains (idx->by_id, &id)) {
+    guint64 *key = g_new (guint64, 1);
+    *key = id;
+    g_hash_table_insert (idx->by_id, key, object);
+    g_hash_table_insert (idx->by_object, object, key);
+  } else {
+    g_hash_table_add (idx->unindexed, object);
+  }
+}
+
+static void
+id_index_remove (struct id_index * idx, gpointer object)
+{
+  guint64 *key = g_hash_table_lookup (idx->by_object, object);
+
+  if (key) {
+    g_hash_table_remove (idx->by_object, object);
+    g_hash_table_remove (idx->by_id, key);
+  } else {
+    g_hash_table_remove (idx->unindexed, object);
+  }
+}
+
+static struct id_index *
+id_index_new (IdIndexKind kind, GPtrArray * objects)
+{
+  struct id_index *idx = g_slice_new0 (struct id_index);
+
+  idx->by_id = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free,
+      NULL);
+  idx->by_object = g_hash_table_new (g_direct_hash, g_direct_equal);
+  idx->unindexed = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (guint i = 0; i < objects->len; i++)
+    id_index_add (idx, kind, g_ptr_array_index (objects, i));
+
+  return idx;
+}
+
+static void
+id_index_free (struct id_index * idx)
+{
+  g_clear_pointer (&idx->by_object, g_hash_table_unref);
+  g_clear_pointer (&idx->by_id, g_hash_table_unref);
+  g_clear_pointer (&idx->unindexed, g_hash_table_unref);
+  g_slice_free (struct id_index, idx);
+}
+
+/* returns the value of the property in the same way that
+   wp_object_interest_matches() finds it */
+static gchar *
+object_dup_property (gpointer object, WpConstraintType type,
+    const gchar * subject)
+{
+  g_autoptr (WpProperties) props = NULL;
+
+  if (type == WP_CONSTRAINT_TYPE_PW_PROPERTY) {
+    if (WP_IS_PIPEWIRE_OBJECT (object) &&
+        (wp_object_get_active_features (WP_OBJECT (object)) &
+            WP_PIPEWIRE_OBJECT_FEATURE_INFO))
+      props = wp_pipewire_object_get_properties (WP_PIPEWIRE_OBJECT (object));
+  } else {
+    if (WP_IS_GLOBAL_PROXY (object))
+      props = wp_global_proxy_get_global_properties (WP_GLOBAL_PROXY (object));
+    if (!props && WP_IS_SESSION_ITEM (object))
+      props = wp_session_item_get_properties (WP_SESSION_ITEM (object));
+  }
+
+  return props ? g_strdup (wp_properties_get (props, subject)) : NULL;
+}
+
+/* whether the value is the canonical form of a number that
+   wp_object_interest_get_equals_key() can return */
+static gboolean
+is_canonical_number (const gchar * value)
+{
+  guint64 n;
+
+  if (!g_ascii_string_to_unsigned (value, 10, 0, G_MAXINT32, &n, NULL))
+    return FALSE;
+  return value[0] != '0' || value[1] == '\0';
+}
+
+static void
+prop_index_add (struct prop_index * idx, gpointer object)
+{
+  gchar *value = object_dup_property (object, idx->type, idx->subject);
+  GHashTable *set;
+
+  if (!value)
+    return;
+
+  set = g_hash_table_lookup (idx->by_value, value);
+  if (!set) {
+    set = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_hash_table_insert (idx->by_value, g_strdup (value), set);
+  }
+  g_hash_table_add (set, object);
+
+  if (!is_canonical_number (value))
+    g_hash_table_add (idx->non_numeric, object);
+
+  /* takes ownership of value */
+  g_hash_table_insert (idx->values, object, value);
+}
+
+static void
+prop_index_remove (struct prop_index * idx, gpointer object)
+{
+  const gchar *value = g_hash_table_lookup (idx->values, object);
+  GHashTable *set;
+
+  if (!value)
+    return;
+
+  set = g_hash_table_lookup (idx->by_value, value);
+  if (set && g_hash_table_remove (set, object) && g_hash_table_size (set) == 0)
+    g_hash_table_remove (idx->by_value, value);
+
+  g_hash_table_remove (idx->non_numeric, object);
+  g_hash_table_remove (idx->values, object);
+}
+
+static struct prop_index *
+prop_index_new (WpConstraintType type, const gchar * subject,
+    GPtrArray * objects)
+{
+  struct prop_index *idx = g_slice_new0 (struct prop_index);
+
+  idx->type = type;
+  idx->subject = g_strdup (subject);
+  idx->by_value = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_hash_table_unref);
+  idx->values = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      g_free);
+  idx->non_numeric = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (guint i = 0; i < objects->len; i++)
+    prop_index_add (idx, g_ptr_array_index (objects, i));
+
+  return idx;
+}
+
+static void
+prop_index_free (struct prop_index * idx)
+{
+  g_clear_pointer (&idx->by_value, g_hash_table_unref);
+  g_clear_pointer (&idx->values, g_hash_table_unref);
+  g_clear_pointer (&idx->non_numeric, g_hash_table_unref);
+  g_clear_pointer (&idx->subject, g_free);
+  g_slice_free (struct prop_index, idx);
+}
+
+static void
+on_object_properties_changed (GObject * object, GParamSpec * pspec,
+    WpObjectStore * self)
+{
+  for (guint i = 0; i < self->prop_indexes->len; i++) {
+    struct prop_index *idx = g_ptr_array_index (self->prop_indexes, i);
+    prop_index_remove (idx, object);
+    prop_index_add (idx, object);
+  }
+}
+
+static WpObjectStore *
+wp_object_store_new (GPtrArray * interests, GHashTable * features)
+{
+  WpObjectStore *self = g_slice_new0 (WpObjectStore);
+
+  g_ref_count_init (&self->ref);
+  self->interests = g_ptr_array_ref (interests);
+  self->features = g_hash_table_ref (features);
+  self->views = g_ptr_array_new ();
+  self->objects = g_ptr_array_new ();
+  self->object_positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->prop_indexes = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) prop_index_free);
+  self->activating = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      g_object_unref, NULL);
+  return self;
+}
+
+static WpObjectStore *
+wp_object_store_ref (WpObjectStore * self)
+{
+  g_ref_count_inc (&self->ref);
+  return self;
+}
+
+static void
+wp_object_store_unref (WpObjectStore * self)
+{
+  if (!g_ref_count_dec (&self->ref))
+    return;
+
+  if (self->prop_indexes->len > 0) {
+    for (guint i = 0; i < self->objects->len; i++)
+      g_signal_handlers_disconnect_by_func (
+          g_ptr_array_index (self->objects, i),
+          on_object_properties_changed, self);
+  }
+  g_clear_pointer (&self->prop_indexes, g_ptr_array_unref);
+  g_clear_pointer (&self->activating, g_hash_table_unref);
+  for (guint i = 0; i < N_ID_INDEXES; i++)
+    g_clear_pointer (&self->id_indexes[i], id_index_free);
+  g_clear_pointer (&self->object_positions, g_hash_table_unref);
+  g_clear_pointer (&self->objects, g_ptr_array_unref);
+  g_clear_pointer (&self->views, g_ptr_array_unref);
+  g_clear_pointer (&self->features, g_hash_table_unref);
+  g_clear_pointer (&self->interests, g_ptr_array_unref);
+  g_clear_pointer (&self->key, g_free);
+  g_slice_free (WpObjectStore, self);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpObjectStore, wp_object_store_unref)
+
+static gint
+gtype_name_cmp (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (g_type_name (*((GType *) a)), g_type_name (*((GType *) b)));
+}
+
+/* returns a string that is the same for two stores
+   only if they are interested in exactly the same objects */
+static gchar *
+wp_object_store_make_key (GPtrArray * interests, GHashTable * features)
+{
+  GString *key = g_string_new (NULL);
+  g_autoptr (GArray) types = g_array_new (FALSE, FALSE, sizeof (GType));
+  GHashTableIter iter;
+  gpointer type;
+
+  for (guint i = 0; i < interests->len; i++)
+    wp_object_interest_append_key (g_ptr_array_index (interests, i), key);
+
+  /* the features of the types that no interest can match do not matter,
+     but they are included anyway; it is not worth filtering them out */
+  g_hash_table_iter_init (&iter, features);
+  while (g_hash_table_iter_next (&iter, &type, NULL)) {
+    GType t = GPOINTER_TO_SIZE (type);
+    g_array_append_val (types, t);
+  }
+  g_array_sort (types, gtype_name_cmp);
+
+  for (guint i = 0; i < types->len; i++) {
+    GType t = g_array_index (types, GType, i);
+    g_string_append_printf (key, "|%s:%x", g_type_name (t), GPOINTER_TO_UINT (
+            g_hash_table_lookup (features, GSIZE_TO_POINTER (t))));
+  }
+
+  return g_string_free (key, FALSE);
+}
+
+static void
+wp_object_store_add_index (WpObjectStore * self, WpConstraintType type,
+    const gchar * subject)
+{
+  for (guint i = 0; i < self->prop_indexes->len; i++) {
+    struct prop_index *idx = g_ptr_array_index (self->prop_indexes, i);
+    if (idx->type == type && !g_strcmp0 (idx->subject, subject))
+      return;
+  }
+
+  /* the first index needs to follow the property changes of the objects */
+  if (self->prop_indexes->len == 0) {
+    for (guint i = 0; i < self->objects->len; i++)
+      g_signal_connect (g_ptr_array_index (self->objects, i),
+          "notify::properties", G_CALLBACK (on_object_properties_changed),
+          self);
+  }
+
+  g_ptr_array_add (self->prop_indexes,
+      prop_index_new (type, subject, self->objects));
+}
+
+/* returns a ref to each of the views, so that they stay alive
+   while signals are emitted on them */
+static GPtrArray *
+wp_object_store_dup_views (WpObjectStore * self)
+{
+  GPtrArray *views = g_ptr_array_copy (self->views,
+      (GCopyFunc) g_object_ref, NULL);
+  g_ptr_array_set_free_func (views, g_object_unref);
+  return views;
+}
+
 static void
 wp_object_manager_init (WpObjectManager * self)
 {
@@ -170,10 +670,12 @@ wp_object_manager_init (WpObjectManager * self)
   self->interests = g_ptr_array_new_with_free_func (
       (GDestroyNotify) wp_object_interest_unref);
   self->features = g_hash_table_new (g_direct_hash, g_direct_equal);
-  self->objects = g_ptr_array_new ();
+  /* a store of its own until it is installed */
+  self->store = wp_object_store_new (self->interests, self->features);
+  self->added_batch = g_ptr_array_new_with_free_func (g_object_unref);
+  self->removed_batch = g_ptr_array_new_with_free_func (g_object_unref);
   self->installed = FALSE;
   self->changed = FALSE;
-  self->pending_objects = 0;
 }
 
 static void
@@ -185,7 +687,11 @@ wp_object_manager_finalize (GObject * object)
     g_source_destroy (self->idle_source);
     g_clear_pointer (&self->idle_source, g_source_unref);
   }
-  g_clear_pointer (&self->objects, g_ptr_array_unref);
+  /* normally done already by the registry, unless it was cleared */
+  g_ptr_array_remove (self->store->views, self);
+  g_clear_pointer (&self->store, wp_object_store_unref);
+  g_clear_pointer (&self->added_batch, g_ptr_array_unref);
+  g_clear_pointer (&self->removed_batch, g_ptr_array_unref);
   g_clear_pointer (&self->features, g_hash_table_unref);
   g_clear_pointer (&self->interests, g_ptr_array_unref);
   g_weak_ref_clear (&self->core);
@@ -231,6 +737,14 @@ wp_object_manager_class_init (WpObjectManagerClass * klass)
       "object-removed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_FIRST,
       0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_OBJECT);
 
+  signals[SIGNAL_OBJECTS_ADDED] = g_signal_new (
+      "objects-added", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_FIRST,
+      0, NULL, NULL, NULL, G_TYPE_NONE, 1, WP_TYPE_OBJECT_ARRAY);
+
+  signals[SIGNAL_OBJECTS_REMOVED] = g_signal_new (
+      "objects-removed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_FIRST,
+      0, NULL, NULL, NULL, G_TYPE_NONE, 1, WP_TYPE_OBJECT_ARRAY);
+
   signals[SIGNAL_OBJECTS_CHANGED] = g_signal_new (
       "objects-changed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_FIRST,
       0, NULL, NULL, NULL, G_TYPE_NONE, 0);
@@ -265,6 +779,8 @@ wp_object_manager_is_installed (WpObjectManager * self)
   return self->installed;
 }
 
+static void wp_object_manager_detach_store (WpObjectManager * self);
+
 /*!
  * \brief Equivalent to:
  * \code
@@ -319,7 +835,45 @@ wp_object_manager_add_interest_full (WpObjectManager *self,
     wp_object_interest_unref (interest);
     return;
   }
+  wp_object_manager_detach_store (self);
   g_ptr_array_add (self->interests, interest);
+
+  /* the registry indexes interests of installed managers; rebuild it */
+  {
+    g_autoptr (WpCore) core = g_weak_ref_get (&self->core);
+    if (core)
+      wp_registry_invalidate_dispatch_index (wp_core_get_registry (core));
+  }
+}
+
+/*!
+ * \brief Adds an index on a property of the managed objects.
+ *
+ * Lookups and filtered iterators with an interest that requires the
+ * property \a subject to be equal to a value, with a constraint of the same
+ * \a type, then only check the objects that have this value, instead of all
+ * the managed objects. This is worth doing for properties that are used in
+ * lookups very often, such as "node.name". The index is kept up to date as
+ * objects are added, removed or change their properties.
+ *
+ * \ingroup wpobjectmanager
+ * \param self the object manager
+ * \param type the type of the property; either
+ *   WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY or WP_CONSTRAINT_TYPE_PW_PROPERTY
+ * \param subject the name of the property
+ * \since 0.4.18
+ */
+void
+wp_object_manager_add_index (WpObjectManager * self, WpConstraintType type,
+    const gchar * subject)
+{
+  g_return_if_fail (WP_IS_OBJECT_MANAGER (self));
+  g_return_if_fail (type == WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY ||
+      type == WP_CONSTRAINT_TYPE_PW_PROPERTY);
+  g_return_if_fail (subject != NULL);
+
+  /* the index does not change the results, so a shared store can have it */
+  wp_object_store_add_index (self->store, type, subject);
 }
 
 static void
@@ -360,6 +914,7 @@ wp_object_manager_request_object_features (WpObjectManager *self,
   g_return_if_fail (WP_IS_OBJECT_MANAGER (self));
   g_return_if_fail (g_type_is_a (object_type, WP_TYPE_OBJECT));
 
+  wp_object_manager_detach_store (self);
   g_hash_table_insert (self->features, GSIZE_TO_POINTER (object_type),
       GUINT_TO_POINTER (wanted_features));
   store_children_object_features (self->features, object_type, wanted_features);
@@ -375,7 +930,7 @@ guint
 wp_object_manager_get_n_objects (WpObjectManager * self)
 {
   g_return_val_if_fail (WP_IS_OBJECT_MANAGER (self), 0);
-  return self->objects->len;
+  return self->store->objects->len;
 }
 
 struct om_iterator_data
@@ -453,6 +1008,95 @@ static const WpIteratorMethods om_iterator_methods = {
   .finalize = om_iterator_finalize,
 };
 
+static gint
+object_position_cmp (gconstpointer a, gconstpointer b, gpointer data)
+{
+  GHashTable *positions = data;
+  guint pa = GPOINTER_TO_UINT (g_hash_table_lookup (positions,
+      *((gpointer *) a)));
+  guint pb = GPOINTER_TO_UINT (g_hash_table_lookup (positions,
+      *((gpointer *) b)));
+  return (pa > pb) - (pa < pb);
+}
+
+/* returns the objects that may match the interest; this is a subset of the
+   managed objects if the interest requires a specific id, in which case the
+   id index is used, or a copy of all of them otherwise */
+static GPtrArray *
+wp_object_store_get_candidates (WpObjectStore * self,
+    WpObjectInterest * interest)
+{
+  for (guint k = 0; k < N_ID_INDEXES; k++) {
+    struct id_index *idx;
+    GPtrArray *res;
+    GHashTableIter iter;
+    gpointer object;
+    guint64 id;
+
+    if (!wp_object_interest_get_equals_id (interest, id_index_keys[k].type,
+            id_index_keys[k].subject, &id))
+      continue;
+
+    if (!self->id_indexes[k])
+      self->id_indexes[k] = id_index_new (k, self->objects);
+    idx = self->id_indexes[k];
+
+    res = g_ptr_array_sized_new (g_hash_table_size (idx->unindexed) + 1);
+    object = g_hash_table_lookup (idx->by_id, &id);
+    if (object)
+      g_ptr_array_add (res, object);
+
+    g_hash_table_iter_init (&iter, idx->unindexed);
+    while (g_hash_table_iter_next (&iter, &object, NULL))
+      g_ptr_array_add (res, object);
+
+    /* keep the order of the objects array, as without the index */
+    if (res->len > 1)
+      g_ptr_array_sort_with_data (res, object_position_cmp,
+          self->object_positions);
+
+    return res;
+  }
+
+  for (guint k = 0; k < self->prop_indexes->len; k++) {
+    struct prop_index *idx = g_ptr_array_index (self->prop_indexes, k);
+    g_autofree gchar *value = NULL;
+    gboolean numeric = FALSE;
+    GHashTable *set;
+    GPtrArray *res;
+    GHashTableIter iter;
+    gpointer object;
+
+    value = wp_object_interest_get_equals_key (interest, idx->type,
+        idx->subject, &numeric);
+    if (!value)
+      continue;
+
+    set = g_hash_table_lookup (idx->by_value, value);
+    res = g_ptr_array_sized_new ((set ? g_hash_table_size (set) : 0) +
+        (numeric ? g_hash_table_size (idx->non_numeric) : 0));
+
+    if (set) {
+      g_hash_table_iter_init (&iter, set);
+      while (g_hash_table_iter_next (&iter, &object, NULL))
+        g_ptr_array_add (res, object);
+    }
+    if (numeric) {
+      g_hash_table_iter_init (&iter, idx->non_numeric);
+      while (g_hash_table_iter_next (&iter, &object, NULL))
+        g_ptr_array_add (res, object);
+    }
+
+    if (res->len > 1)
+      g_ptr_array_sort_with_data (res, object_position_cmp,
+          self->object_positions);
+
+    return res;
+  }
+
+  return g_ptr_array_copy (self->objects, NULL, NULL);
+}
+
 /*!
  * \brief Iterates through all the objects managed by this object manager.
  * \ingroup wpobjectmanager
@@ -471,7 +1115,7 @@ wp_object_manager_new_iterator (WpObjectManager * self)
   it = wp_iterator_new (&om_iterator_methods, sizeof (struct om_iterator_data));
   it_data = wp_iterator_get_user_data (it);
   it_data->om = g_object_ref (self);
-  it_data->objects = g_ptr_array_copy (self->objects, NULL, NULL);
+  it_data->objects = g_ptr_array_copy (self->store->objects, NULL, NULL);
   it_data->index = 0;
   return it;
 }
@@ -539,7 +1183,7 @@ wp_object_manager_new_filtered_iterator_full (WpObjectManager * self,
   it = wp_iterator_new (&om_iterator_methods, sizeof (struct om_iterator_data));
   it_data = wp_iterator_get_user_data (it);
   it_data->om = g_object_ref (self);
-  it_data->objects = g_ptr_array_copy (self->objects, NULL, NULL);
+  it_data->objects = wp_object_store_get_candidates (self->store, interest);
   it_data->interest = interest;
   it_data->index = 0;
   return it;
@@ -606,7 +1250,7 @@ wp_object_manager_lookup_full (WpObjectManager * self,
 }
 
 static gboolean
-wp_object_manager_is_interested_in_object (WpObjectManager * self,
+wp_object_store_is_interested_in_object (WpObjectStore * self,
     GObject * object)
 {
   guint i;
@@ -621,7 +1265,37 @@ wp_object_manager_is_interested_in_object (WpObjectManager * self,
 }
 
 static gboolean
-wp_object_manager_is_interested_in_global (WpObjectManager * self,
+wp_object_store_interest_matches_global (WpObjectStore * self,
+    WpObjectInterest * interest, WpGlobal * global,
+    WpObjectFeatures * wanted_features)
+{
+  /* check all constraints */
+  WpInterestMatch match = wp_object_interest_matches_full (interest,
+      WP_INTEREST_MATCH_FLAGS_CHECK_ALL, global->type, global->proxy,
+      NULL, global->properties);
+
+  /* and consider the manager interested if the type and the globals match...
+     if pw_properties / g_properties fail, that's ok because they are not
+     known yet (the proxy is likely NULL and properties not yet retrieved) */
+  if (SPA_FLAG_IS_SET (match, (WP_INTEREST_MATCH_GTYPE |
+                               WP_INTEREST_MATCH_PW_GLOBAL_PROPERTIES))) {
+    gpointer ft = g_hash_table_lookup (self->features,
+        GSIZE_TO_POINTER (global->type));
+    *wanted_features = (WpObjectFeatures) GPOINTER_TO_UINT (ft);
+
+    /* force INFO to be present so that we can check PW_PROPERTIES constraints */
+    if (!(match & WP_INTEREST_MATCH_PW_PROPERTIES) &&
+          !(*wanted_features & WP_PIPEWIRE_OBJECT_FEATURE_INFO) &&
+          g_type_is_a (global->type, WP_TYPE_PIPEWIRE_OBJECT))
+      *wanted_features |= WP_PIPEWIRE_OBJECT_FEATURE_INFO;
+
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+wp_object_store_is_interested_in_global (WpObjectStore * self,
     WpGlobal * global, WpObjectFeatures * wanted_features)
 {
   guint i;
@@ -629,39 +1303,60 @@ wp_object_manager_is_interested_in_global (WpObjectManager * self,
 
   for (i = 0; i < self->interests->len; i++) {
     interest = g_ptr_array_index (self->interests, i);
-
-    /* check all constraints */
-    WpInterestMatch match = wp_object_interest_matches_full (interest,
-        WP_INTEREST_MATCH_FLAGS_CHECK_ALL, global->type, global->proxy,
-        NULL, global->properties);
-
-    /* and consider the manager interested if the type and the globals match...
-       if pw_properties / g_properties fail, that's ok because they are not
-       known yet (the proxy is likely NULL and properties not yet retrieved) */
-    if (SPA_FLAG_IS_SET (match, (WP_INTEREST_MATCH_GTYPE |
-                                 WP_INTEREST_MATCH_PW_GLOBAL_PROPERTIES))) {
-      gpointer ft = g_hash_table_lookup (self->features,
-          GSIZE_TO_POINTER (global->type));
-      *wanted_features = (WpObjectFeatures) GPOINTER_TO_UINT (ft);
-
-      /* force INFO to be present so that we can check PW_PROPERTIES constraints */
-      if (!(match & WP_INTEREST_MATCH_PW_PROPERTIES) &&
-            !(*wanted_features & WP_PIPEWIRE_OBJECT_FEATURE_INFO) &&
-            g_type_is_a (global->type, WP_TYPE_PIPEWIRE_OBJECT))
-        *wanted_features |= WP_PIPEWIRE_OBJECT_FEATURE_INFO;
-
+    if (wp_object_store_interest_matches_global (self, interest, global,
+            wanted_features))
       return TRUE;
-    }
   }
   return FALSE;
 }
 
+/* emits objects-removed / objects-added with the objects of the batch,
+   if there are any, and starts a new batch */
+static void
+wp_object_manager_emit_batch (WpObjectManager * self, GPtrArray ** batch,
+    guint signal)
+{
+  g_autoptr (GPtrArray) objects = NULL;
+
+  if ((*batch)->len == 0)
+    return;
+
+  objects = g_steal_pointer (batch);
+  *batch = g_ptr_array_new_with_free_func (g_object_unref);
+
+  wp_trace_object (self, "emit %s: %u objects",
+      g_signal_name (signals[signal]), objects->len);
+  g_signal_emit (self, signals[signal], 0, objects);
+}
+
+/* whether there are objects that may still appear on the object manager;
+   'installed' waits for them */
+static gboolean
+wp_object_manager_has_pending_objects (WpObjectManager * self)
+{
+  g_autoptr (WpCore) core = NULL;
+
+  if (self->store->pending_objects > 0)
+    return TRUE;
+
+  core = g_weak_ref_get (&self->core);
+  return core && wp_registry_has_pending_globals (wp_core_get_registry (core));
+}
+
 static gboolean
 idle_emit_objects_changed (WpObjectManager * self)
 {
   g_clear_pointer (&self->idle_source, g_source_unref);
 
-  if (G_UNLIKELY (!self->installed)) {
+  wp_object_manager_emit_batch (self, &self->removed_batch,
+      SIGNAL_OBJECTS_REMOVED);
+  wp_object_manager_emit_batch (self, &self->added_batch,
+      SIGNAL_OBJECTS_ADDED);
+
+  /* objects of earlier time slices of an expose batch may be ready while
+     the rest of the batch is not exposed yet; see expose_tmp_globals() */
+  if (G_UNLIKELY (!self->installed) &&
+      !wp_object_manager_has_pending_objects (self)) {
     wp_trace_object (self, "installed");
     g_signal_emit (self, signals[SIGNAL_INSTALLED], 0);
     self->installed = TRUE;
@@ -676,10 +1371,11 @@ static void
 wp_object_manager_maybe_objects_changed (WpObjectManager * self)
 {
   wp_trace_object (self, "pending:%u changed:%d idle_source:%p installed:%d",
-      self->pending_objects, self->changed, self->idle_source, self->installed);
+      self->store->pending_objects, self->changed, self->idle_source,
+      self->installed);
 
   /* always wait until there are no pending objects */
-  if (self->pending_objects > 0)
+  if (self->store->pending_objects > 0)
     return;
 
   /* Emit 'objects-changed' when:
@@ -715,7 +1411,8 @@ wp_object_manager_maybe_objects_changed (WpObjectManager * self)
     g_autoptr (WpCore) core = g_weak_ref_get (&self->core);
     if (core) {
       WpRegistry *reg = wp_core_get_registry (core);
-      if (reg->tmp_globals->len == 0 && reg->globals->len != 0) {
+      if (!wp_object_manager_has_pending_objects (self) &&
+          g_hash_table_size (reg->globals) != 0) {
         wp_trace_object (self, "installed");
         g_signal_emit (self, signals[SIGNAL_INSTALLED], 0);
         self->installed = TRUE;
@@ -724,50 +1421,188 @@ wp_object_manager_maybe_objects_changed (WpObjectManager * self)
   }
 }
 
-/* caller must also call wp_object_manager_maybe_objects_changed() after */
 static void
-wp_object_manager_add_object (WpObjectManager * self, gpointer object)
+wp_object_manager_notify_added (WpObjectManager * self, gpointer object)
 {
-  if (wp_object_manager_is_interested_in_object (self, object)) {
-    wp_trace_object (self, "added: " WP_OBJECT_FORMAT, WP_OBJECT_ARGS (object));
-    g_ptr_array_add (self->objects, object);
-    g_signal_emit (self, signals[SIGNAL_OBJECT_ADDED], 0, object);
-    self->changed = TRUE;
-  }
+  self->changed = TRUE;
+  if (g_signal_has_handler_pending (self, signals[SIGNAL_OBJECTS_ADDED], 0,
+          FALSE))
+    g_ptr_array_add (self->added_batch, g_object_ref (object));
+  g_signal_emit (self, signals[SIGNAL_OBJECT_ADDED], 0, object);
 }
 
-/* caller must also call wp_object_manager_maybe_objects_changed() after */
 static void
-wp_object_manager_rm_object (WpObjectManager * self, gpointer object)
+wp_object_manager_notify_removed (WpObjectManager * self, gpointer object)
 {
-  guint index;
-  if (g_ptr_array_find (self->objects, object, &index)) {
-    g_ptr_array_remove_index_fast (self->objects, index);
-    g_signal_emit (self, signals[SIGNAL_OBJECT_REMOVED], 0, object);
-    self->changed = TRUE;
-  }
+  self->changed = TRUE;
+  /* an object that is removed before its batch is emitted
+     does not appear in any batch */
+  if (!g_ptr_array_remove (self->added_batch, object) &&
+      g_signal_has_handler_pending (self, signals[SIGNAL_OBJECTS_REMOVED], 0,
+          FALSE))
+    g_ptr_array_add (self->removed_batch, g_object_ref (object));
+  g_signal_emit (self, signals[SIGNAL_OBJECT_REMOVED], 0, object);
 }
 
 static void
-on_proxy_ready (GObject * proxy, GAsyncResult * res, gpointer data)
+wp_object_store_maybe_objects_changed (WpObjectStore * self)
 {
-  g_autoptr (WpObjectManager) self = WP_OBJECT_MANAGER (data);
-  g_autoptr (GError) error = NULL;
+  g_autoptr (GPtrArray) views = wp_object_store_dup_views (self);
 
-  self->pending_objects--;
+  for (guint i = 0; i < views->len; i++)
+    wp_object_manager_maybe_objects_changed (g_ptr_array_index (views, i));
+}
+
+/* caller must also call wp_object_store_maybe_objects_changed() after */
+static void
+wp_object_store_add_matched_object (WpObjectStore * self, gpointer object)
+{
+  struct store_emission e = { self->emission, object, NULL, 0 };
+
+  wp_trace ("store:%p added: " WP_OBJECT_FORMAT, self,
+      WP_OBJECT_ARGS (object));
+  g_hash_table_insert (self->object_positions, object,
+      GUINT_TO_POINTER (self->objects->len));
+  g_ptr_array_add (self->objects, object);
+  for (guint i = 0; i < N_ID_INDEXES; i++) {
+    if (self->id_indexes[i])
+      id_index_add (self->id_indexes[i], i, object);
+  }
+  if (self->prop_indexes->len > 0) {
+    for (guint i = 0; i < self->prop_indexes->len; i++)
+      prop_index_add (g_ptr_array_index (self->prop_indexes, i), object);
+    g_signal_connect (object, "notify::properties",
+        G_CALLBACK (on_object_properties_changed), self);
+  }
+
+  /* views that are installed during the emission find the object in the
+     store already; see also wp_object_store_rm_object() */
+  e.views = wp_object_store_dup_views (self);
+  self->emission = &e;
+  while (e.object && e.pos < e.views->len) {
+    WpObjectManager *om = g_ptr_array_index (e.views, e.pos++);
+    wp_object_manager_notify_added (om, object);
+  }
+  self->emission = e.prev;
+  g_ptr_array_unref (e.views);
+}
+
+/* caller must also call wp_object_store_maybe_objects_changed() after */
+static void
+wp_object_store_add_object (WpObjectStore * self, gpointer object)
+{
+  if (wp_object_store_is_interested_in_object (self, object))
+    wp_object_store_add_matched_object (self, object);
+}
+
+static gboolean
+store_emission_is_pending (struct store_emission * e, WpObjectManager * om)
+{
+  for (guint i = e->pos; i < e->views->len; i++) {
+    if (g_ptr_array_index (e->views, i) == om)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* caller must also call wp_object_store_maybe_objects_changed() after */
+static void
+wp_object_store_rm_object (WpObjectStore * self, gpointer object)
+{
+  g_autoptr (GPtrArray) views = NULL;
+  struct store_emission *e;
+  gpointer pos;
+  guint index;
+
+  if (!g_hash_table_steal_extended (self->object_positions, object, NULL,
+          &pos))
+    return;
+
+  /* the last object takes the place of the removed one */
+  index = GPOINTER_TO_UINT (pos);
+  g_ptr_array_remove_index_fast (self->objects, index);
+  if (index < self->objects->len)
+    g_hash_table_insert (self->object_positions,
+        g_ptr_array_index (self->objects, index), pos);
+
+  for (guint i = 0; i < N_ID_INDEXES; i++) {
+    if (self->id_indexes[i])
+      id_index_remove (self->id_indexes[i], object);
+  }
+  if (self->prop_indexes->len > 0) {
+    for (guint i = 0; i < self->prop_indexes->len; i++)
+      prop_index_remove (g_ptr_array_index (self->prop_indexes, i), object);
+    g_signal_handlers_disconnect_by_func (object,
+        on_object_properties_changed, self);
+  }
+
+  /* if object-added is still being emitted for this object, stop it;
+     the views that were not notified about it yet are not notified now */
+  for (e = self->emission; e && e->object != object; e = e->prev);
+  if (e)
+    e->object = NULL;
+
+  views = wp_object_store_dup_views (self);
+  for (guint i = 0; i < views->len; i++) {
+    WpObjectManager *om = g_ptr_array_index (views, i);
+
+    if (e && store_emission_is_pending (e, om))
+      continue;
+
+    wp_object_manager_notify_removed (om, object);
+  }
+}
+
+static void
+on_proxy_ready (GObject * proxy, GAsyncResult * res, gpointer data)
+{
+  g_autoptr (WpObjectStore) self = data;
+  g_autoptr (GError) error = NULL;
+
+  self->pending_objects--;
+  g_hash_table_remove (self->activating, proxy);
 
   if (!wp_object_activate_finish (WP_OBJECT (proxy), res, &error)) {
-    wp_debug_object (self, "proxy activation failed: %s", error->message);
+    wp_debug ("store:%p proxy activation failed: %s", self, error->message);
   } else {
-    wp_object_manager_add_object (self, proxy);
+    wp_object_store_add_object (self, proxy);
   }
 
-  wp_object_manager_maybe_objects_changed (self);
+  wp_object_store_maybe_objects_changed (self);
+}
+
+static void
+wp_object_store_activate (WpObjectStore * self, gpointer proxy,
+    WpObjectFeatures features)
+{
+  self->pending_objects++;
+  g_hash_table_insert (self->activating, g_object_ref (proxy),
+      GUINT_TO_POINTER (features));
+  wp_object_activate (WP_OBJECT (proxy), features, NULL,
+      on_proxy_ready, wp_object_store_ref (self));
 }
 
-/* caller must also call wp_object_manager_maybe_objects_changed() after */
+/* caller must also call wp_object_store_maybe_objects_changed() after */
 static void
-wp_object_manager_add_global (WpObjectManager * self, WpGlobal * global)
+wp_object_store_add_matched_global (WpObjectStore * self, WpCore * core,
+    WpGlobal * global, WpObjectFeatures features)
+{
+  if (!global->proxy)
+    global->proxy = g_object_new (global->type,
+        "core", core,
+        "global", global,
+        NULL);
+
+  wp_trace ("store:%p adding global:%u -> " WP_OBJECT_FORMAT, self,
+      global->id, WP_OBJECT_ARGS (global->proxy));
+
+  wp_object_store_activate (self, global->proxy, features);
+}
+
+/* caller must also call wp_object_store_maybe_objects_changed() after */
+static void
+wp_object_store_add_global (WpObjectStore * self, WpCore * core,
+    WpGlobal * global)
 {
   WpProxyFeatures features = 0;
 
@@ -776,23 +1611,8 @@ wp_object_manager_add_global (WpObjectManager * self, WpGlobal * global)
   if (global->type == WP_TYPE_GLOBAL_PROXY)
     return;
 
-  if (wp_object_manager_is_interested_in_global (self, global, &features)) {
-    g_autoptr (WpCore) core = g_weak_ref_get (&self->core);
-
-    self->pending_objects++;
-
-    if (!global->proxy)
-      global->proxy = g_object_new (global->type,
-          "core", core,
-          "global", global,
-          NULL);
-
-    wp_trace_object (self, "adding global:%u -> " WP_OBJECT_FORMAT,
-        global->id, WP_OBJECT_ARGS (global->proxy));
-
-    wp_object_activate (WP_OBJECT (global->proxy), features, NULL,
-        on_proxy_ready, g_object_ref (self));
-  }
+  if (wp_object_store_is_interested_in_global (self, global, &features))
+    wp_object_store_add_matched_global (self, core, global, features);
 }
 
 /*
@@ -849,12 +1669,293 @@ wp_object_manager_add_global (WpObjectManager * self, WpGlobal * global)
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "wp-registry"
 
+/* the time that exposing new globals may take on every main loop iteration */
+#define EXPOSE_SLICE_USEC 2000
+
+/*
+ * Interest dispatch index:
+ *
+ * Instead of checking every new object against every interest of every
+ * installed object manager, the registry keeps an index of all the interests,
+ * bucketed by the GType of the objects that they can match. Within each
+ * bucket, interests that require a specific value on one of the well-known
+ * global properties below (with a WP_CONSTRAINT_VERB_EQUALS constraint) are
+ * further indexed by that value, so that a new object is only checked against
+ * the interests that could possibly match it.
+ *
+ * Buckets are built lazily, the first time that an object of a certain GType
+ * is dispatched, and the whole index is dropped whenever an object manager is
+ * installed, destroyed or gets a new interest.
+ */
+
+static const struct {
+  const gchar *key;
+  gboolean numeric;
+} dispatch_keys[] = {
+  { PW_KEY_MEDIA_CLASS, FALSE },
+  { PW_KEY_NODE_NAME, FALSE },
+  { PW_KEY_DEVICE_NAME, FALSE },
+  { PW_KEY_PORT_DIRECTION, FALSE },
+  { "metadata.name", FALSE },
+  /* always formatted with "%u" by wp_registry_prepare_new_global() */
+  { PW_KEY_OBJECT_ID, TRUE },
+};
+
+struct dispatch_entry
+{
+  WpObjectStore *store;
+  WpObjectInterest *interest;
+  /* the order in which stores were installed & interests were added */
+  guint rank;
+};
+
+struct dispatch_bucket
+{
+  /* element-type: struct dispatch_entry */
+  GArray *unkeyed;
+  /* key (static string) -> (value -> GArray of struct dispatch_entry) */
+  GHashTable *keyed;
+};
+
+static void
+dispatch_bucket_free (struct dispatch_bucket * b)
+{
+  g_clear_pointer (&b->unkeyed, g_array_unref);
+  g_clear_pointer (&b->keyed, g_hash_table_unref);
+  g_slice_free (struct dispatch_bucket, b);
+}
+
+static void
+dispatch_entry_clear (struct dispatch_entry * e)
+{
+  g_clear_pointer (&e->store, wp_object_store_unref);
+}
+
+static gint
+dispatch_entry_cmp (gconstpointer a, gconstpointer b)
+{
+  const struct dispatch_entry *ea = a, *eb = b;
+  return (ea->rank > eb->rank) - (ea->rank < eb->rank);
+}
+
+void
+wp_registry_invalidate_dispatch_index (WpRegistry * self)
+{
+  g_clear_pointer (&self->dispatch_index, g_hash_table_unref);
+}
+
+static void
+dispatch_bucket_add_keyed (struct dispatch_bucket * b, const gchar * key,
+    gchar * value, const struct dispatch_entry * e)
+{
+  GHashTable *values;
+  GArray *entries;
+
+  if (!b->keyed)
+    b->keyed = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify) g_hash_table_unref);
+
+  values = g_hash_table_lookup (b->keyed, key);
+  if (!values) {
+    values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) g_array_unref);
+    g_hash_table_insert (b->keyed, (gpointer) key, values);
+  }
+
+  entries = g_hash_table_lookup (values, value);
+  if (!entries) {
+    entries = g_array_new (FALSE, FALSE, sizeof (struct dispatch_entry));
+    g_hash_table_insert (values, value, entries);
+  } else {
+    g_free (value);
+  }
+  g_array_append_val (entries, *e);
+}
+
+static struct dispatch_bucket *
+wp_registry_get_dispatch_bucket (WpRegistry * self, GType type)
+{
+  struct dispatch_bucket *b;
+  guint rank = 0;
+
+  if (!self->dispatch_index) {
+    self->dispatch_index = g_hash_table_new_full (g_direct_hash,
+        g_direct_equal, NULL, (GDestroyNotify) dispatch_bucket_free);
+
+    self->n_interests = 0;
+    for (guint i = 0; i < self->object_stores->len; i++) {
+      WpObjectStore *store = g_ptr_array_index (self->object_stores, i);
+      self->n_interests += store->interests->len;
+    }
+  }
+
+  b = g_hash_table_lookup (self->dispatch_index, GSIZE_TO_POINTER (type));
+  if (b)
+    return b;
+
+  b = g_slice_new0 (struct dispatch_bucket);
+  b->unkeyed = g_array_new (FALSE, FALSE, sizeof (struct dispatch_entry));
+
+  for (guint i = 0; i < self->object_stores->len; i++) {
+    WpObjectStore *store = g_ptr_array_index (self->object_stores, i);
+
+    for (guint j = 0; j < store->interests->len; j++) {
+      WpObjectInterest *interest = g_ptr_array_index (store->interests, j);
+      struct dispatch_entry e = { store, interest, rank++ };
+      gchar *value = NULL;
+      guint k;
+
+      if (!g_type_is_a (type, wp_object_interest_get_gtype (interest)))
+        continue;
+
+      for (k = 0; k < G_N_ELEMENTS (dispatch_keys) && !value; k++)
+        value = wp_object_interest_get_equals_string (interest,
+            dispatch_keys[k].key, dispatch_keys[k].numeric);
+
+      if (value)
+        dispatch_bucket_add_keyed (b, dispatch_keys[k - 1].key, value, &e);
+      else
+        g_array_append_val (b->unkeyed, e);
+    }
+  }
+
+  wp_trace_object (wp_registry_get_core (self),
+      "built dispatch bucket for %s: %u unkeyed, %u keys", g_type_name (type),
+      b->unkeyed->len, b->keyed ? g_hash_table_size (b->keyed) : 0);
+
+  g_hash_table_insert (self->dispatch_index, GSIZE_TO_POINTER (type), b);
+  return b;
+}
+
+static gboolean
+publish_dispatch_stats (WpCore * core)
+{
+  WpRegistry *self = wp_core_get_registry (core);
+  WpProperties *props = wp_properties_new_empty ();
+
+  g_clear_pointer (&self->stats_source, g_source_unref);
+
+  wp_properties_setf (props, "wireplumber.registry.interest-checks",
+      "%" G_GUINT64_FORMAT, self->interest_checks);
+  wp_properties_setf (props, "wireplumber.registry.interest-skips",
+      "%" G_GUINT64_FORMAT, self->interest_skips);
+  wp_properties_setf (props, "wireplumber.registry.expose-stalls",
+      "<0.25ms:%" G_GUINT64_FORMAT " <0.5ms:%" G_GUINT64_FORMAT
+      " <1ms:%" G_GUINT64_FORMAT " <2ms:%" G_GUINT64_FORMAT
+      " <4ms:%" G_GUINT64_FORMAT " <8ms:%" G_GUINT64_FORMAT
+      " <16ms:%" G_GUINT64_FORMAT " >=16ms:%" G_GUINT64_FORMAT,
+      self->expose_stalls[0], self->expose_stalls[1], self->expose_stalls[2],
+      self->expose_stalls[3], self->expose_stalls[4], self->expose_stalls[5],
+      self->expose_stalls[6], self->expose_stalls[7]);
+  wp_properties_setf (props, "wireplumber.registry.expose-stall-max",
+      "%" G_GINT64_FORMAT, self->expose_stall_max);
+  wp_properties_setf (props, "wireplumber.registry.object-managers",
+      "%u", self->object_managers->len);
+  wp_properties_setf (props, "wireplumber.registry.object-stores",
+      "%u", self->object_stores->len);
+  wp_core_update_properties (core, props);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* publishes the dispatch counters on the daemon's client object, where
+   they can be inspected with wpctl; rate-limited to once per second */
+static void
+wp_registry_schedule_publish_stats (WpRegistry * self)
+{
+  WpCore *core = wp_registry_get_core (self);
+  g_autoptr (WpProperties) props = NULL;
+  const gchar *str;
+
+  if (self->stats_source)
+    return;
+
+  props = wp_core_get_properties (core);
+  str = wp_properties_get (props, "wireplumber.daemon");
+  if (!str || !pw_properties_parse_bool (str))
+    return;
+
+  wp_core_timeout_add_closure (core, &self->stats_source, 1000,
+      g_cclosure_new_object (G_CALLBACK (publish_dispatch_stats),
+          G_OBJECT (core)));
+}
+
+/*
+ * Returns the (object store, interest) pairs that could possibly match
+ * an object of the given \a type with the given global properties, sorted
+ * by rank, so that per-store interest order is preserved.
+ * Every entry holds a ref on its object store.
+ */
+static GArray *
+wp_registry_find_dispatch_candidates (WpRegistry * self, GType type,
+    WpProperties * props)
+{
+  struct dispatch_bucket *b = wp_registry_get_dispatch_bucket (self, type);
+  GArray *res;
+
+  res = g_array_sized_new (FALSE, FALSE, sizeof (struct dispatch_entry),
+      b->unkeyed->len);
+  g_array_set_clear_func (res, (GDestroyNotify) dispatch_entry_clear);
+  g_array_append_vals (res, b->unkeyed->data, b->unkeyed->len);
+
+  if (props && b->keyed) {
+    GHashTableIter iter;
+    gpointer key, values;
+
+    g_hash_table_iter_init (&iter, b->keyed);
+    while (g_hash_table_iter_next (&iter, &key, &values)) {
+      const gchar *value = wp_properties_get (props, key);
+      GArray *entries = value ? g_hash_table_lookup (values, value) : NULL;
+      if (entries)
+        g_array_append_vals (res, entries->data, entries->len);
+    }
+    g_array_sort (res, dispatch_entry_cmp);
+  }
+
+  for (guint i = 0; i < res->len; i++)
+    wp_object_store_ref (g_array_index (res, struct dispatch_entry, i).store);
+
+  self->interest_checks += res->len;
+  self->interest_skips += self->n_interests - res->len;
+  wp_registry_schedule_publish_stats (self);
+
+  return res;
+}
+
 static void
 wp_registry_notify_add_object (WpRegistry *self, gpointer object)
 {
+  g_autoptr (WpProperties) props = NULL;
+  g_autoptr (GArray) candidates = NULL;
+  WpObjectStore *matched_store = NULL;
+  /* a signal handler may remove the object while it is being added */
+  g_autoptr (GObject) ref = g_object_ref (object);
+
+  /* these are the properties that PW_GLOBAL_PROPERTY constraints check */
+  if (WP_IS_GLOBAL_PROXY (object))
+    props = wp_global_proxy_get_global_properties (object);
+  else if (WP_IS_SESSION_ITEM (object))
+    props = wp_session_item_get_properties (object);
+
+  candidates = wp_registry_find_dispatch_candidates (self,
+      G_OBJECT_TYPE (object), props);
+
+  for (guint i = 0; i < candidates->len; i++) {
+    struct dispatch_entry *e =
+        &g_array_index (candidates, struct dispatch_entry, i);
+
+    /* entries of the same store are consecutive; add only once */
+    if (e->store == matched_store)
+      continue;
+
+    if (wp_object_interest_matches (e->interest, object)) {
+      matched_store = e->store;
+      wp_object_store_add_matched_object (e->store, object);
+    }
+  }
+
   for (guint i = 0; i < self->object_managers->len; i++) {
     WpObjectManager *om = g_ptr_array_index (self->object_managers, i);
-    wp_object_manager_add_object (om, object);
     wp_object_manager_maybe_objects_changed (om);
   }
 }
@@ -862,18 +1963,43 @@ wp_registry_notify_add_object (WpRegistry *self, gpointer object)
 static void
 wp_registry_notify_rm_object (WpRegistry *self, gpointer object)
 {
-  for (guint i = 0; i < self->object_managers->len; i++) {
-    WpObjectManager *om = g_ptr_array_index (self->object_managers, i);
-    wp_object_manager_rm_object (om, object);
-    wp_object_manager_maybe_objects_changed (om);
+  g_autoptr (GPtrArray) stores = g_ptr_array_copy (self->object_stores,
+      (GCopyFunc) wp_object_store_ref, NULL);
+
+  g_ptr_array_set_free_func (stores, (GDestroyNotify) wp_object_store_unref);
+
+  for (guint i = 0; i < stores->len; i++) {
+    WpObjectStore *store = g_ptr_array_index (stores, i);
+    wp_object_store_rm_object (store, object);
+    wp_object_store_maybe_objects_changed (store);
   }
 }
 
+/* called when the last view of a store is gone or moves to another store */
 static void
-object_manager_destroyed (gpointer data, GObject * om)
+wp_registry_remove_object_store (WpRegistry *self, WpObjectStore *store)
+{
+  if (store->key) {
+    g_hash_table_remove (self->object_stores_index, store->key);
+    g_clear_pointer (&store->key, g_free);
+  }
+  wp_registry_invalidate_dispatch_index (self);
+
+  /* this drops the registry's ref; do it last */
+  g_ptr_array_remove (self->object_stores, store);
+}
+
+static void
+object_manager_destroyed (gpointer data, GObject * object)
 {
   WpRegistry *self = data;
+  WpObjectManager *om = (WpObjectManager *) object;
+  WpObjectStore *store = om->store;
+
   g_ptr_array_remove_fast (self->object_managers, om);
+  g_ptr_array_remove (store->views, om);
+  if (store->views->len == 0)
+    wp_registry_remove_object_store (self, store);
 }
 
 /* find the subclass of WpPipewireGloabl that can handle
@@ -900,6 +2026,48 @@ find_proxy_instance_type (const char * type, guint32 version)
   return WP_TYPE_GLOBAL_PROXY;
 }
 
+/* returns the global with this id that is not exposed yet, if any */
+static inline WpGlobal *
+wp_registry_lookup_tmp_global (WpRegistry *self, guint32 id)
+{
+  WpGlobal *g = g_hash_table_lookup (self->tmp_globals_index,
+      GUINT_TO_POINTER (id));
+
+  /* a global that was removed while pending has its id invalidated, but it
+     stays in the index until a new global takes its id or it is exposed */
+  return (g && g->id == id) ? g : NULL;
+}
+
+static gint
+global_id_cmp (gconstpointer a, gconstpointer b)
+{
+  const WpGlobal *ga = *((const WpGlobal **) a);
+  const WpGlobal *gb = *((const WpGlobal **) b);
+  return (ga->id > gb->id) - (ga->id < gb->id);
+}
+
+/* returns a ref to each of the exposed globals, sorted by id;
+   if steal is TRUE, the globals are also removed from the registry */
+static GPtrArray *
+wp_registry_get_sorted_globals (WpRegistry *self, gboolean steal)
+{
+  GPtrArray *arr = g_ptr_array_new_full (g_hash_table_size (self->globals),
+      (GDestroyNotify) wp_global_unref);
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, self->globals);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    if (steal)
+      g_hash_table_iter_steal (&iter);
+    else
+      wp_global_ref (value);
+    g_ptr_array_add (arr, value);
+  }
+  g_ptr_array_sort (arr, global_id_cmp);
+  return arr;
+}
+
 /* called by the registry when a global appears */
 static void
 registry_global (void *data, uint32_t id, uint32_t permissions,
@@ -923,19 +2091,11 @@ registry_global_remove (void *data, uint32_t id)
   WpRegistry *self = data;
   WpGlobal *global = NULL;
 
-  if (id < self->globals->len)
-    global = g_ptr_array_index (self->globals, id);
+  global = g_hash_table_lookup (self->globals, GUINT_TO_POINTER (id));
 
   /* if not found, look in the tmp_globals, as it may still not be exposed */
-  if (!global) {
-    for (guint i = 0; i < self->tmp_globals->len; i++) {
-      WpGlobal *g = g_ptr_array_index (self->tmp_globals, i);
-      if (g->id == id) {
-        global = g;
-        break;
-      }
-    }
-  }
+  if (!global)
+    global = wp_registry_lookup_tmp_global (self, id);
 
   g_return_if_fail (global &&
       global->flags & WP_GLOBAL_FLAG_APPEARS_ON_REGISTRY);
@@ -952,23 +2112,241 @@ static const struct pw_registry_events registry_events = {
   .global_remove = registry_global_remove,
 };
 
+/* a set of globals that are being exposed to the object managers */
+struct expose_batch
+{
+  GPtrArray *globals; // element-type: WpGlobal*, in order of appearance
+  guint pos; // the next global to dispatch
+  GPtrArray *object_stores; // element-type: WpObjectStore*
+  GHashTable *notify_stores; // the object_stores, for quick lookups
+};
+
+static void
+expose_batch_free (struct expose_batch *b)
+{
+  g_clear_pointer (&b->globals, g_ptr_array_unref);
+  g_clear_pointer (&b->notify_stores, g_hash_table_unref);
+  g_clear_pointer (&b->object_stores, g_ptr_array_unref);
+  g_slice_free (struct expose_batch, b);
+}
+
+/* makes the rest of the batch that is in flight, if any, reach \a store
+   wherever it would reach \a followed */
+static void
+wp_registry_expose_batch_follow (WpRegistry *self, WpObjectStore *followed,
+    WpObjectStore *store)
+{
+  struct expose_batch *b = self->expose_batch;
+
+  if (!b || !g_hash_table_contains (b->notify_stores, followed))
+    return;
+
+  g_ptr_array_add (b->object_stores, wp_object_store_ref (store));
+  g_hash_table_add (b->notify_stores, store);
+}
+
+/* moves the tmp globals to the globals map and returns a batch
+   that dispatches them to the object stores that exist now */
+static struct expose_batch *
+wp_registry_start_expose_batch (WpRegistry *self)
+{
+  struct expose_batch *b = g_slice_new0 (struct expose_batch);
+
+  /* steal the tmp_globals list and replace it with an empty one */
+  b->globals = self->tmp_globals;
+  self->tmp_globals =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
+  g_hash_table_remove_all (self->tmp_globals_index);
+
+  wp_debug_object (wp_registry_get_core (self), "exposing %u new globals",
+      b->globals->len);
+
+  /* traverse in the order that the globals appeared on the registry */
+  for (guint i = 0; i < b->globals->len; i++) {
+    WpGlobal *g = g_ptr_array_index (b->globals, i);
+
+    /* if global was already removed, drop it */
+    if (g->flags == 0 || g->id == SPA_ID_INVALID)
+      continue;
+
+    /* if old global is owned by proxy, remove it */
+    WpGlobal *old_g = g_hash_table_lookup (self->globals,
+        GUINT_TO_POINTER (g->id));
+    if (old_g && (old_g->flags & WP_GLOBAL_FLAG_OWNED_BY_PROXY))
+      wp_global_rm_flag (old_g, WP_GLOBAL_FLAG_OWNED_BY_PROXY);
+
+    /* on failure, the rest of the globals are not stored and, since they
+       have no registry, they are not dispatched either */
+    g_return_val_if_fail (!g_hash_table_contains (self->globals,
+            GUINT_TO_POINTER (g->id)), b);
+
+    /* set the registry, so that wp_global_rm_flag() can work full-scale */
+    g->registry = self;
+
+    /* store it in the globals map */
+    g_hash_table_insert (self->globals, GUINT_TO_POINTER (g->id),
+        wp_global_ref (g));
+  }
+
+  b->object_stores = g_ptr_array_copy (self->object_stores,
+      (GCopyFunc) wp_object_store_ref, NULL);
+  g_ptr_array_set_free_func (b->object_stores,
+      (GDestroyNotify) wp_object_store_unref);
+
+  /* stores that get installed while the batch is being dispatched
+     (from within a signal handler or between iterations) already see
+     these globals in self->globals; managers that join one of the
+     stores of the batch get the rest of the globals from the store */
+  b->notify_stores = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (guint i = 0; i < b->object_stores->len; i++)
+    g_hash_table_add (b->notify_stores,
+        g_ptr_array_index (b->object_stores, i));
+
+  return b;
+}
+
+static void
+wp_registry_dispatch_global (WpRegistry *self, struct expose_batch *b,
+    WpGlobal *g)
+{
+  g_autoptr (GArray) candidates = NULL;
+  WpObjectStore *matched_store = NULL;
+
+  /* do not allow proxies that don't have a defined subclass;
+     bind will fail because proxy_class->pw_iface_type is NULL */
+  if (g->type == WP_TYPE_GLOBAL_PROXY || g->registry != self)
+    return;
+
+  candidates = wp_registry_find_dispatch_candidates (self, g->type,
+      g->properties);
+
+  for (guint j = 0; j < candidates->len; j++) {
+    struct dispatch_entry *e =
+        &g_array_index (candidates, struct dispatch_entry, j);
+    WpObjectFeatures features = 0;
+
+    /* if global was already removed, drop it */
+    if (g->flags == 0 || g->id == SPA_ID_INVALID)
+      break;
+
+    /* entries of the same store are consecutive; add only once */
+    if (e->store == matched_store ||
+        !g_hash_table_contains (b->notify_stores, e->store))
+      continue;
+
+    if (wp_object_store_interest_matches_global (e->store, e->interest, g,
+            &features)) {
+      matched_store = e->store;
+      wp_object_store_add_matched_global (e->store,
+          wp_registry_get_core (self), g, features);
+    }
+  }
+}
+
+static void
+wp_registry_record_expose_stall (WpRegistry *self, gint64 usec)
+{
+  static const gint64 bucket_limits[WP_REGISTRY_N_STALL_BUCKETS - 1] = {
+    250, 500, 1000, 2000, 4000, 8000, 16000
+  };
+  guint i = 0;
+
+  while (i < G_N_ELEMENTS (bucket_limits) && usec >= bucket_limits[i])
+    i++;
+
+  self->expose_stalls[i]++;
+  self->expose_stall_max = MAX (self->expose_stall_max, usec);
+  wp_registry_schedule_publish_stats (self);
+}
+
+/*
+ * Exposes the tmp globals to the object managers. Creating and activating
+ * the proxies of thousands of globals can take long, so this runs for up to
+ * EXPOSE_SLICE_USEC on every main loop iteration and continues on the next,
+ * letting other sources be dispatched in between. Object managers are
+ * notified in the order that the globals appeared and they do not emit
+ * 'installed' before all the globals have been dispatched.
+ */
+static gboolean
+expose_tmp_globals (WpCore *core)
+{
+  WpRegistry *self = wp_core_get_registry (core);
+  g_autoptr (GPtrArray) object_managers = NULL;
+  struct expose_batch *b = NULL;
+  gint64 start = g_get_monotonic_time ();
+
+  /* in case the registry was cleared in the meantime... */
+  if (G_UNLIKELY (!self->tmp_globals))
+    return G_SOURCE_REMOVE;
+
+  if (!self->expose_batch)
+    self->expose_batch = wp_registry_start_expose_batch (self);
+  b = self->expose_batch;
+
+  /* notify object managers, in the order that the globals appeared,
+     until the time of this iteration is up */
+  while (b->pos < b->globals->len) {
+    WpGlobal *g = g_ptr_array_index (b->globals, b->pos++);
+    wp_registry_dispatch_global (self, b, g);
+
+    if (g_get_monotonic_time () - start >= EXPOSE_SLICE_USEC)
+      break;
+  }
+
+  /* the batch must be gone before the managers check if they are installed */
+  if (b->pos == b->globals->len)
+    g_clear_pointer (&self->expose_batch, expose_batch_free);
+
+  /* managers that got installed meanwhile also wait for the batch */
+  object_managers = g_ptr_array_copy (self->object_managers,
+      (GCopyFunc) g_object_ref, NULL);
+  g_ptr_array_set_free_func (object_managers, g_object_unref);
+
+  for (guint i = 0; i < object_managers->len; i++) {
+    WpObjectManager *om = g_ptr_array_index (object_managers, i);
+    wp_object_manager_maybe_objects_changed (om);
+  }
+
+  /* in case the registry was cleared by a signal handler... */
+  if (G_UNLIKELY (!self->tmp_globals))
+    return G_SOURCE_REMOVE;
+
+  wp_registry_record_expose_stall (self, g_get_monotonic_time () - start);
+
+  /* continue on the next iteration, if there is more to do */
+  if (wp_registry_has_pending_globals (self))
+    return G_SOURCE_CONTINUE;
+
+  g_clear_pointer (&self->expose_source, g_source_unref);
+  return G_SOURCE_REMOVE;
+}
+
 void
 wp_registry_init (WpRegistry *self)
 {
-  self->globals =
-      g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
+  self->globals = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) wp_global_unref);
   self->tmp_globals =
       g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
+  self->tmp_globals_index = g_hash_table_new (g_direct_hash, g_direct_equal);
   self->objects = g_ptr_array_new_with_free_func (g_object_unref);
   self->object_managers = g_ptr_array_new ();
+  self->object_stores = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) wp_object_store_unref);
+  self->object_stores_index = g_hash_table_new (g_str_hash, g_str_equal);
+  self->dispatch_index = NULL;
+  self->interest_checks = 0;
+  self->interest_skips = 0;
+  self->expose_batch = NULL;
 }
 
 void
 wp_registry_clear (WpRegistry *self)
 {
   wp_registry_detach (self);
-  g_clear_pointer (&self->globals, g_ptr_array_unref);
+  g_clear_pointer (&self->globals, g_hash_table_unref);
   g_clear_pointer (&self->tmp_globals, g_ptr_array_unref);
+  g_clear_pointer (&self->tmp_globals_index, g_hash_table_unref);
 
   /* remove all the registered objects
      this will normally also destroy the object managers, eventually, since
@@ -996,6 +2374,29 @@ wp_registry_clear (WpRegistry *self)
       g_object_weak_unref (om, object_manager_destroyed, self);
     }
   }
+
+  /* ... and their stores, which cannot be shared anymore */
+  if (self->object_stores) {
+    for (guint i = 0; i < self->object_stores->len; i++) {
+      WpObjectStore *store = g_ptr_array_index (self->object_stores, i);
+      g_clear_pointer (&store->key, g_free);
+    }
+  }
+  g_clear_pointer (&self->object_stores_index, g_hash_table_unref);
+  g_clear_pointer (&self->object_stores, g_ptr_array_unref);
+
+  wp_registry_invalidate_dispatch_index (self);
+
+  if (self->stats_source) {
+    g_source_destroy (self->stats_source);
+    g_clear_pointer (&self->stats_source, g_source_unref);
+  }
+
+  if (self->expose_source) {
+    g_source_destroy (self->expose_source);
+    g_clear_pointer (&self->expose_source, g_source_unref);
+  }
+  g_clear_pointer (&self->expose_batch, expose_batch_free);
 }
 
 void
@@ -1016,15 +2417,13 @@ wp_registry_detach (WpRegistry *self)
     self->pw_registry = NULL;
   }
 
-  /* remove pipewire globals */
-  GPtrArray *objlist = self->globals;
+  /* remove pipewire globals, in the reverse order of their ids */
+  g_autoptr (GPtrArray) objlist =
+      self->globals ? wp_registry_get_sorted_globals (self, TRUE) : NULL;
   while (objlist && objlist->len > 0) {
     g_autoptr (WpGlobal) global = g_ptr_array_steal_index_fast (objlist,
         objlist->len - 1);
 
-    if (!global)
-      continue;
-
     if (global->proxy)
       wp_registry_notify_rm_object (self, global->proxy);
 
@@ -1039,82 +2438,15 @@ wp_registry_detach (WpRegistry *self)
   }
 
   /* drop tmp globals as well */
-  objlist = self->tmp_globals;
-  while (objlist && objlist->len > 0) {
-    g_autoptr (WpGlobal) global = g_ptr_array_steal_index_fast (objlist,
-        objlist->len - 1);
+  if (self->tmp_globals_index)
+    g_hash_table_remove_all (self->tmp_globals_index);
+  while (self->tmp_globals && self->tmp_globals->len > 0) {
+    g_autoptr (WpGlobal) global = g_ptr_array_steal_index_fast (
+        self->tmp_globals, self->tmp_globals->len - 1);
     wp_global_rm_flag (global, WP_GLOBAL_FLAG_APPEARS_ON_REGISTRY);
   }
 }
 
-static gboolean
-expose_tmp_globals (WpCore *core)
-{
-  WpRegistry *self = wp_core_get_registry (core);
-  g_autoptr (GPtrArray) tmp_globals = NULL;
-  g_autoptr (GPtrArray) object_managers = NULL;
-
-  /* in case the registry was cleared in the meantime... */
-  if (G_UNLIKELY (!self->tmp_globals))
-    return G_SOURCE_REMOVE;
-
-  /* steal the tmp_globals list and replace it with an empty one */
-  tmp_globals = self->tmp_globals;
-  self->tmp_globals =
-      g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
-
-  wp_debug_object (core, "exposing %u new globals", tmp_globals->len);
-
-  /* traverse in the order that the globals appeared on the registry */
-  for (guint i = 0; i < tmp_globals->len; i++) {
-    WpGlobal *g = g_ptr_array_index (tmp_globals, i);
-
-    /* if global was already removed, drop it */
-    if (g->flags == 0 || g->id == SPA_ID_INVALID)
-      continue;
-
-    /* if old global is owned by proxy, remove it */
-    if (self->globals->len > g->id) {
-      WpGlobal *old_g = g_ptr_array_index (self->globals, g->id);
-      if (old_g && (old_g->flags & WP_GLOBAL_FLAG_OWNED_BY_PROXY))
-        wp_global_rm_flag (old_g, WP_GLOBAL_FLAG_OWNED_BY_PROXY);
-    }
-
-    g_return_val_if_fail (self->globals->len <= g->id ||
-        g_ptr_array_index (self->globals, g->id) == NULL, G_SOURCE_REMOVE);
-
-    /* set the registry, so that wp_global_rm_flag() can work full-scale */
-    g->registry = self;
-
-    /* store it in the globals list */
-    if (self->globals->len <= g->id)
-      g_ptr_array_set_size (self->globals, g->id + 1);
-    g_ptr_array_index (self->globals, g->id) = wp_global_ref (g);
-  }
-
-  object_managers = g_ptr_array_copy (self->object_managers,
-      (GCopyFunc) g_object_ref, NULL);
-  g_ptr_array_set_free_func (object_managers, g_object_unref);
-
-  /* notify object managers */
-  for (guint i = 0; i < object_managers->len; i++) {
-    WpObjectManager *om = g_ptr_array_index (object_managers, i);
-
-    for (guint i = 0; i < tmp_globals->len; i++) {
-      WpGlobal *g = g_ptr_array_index (tmp_globals, i);
-
-      /* if global was already removed, drop it */
-      if (g->flags == 0 || g->id == SPA_ID_INVALID)
-        continue;
-
-      wp_object_manager_add_global (om, g);
-    }
-    wp_object_manager_maybe_objects_changed (om);
-  }
-
-  return G_SOURCE_REMOVE;
-}
-
 /*
  * \param new_global (out) (transfer full) (optional): the new global
  *
@@ -1135,13 +2467,9 @@ wp_registry_prepare_new_global (WpRegistry * self, guint32 id,
 
   g_return_if_fail (flag != 0);
 
-  for (guint i = 0; i < self->tmp_globals->len; i++) {
-    WpGlobal *g = g_ptr_array_index (self->tmp_globals, i);
-    if (g->id == id) {
-      global = wp_global_ref (g);
-      break;
-    }
-  }
+  global = wp_registry_lookup_tmp_global (self, id);
+  if (global)
+    wp_global_ref (global);
 
   wp_debug_object (core, "%s WpGlobal:%u type:%s proxy:%p",
       global ? "reuse" : "new", id, g_type_name (type),
@@ -1157,13 +2485,15 @@ wp_registry_prepare_new_global (WpRegistry * self, guint32 id,
         wp_properties_new_copy_dict (props) : wp_properties_new_empty ();
     global->proxy = proxy;
     g_ptr_array_add (self->tmp_globals, wp_global_ref (global));
+    g_hash_table_replace (self->tmp_globals_index, GUINT_TO_POINTER (id),
+        global);
 
     /* ensure we have 'object.id' so that we can filter by id on object managers */
     wp_properties_setf (global->properties, PW_KEY_OBJECT_ID, "%u", global->id);
 
-    /* schedule exposing when adding the first global */
-    if (self->tmp_globals->len == 1) {
-      wp_core_idle_add_closure (core, NULL,
+    /* schedule exposing, unless it is scheduled already */
+    if (!self->expose_source) {
+      wp_core_idle_add_closure (core, &self->expose_source,
           g_cclosure_new_object (G_CALLBACK (expose_tmp_globals), G_OBJECT (core)));
     }
   } else {
@@ -1270,6 +2600,94 @@ wp_registry_remove_object (WpRegistry *reg, gpointer obj)
   g_ptr_array_remove_fast (reg->objects, obj);
 }
 
+/* makes the object manager, which is being installed, a view of \a store */
+static void
+wp_object_manager_join_store (WpObjectManager * self, WpObjectStore * store)
+{
+  g_autoptr (WpObjectStore) own = g_steal_pointer (&self->store);
+  g_autoptr (GPtrArray) objects = NULL;
+
+  wp_debug_object (self, "sharing store:%p with %u other managers", store,
+      store->views->len);
+
+  /* keep the indexes that were added before installing */
+  for (guint i = 0; i < own->prop_indexes->len; i++) {
+    struct prop_index *idx = g_ptr_array_index (own->prop_indexes, i);
+    wp_object_store_add_index (store, idx->type, idx->subject);
+  }
+
+  self->store = wp_object_store_ref (store);
+  g_ptr_array_add (store->views, self);
+
+  /* announce the objects of the store, like for a new store; objects that
+     are still being prepared are announced later to all the views */
+  objects = g_ptr_array_copy (store->objects, NULL, NULL);
+  for (guint i = 0; i < objects->len; i++) {
+    gpointer object = g_ptr_array_index (objects, i);
+
+    /* unless a signal handler has removed it meanwhile */
+    if (g_hash_table_contains (store->object_positions, object))
+      wp_object_manager_notify_added (self, object);
+  }
+}
+
+/*
+ * Moves an installed object manager to a store of its own, with the same
+ * objects, before its interests or requested features change, so that the
+ * other views of the shared store are not affected. Objects that are still
+ * being prepared for the shared store and the globals of an expose batch
+ * that has not reached it yet are carried over to the new store as well.
+ */
+static void
+wp_object_manager_detach_store (WpObjectManager * self)
+{
+  g_autoptr (WpCore) core = NULL;
+  g_autoptr (WpObjectStore) shared = NULL;
+  WpObjectStore *store;
+  WpRegistry *reg;
+
+  /* a store of its own follows the changes of the interests already */
+  if (!self->store->key)
+    return;
+
+  core = g_weak_ref_get (&self->core);
+  g_return_if_fail (core != NULL);
+  reg = wp_core_get_registry (core);
+
+  wp_debug_object (self, "leaving shared store:%p", self->store);
+
+  shared = g_steal_pointer (&self->store);
+  store = wp_object_store_new (self->interests, self->features);
+  for (guint i = 0; i < shared->objects->len; i++) {
+    gpointer object = g_ptr_array_index (shared->objects, i);
+    g_hash_table_insert (store->object_positions, object,
+        GUINT_TO_POINTER (store->objects->len));
+    g_ptr_array_add (store->objects, object);
+  }
+  for (guint i = 0; i < shared->prop_indexes->len; i++) {
+    struct prop_index *idx = g_ptr_array_index (shared->prop_indexes, i);
+    wp_object_store_add_index (store, idx->type, idx->subject);
+  }
+  {
+    GHashTableIter iter;
+    gpointer proxy, features;
+
+    g_hash_table_iter_init (&iter, shared->activating);
+    while (g_hash_table_iter_next (&iter, &proxy, &features))
+      wp_object_store_activate (store, proxy, GPOINTER_TO_UINT (features));
+  }
+  wp_registry_expose_batch_follow (reg, shared, store);
+
+  self->store = store;
+  g_ptr_array_add (store->views, self);
+  g_ptr_array_add (reg->object_stores, wp_object_store_ref (store));
+  wp_registry_invalidate_dispatch_index (reg);
+
+  g_ptr_array_remove (shared->views, self);
+  if (shared->views->len == 0)
+    wp_registry_remove_object_store (reg, shared);
+}
+
 /*!
  * \brief Installs the object manager on this core, activating its internal
  * management engine.
@@ -1285,6 +2703,9 @@ void
 wp_core_install_object_manager (WpCore * self, WpObjectManager * om)
 {
   WpRegistry *reg;
+  WpObjectStore *store;
+  g_autofree gchar *key = NULL;
+  g_autoptr (GPtrArray) globals = NULL;
   guint i;
 
   g_return_if_fail (WP_IS_CORE (self));
@@ -1296,17 +2717,50 @@ wp_core_install_object_manager (WpCore * self, WpObjectManager * om)
   g_ptr_array_add (reg->object_managers, om);
   g_weak_ref_set (&om->core, self);
 
+  /* share the store of an identical object manager, if there is one */
+  key = wp_object_store_make_key (om->interests, om->features);
+  store = g_hash_table_lookup (reg->object_stores_index, key);
+  wp_registry_schedule_publish_stats (reg);
+  if (store) {
+    wp_object_manager_join_store (om, store);
+    wp_object_manager_maybe_objects_changed (om);
+    return;
+  }
+
+  /* otherwise, the store of the object manager becomes shareable; it needs
+     its own copy of the interests, since the manager may change them */
+  store = om->store;
+  g_clear_pointer (&store->interests, g_ptr_array_unref);
+  store->interests = g_ptr_array_copy (om->interests,
+      (GCopyFunc) wp_object_interest_ref, NULL);
+  g_ptr_array_set_free_func (store->interests,
+      (GDestroyNotify) wp_object_interest_unref);
+  g_clear_pointer (&store->features, g_hash_table_unref);
+  store->features = g_hash_table_new (g_direct_hash, g_direct_equal);
+  {
+    GHashTableIter iter;
+    gpointer type, features;
+
+    g_hash_table_iter_init (&iter, om->features);
+    while (g_hash_table_iter_next (&iter, &type, &features))
+      g_hash_table_insert (store->features, type, features);
+  }
+  store->key = g_steal_pointer (&key);
+  g_hash_table_insert (reg->object_stores_index, store->key, store);
+  g_ptr_array_add (reg->object_stores, wp_object_store_ref (store));
+  g_ptr_array_add (store->views, om);
+  wp_registry_invalidate_dispatch_index (reg);
+
   /* add pre-existing objects to the object manager,
-     in case it's interested in them */
-  for (i = 0; i < reg->globals->len; i++) {
-    WpGlobal *g = g_ptr_array_index (reg->globals, i);
-    /* check if null because the globals array can have gaps */
-    if (g)
-      wp_object_manager_add_global (om, g);
+     in case it's interested in them, in the order of their ids */
+  globals = wp_registry_get_sorted_globals (reg, FALSE);
+  for (i = 0; i < globals->len; i++) {
+    WpGlobal *g = g_ptr_array_index (globals, i);
+    wp_object_store_add_global (store, self, g);
   }
   for (i = 0; i < reg->objects->len; i++) {
     GObject *o = g_ptr_array_index (reg->objects, i);
-    wp_object_manager_add_object (om, o);
+    wp_object_store_add_object (store, o);
   }
 
   wp_object_manager_maybe_objects_changed (om);
@@ -1378,8 +2832,10 @@ wp_global_rm_flag (WpGlobal *global, guint rm_flag)
   }
 
   /* drop the registry's ref on global when it does not appear on the registry anymore */
-  if (!(global->flags & WP_GLOBAL_FLAG_APPEARS_ON_REGISTRY) && reg) {
-    g_clear_pointer (&g_ptr_array_index (reg->globals, id), wp_global_unref);
+  if (!(global->flags & WP_GLOBAL_FLAG_APPEARS_ON_REGISTRY) && reg &&
+      reg->globals &&
+      g_hash_table_lookup (reg->globals, GUINT_TO_POINTER (id)) == global) {
+    g_hash_table_remove (reg->globals, GUINT_TO_POINTER (id));
   }
 }
 
@@ -24,6 +24,16 @@ G_BEGIN_DECLS
 WP_API
 G_DECLARE_FINAL_TYPE (WpObjectManager, wp_object_manager, WP, OBJECT_MANAGER, GObject)
 
+/*!
+ * \brief The GType of the GPtrArray of GObjects that is passed to the
+ * \c objects-added and \c objects-removed signals
+ * \ingroup wpobjectmanager
+ * \since 0.4.18
+ */
+#define WP_TYPE_OBJECT_ARRAY (wp_object_array_get_type ())
+WP_API
+GType wp_object_array_get_type (void);
+
 WP_API
 WpObjectManager * wp_object_manager_new (void);
 
@@ -42,6 +52,10 @@ WP_API
 void wp_object_manager_add_interest_full (WpObjectManager * self,
     WpObjectInterest * interest);
 
+WP_API
+void wp_object_manager_add_index (WpObjectManager * self,
+    WpConstraintType type, const gchar * subject);
+
 /* object features */
 
 WP_API
@@ -9,6 +9,7 @@
 #define G_LOG_DOMAIN "wp-pw-obj-mixin"
 
 #include "private/pipewire-object-mixin.h"
+#include "private/spa-pod-arena.h"
 #include "core.h"
 #include "spa-type.h"
 #include "spa-pod.h"
@@ -108,30 +109,32 @@ static void
 enum_params_done (WpCore * core, GAsyncResult * res, gpointer data)
 {
   g_autoptr (GTask) task = G_TASK (data);
-  GList *taskl = NULL;
+  gpointer seq = g_task_get_source_tag (task);
   g_autoptr (GError) error = NULL;
   gpointer instance = g_task_get_source_object (G_TASK (data));
-  GPtrArray *params = g_task_get_task_data (task);
+  WpSpaPodArena *arena = g_task_get_task_data (task);
   WpPwObjectMixinData *d = wp_pw_object_mixin_get_data (instance);
 
   /* finish the sync task */
   wp_core_sync_finish (core, res, &error);
 
-  /* return if task was previously removed from the list */
-  taskl = g_list_find (d->enum_params_tasks, task);
-  if (!taskl)
+  /* return if task was previously removed from the table */
+  if (g_hash_table_lookup (d->enum_params_tasks, seq) != task)
     return;
 
-  /* remove the task from the stored list; ref is held by the g_autoptr */
-  d->enum_params_tasks = g_list_delete_link (d->enum_params_tasks, taskl);
+  /* remove the task from the table; ref is held by the g_autoptr */
+  g_hash_table_remove (d->enum_params_tasks, seq);
 
   wp_debug_object (instance, "got %u params, %s, task " WP_OBJECT_FORMAT,
-      params->len, error ? "with error" : "ok", WP_OBJECT_ARGS (task));
+      wp_spa_pod_arena_get_n_pods (arena), error ? "with error" : "ok",
+      WP_OBJECT_ARGS (task));
 
   if (error)
     g_task_return_error (task, g_steal_pointer (&error));
   else {
-    g_task_return_pointer (task, g_ptr_array_ref (params),
+    /* the params are returned as views into the arena, which is then
+       freed at once, together with the last of them */
+    g_task_return_pointer (task, wp_spa_pod_arena_steal_pods (arena),
         (GDestroyNotify) g_ptr_array_unref);
   }
 }
@@ -145,11 +148,10 @@ enum_params_error (WpProxy * proxy, int seq, int res, const gchar *msg,
   if (SPA_RESULT_ASYNC_SEQ (t_seq) == SPA_RESULT_ASYNC_SEQ (seq)) {
     gpointer instance = g_task_get_source_object (task);
     WpPwObjectMixinData *d = wp_pw_object_mixin_get_data (instance);
-    GList *taskl = NULL;
 
-    taskl = g_list_find (d->enum_params_tasks, task);
-    if (taskl) {
-      d->enum_params_tasks = g_list_delete_link (d->enum_params_tasks, taskl);
+    if (g_hash_table_lookup (d->enum_params_tasks, GINT_TO_POINTER (t_seq))
+            == task) {
+      g_hash_table_remove (d->enum_params_tasks, GINT_TO_POINTER (t_seq));
       g_task_return_new_error (task, WP_DOMAIN_LIBRARY,
           WP_LIBRARY_ERROR_OPERATION_FAILED, "%s", msg);
     }
@@ -184,9 +186,6 @@ wp_pw_object_mixin_enum_params_unchecked (gpointer obj,
     }
   }
 
-  if (!params)
-    params = g_ptr_array_new_with_free_func ((GDestroyNotify) wp_spa_pod_unref);
-
   /* create task */
   task = g_task_new (obj, cancellable, callback, user_data);
 
@@ -201,6 +200,9 @@ wp_pw_object_mixin_enum_params_unchecked (gpointer obj,
   }
 
   if (iface->enum_params_sync) {
+    if (!params)
+      params = g_ptr_array_new_with_free_func (
+          (GDestroyNotify) wp_spa_pod_unref);
     g_task_return_pointer (task, params, (GDestroyNotify) g_ptr_array_unref);
   } else {
     g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (obj));
@@ -210,9 +212,10 @@ wp_pw_object_mixin_enum_params_unchecked (gpointer obj,
         task, 0);
 
     /* store */
-    g_task_set_task_data (task, params, (GDestroyNotify) g_ptr_array_unref);
+    g_task_set_task_data (task, wp_spa_pod_arena_new (),
+        (GDestroyNotify) wp_spa_pod_arena_free);
     g_task_set_source_tag (task, GINT_TO_POINTER (seq));
-    d->enum_params_tasks = g_list_append (d->enum_params_tasks, task);
+    g_hash_table_insert (d->enum_params_tasks, GINT_TO_POINTER (seq), task);
 
     /* call sync */
     wp_core_sync (core, cancellable, (GAsyncReadyCallback) enum_params_done,
@@ -335,6 +338,7 @@ wp_pw_object_mixin_object_interface_init (WpPipewireObjectInterface * iface)
   iface->enum_params_finish = wp_pw_object_mixin_enum_params_finish;
   iface->enum_params_sync = wp_pw_object_mixin_enum_params_sync;
   iface->set_param = wp_pw_object_mixin_set_param;
+  iface->get_params_stats = wp_pw_object_mixin_get_params_stats;
 }
 
 /********/
@@ -349,6 +353,7 @@ wp_pw_object_mixin_data_new (void)
 {
   WpPwObjectMixinData *d = g_slice_new0 (WpPwObjectMixinData);
   spa_hook_list_init (&d->hooks);
+  d->enum_params_tasks = g_hash_table_new (g_direct_hash, g_direct_equal);
   return d;
 }
 
@@ -358,9 +363,12 @@ wp_pw_object_mixin_data_free (gpointer data)
   WpPwObjectMixinData *d = data;
   spa_hook_list_clean (&d->hooks);
   g_clear_pointer (&d->properties, wp_properties_unref);
-  g_list_free_full (d->params, wp_pw_object_mixin_param_store_free);
+  for (guint i = 0; i < WP_PW_OBJECT_MIXIN_N_PARAM_IDS; i++)
+    g_clear_pointer (&d->params[i], g_ptr_array_unref);
+  g_clear_pointer (&d->extra_params, g_hash_table_unref);
   g_clear_pointer (&d->subscribed_ids, g_array_unref);
-  g_warn_if_fail (d->enum_params_tasks == NULL);
+  g_warn_if_fail (g_hash_table_size (d->enum_params_tasks) == 0);
+  g_clear_pointer (&d->enum_params_tasks, g_hash_table_unref);
   g_slice_free (WpPwObjectMixinData, d);
 }
 
@@ -402,70 +410,113 @@ wp_pw_object_mixin_param_store_free (gpointer data)
   g_slice_free (WpPwObjectMixinParamStore, p);
 }
 
-static gint
-param_store_has_id (gconstpointer param, gconstpointer id)
+/* returns the location where the params of @em id are stored,
+   or NULL if there is none and @em create is FALSE */
+static GPtrArray **
+wp_pw_object_mixin_param_store_lookup (WpPwObjectMixinData * data,
+    guint32 id, gboolean create)
 {
-  guint32 param_id = ((const WpPwObjectMixinParamStore *) param)->param_id;
-  return (param_id == GPOINTER_TO_UINT (id)) ? 0 : 1;
+  WpPwObjectMixinParamStore *s = NULL;
+
+  if (G_LIKELY (id < WP_PW_OBJECT_MIXIN_N_PARAM_IDS))
+    return &data->params[id];
+
+  if (data->extra_params)
+    s = g_hash_table_lookup (data->extra_params, GUINT_TO_POINTER (id));
+
+  if (!s && create) {
+    if (!data->extra_params)
+      data->extra_params = g_hash_table_new_full (g_direct_hash,
+          g_direct_equal, NULL, wp_pw_object_mixin_param_store_free);
+    s = wp_pw_object_mixin_param_store_new ();
+    s->param_id = id;
+    g_hash_table_insert (data->extra_params, GUINT_TO_POINTER (id), s);
+  }
+  return s ? &s->params : NULL;
 }
 
 GPtrArray *
 wp_pw_object_mixin_get_stored_params (WpPwObjectMixinData * data, guint32 id)
 {
-  GList *link = g_list_find_custom (data->params, GUINT_TO_POINTER (id),
-      param_store_has_id);
-  WpPwObjectMixinParamStore *s = link ? link->data : NULL;
-  return (s && s->params) ? g_ptr_array_ref (s->params) : NULL;
+  GPtrArray **params = wp_pw_object_mixin_param_store_lookup (data, id, FALSE);
+  return (params && *params) ? g_ptr_array_ref (*params) : NULL;
 }
 
 void
 wp_pw_object_mixin_store_param (WpPwObjectMixinData * data, guint32 id,
     guint32 flags, gpointer param)
 {
-  GList *link = g_list_find_custom (data->params, GUINT_TO_POINTER (id),
-      param_store_has_id);
-  WpPwObjectMixinParamStore *s = link ? link->data : NULL;
+  GPtrArray **params;
   gint16 index = (gint16) (flags & 0xffff);
 
-  /* if the link exists, data must also exist */
-  g_warn_if_fail (!link || link->data);
-
-  if (!s) {
-    if (flags & WP_PW_OBJECT_MIXIN_STORE_PARAM_REMOVE)
-      return;
-    s = wp_pw_object_mixin_param_store_new ();
-    s->param_id = id;
-    data->params = g_list_append (data->params, s);
-  }
-  else if (s && (flags & WP_PW_OBJECT_MIXIN_STORE_PARAM_REMOVE)) {
-    wp_pw_object_mixin_param_store_free (s);
-    data->params = g_list_delete_link (data->params, link);
+  if (flags & WP_PW_OBJECT_MIXIN_STORE_PARAM_REMOVE) {
+    if (id < WP_PW_OBJECT_MIXIN_N_PARAM_IDS)
+      g_clear_pointer (&data->params[id], g_ptr_array_unref);
+    else if (data->extra_params)
+      g_hash_table_remove (data->extra_params, GUINT_TO_POINTER (id));
     return;
   }
 
+  params = wp_pw_object_mixin_param_store_lookup (data, id, TRUE);
+
   if (flags & WP_PW_OBJECT_MIXIN_STORE_PARAM_CLEAR)
-    g_clear_pointer (&s->params, g_ptr_array_unref);
+    g_clear_pointer (params, g_ptr_array_unref);
 
   if (!param)
     return;
 
   if (flags & WP_PW_OBJECT_MIXIN_STORE_PARAM_ARRAY) {
-    if (!s->params)
-      s->params = (GPtrArray *) param;
+    if (!*params)
+      *params = (GPtrArray *) param;
     else
-      g_ptr_array_extend_and_steal (s->params, (GPtrArray *) param);
+      g_ptr_array_extend_and_steal (*params, (GPtrArray *) param);
   }
   else {
     WpSpaPod *param_pod = param;
 
-    if (!s->params)
-      s->params =
+    if (!*params)
+      *params =
           g_ptr_array_new_with_free_func ((GDestroyNotify) wp_spa_pod_unref);
 
     /* copy if necessary to make sure we don't reference
        `const struct spa_pod *` data allocated on the stack */
     param_pod = wp_spa_pod_ensure_unique_owner (param_pod);
-    g_ptr_array_insert (s->params, index, param_pod);
+    g_ptr_array_insert (*params, index, param_pod);
+  }
+}
+
+static void
+add_params_stats (GPtrArray * params, WpPipewireObjectParamsStats * stats)
+{
+  if (!params || params->len == 0)
+    return;
+
+  stats->n_ids++;
+  stats->n_params += params->len;
+  stats->size += params->len * sizeof (gpointer);
+  for (guint i = 0; i < params->len; i++) {
+    const struct spa_pod *pod =
+        wp_spa_pod_get_spa_pod (g_ptr_array_index (params, i));
+    stats->size += SPA_POD_SIZE (pod);
+  }
+}
+
+void
+wp_pw_object_mixin_get_params_stats (WpPipewireObject * obj,
+    WpPipewireObjectParamsStats * stats)
+{
+  WpPwObjectMixinData *d = wp_pw_object_mixin_get_data (obj);
+
+  for (guint i = 0; i < WP_PW_OBJECT_MIXIN_N_PARAM_IDS; i++)
+    add_params_stats (d->params[i], stats);
+
+  if (d->extra_params) {
+    GHashTableIter it;
+    WpPwObjectMixinParamStore *s;
+
+    g_hash_table_iter_init (&it, d->extra_params);
+    while (g_hash_table_iter_next (&it, NULL, (gpointer *) &s))
+      add_params_stats (s->params, stats);
   }
 }
 
@@ -601,6 +652,13 @@ enum_params_for_cache_done (GObject * object, GAsyncResult * res, gpointer data)
       WP_PW_OBJECT_MIXIN_STORE_PARAM_APPEND,
       g_steal_pointer (&params));
 
+  if (wp_log_level_is_enabled (G_LOG_LEVEL_DEBUG)) {
+    WpPipewireObjectParamsStats stats = { 0, };
+    wp_pw_object_mixin_get_params_stats (WP_PIPEWIRE_OBJECT (object), &stats);
+    wp_debug_object (object, "params cache: %u ids, %u params, %"
+        G_GSIZE_FORMAT " bytes", stats.n_ids, stats.n_params, stats.size);
+  }
+
   g_signal_emit_by_name (object, "params-changed", name);
 }
 
@@ -699,17 +757,17 @@ wp_pw_object_mixin_handle_pw_proxy_destroyed (WpProxy * proxy)
     }
   }
 
-  /* cancel enum_params tasks */
+  /* cancel enum_params tasks; they are removed from the table first,
+     as returning may start new tasks */
   {
-    GList *link;
-    for (link = g_list_first (d->enum_params_tasks);
-         link; link = g_list_first (d->enum_params_tasks)) {
-      GTask *task = G_TASK (link->data);
-      d->enum_params_tasks = g_list_delete_link (d->enum_params_tasks, link);
-      g_task_return_new_error (task,
+    GList *tasks = g_hash_table_get_values (d->enum_params_tasks);
+    g_hash_table_remove_all (d->enum_params_tasks);
+    for (GList *link = tasks; link; link = g_list_next (link)) {
+      g_task_return_new_error (G_TASK (link->data),
           WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
           "pipewire proxy destroyed before finishing");
     }
+    g_list_free (tasks);
   }
 
   wp_object_update_features (WP_OBJECT (proxy), 0,
@@ -801,33 +859,22 @@ wp_pw_object_mixin_handle_event_info (gpointer instance, gconstpointer update)
       WP_PIPEWIRE_OBJECT_FEATURE_INFO, 0);
 }
 
-static gint
-task_has_seq (gconstpointer task, gconstpointer seq)
-{
-  gpointer t_seq = g_task_get_source_tag (G_TASK (task));
-  return (GPOINTER_TO_INT (t_seq) == GPOINTER_TO_INT (seq)) ? 0 : 1;
-}
-
 void
 wp_pw_object_mixin_handle_event_param (gpointer instance, int seq,
     uint32_t id, uint32_t index, uint32_t next, const struct spa_pod *param)
 {
   WpPwObjectMixinData *d = wp_pw_object_mixin_get_data (instance);
   g_autoptr (WpSpaPod) w_param = wp_spa_pod_new_wrap_const (param);
-  GList *list;
-  GTask *task;
-
-  list = g_list_find_custom (d->enum_params_tasks, GINT_TO_POINTER (seq),
-      task_has_seq);
-  task = list ? G_TASK (list->data) : NULL;
+  GTask *task = g_hash_table_lookup (d->enum_params_tasks,
+      GINT_TO_POINTER (seq));
 
   wp_trace_boxed (WP_TYPE_SPA_POD, w_param,
       WP_OBJECT_FORMAT " param id:%u, index:%u",
       WP_OBJECT_ARGS (instance), id, index);
 
   if (task) {
-    GPtrArray *array = g_task_get_task_data (task);
-    g_ptr_array_add (array, wp_spa_pod_copy (w_param));
+    WpSpaPodArena *arena = g_task_get_task_data (task);
+    wp_spa_pod_arena_add (arena, param);
   } else {
     /* this should never happen */
     wp_warning_object (instance,
@@ -118,6 +118,10 @@ void wp_pw_object_mixin_object_interface_init (WpPipewireObjectInterface * iface
 /********/
 /* DATA */
 
+/* params with ids below this are stored in a table indexed by id;
+   this covers all the SPA_PARAM_* ids */
+#define WP_PW_OBJECT_MIXIN_N_PARAM_IDS 32
+
 typedef struct _WpPwObjectMixinData WpPwObjectMixinData;
 struct _WpPwObjectMixinData
 {
@@ -126,8 +130,9 @@ struct _WpPwObjectMixinData
   struct spa_hook listener;
   struct spa_hook_list hooks;
   WpProperties *properties;
-  GList *enum_params_tasks;  /* element-type: GTask* */
-  GList *params;             /* element-type: WpPwObjectMixinParamStore* */
+  GHashTable *enum_params_tasks;  /* seq -> GTask* */
+  GPtrArray *params[WP_PW_OBJECT_MIXIN_N_PARAM_IDS];  /* id -> WpSpaPod* */
+  GHashTable *extra_params;  /* id -> WpPwObjectMixinParamStore* */
   GArray *subscribed_ids;    /* element-type: guint32 */
 };
 
@@ -147,6 +152,10 @@ GPtrArray * wp_pw_object_mixin_get_stored_params (WpPwObjectMixinData * data,
 void wp_pw_object_mixin_store_param (WpPwObjectMixinData * data, guint32 id,
     guint32 flags, gpointer param);
 
+/* statistics about the memory held by the param store */
+void wp_pw_object_mixin_get_params_stats (WpPipewireObject * obj,
+    WpPipewireObjectParamsStats * stats);
+
 /* set the index at which to store the new param */
 #define WP_PW_OBJECT_MIXIN_STORE_PARAM_SET(x)  ((x) & 0x7fff)
 #define WP_PW_OBJECT_MIXIN_STORE_PARAM_APPEND  (0xffff)
@@ -11,6 +11,7 @@
 
 #include "core.h"
 #include "global-proxy.h"
+#include "object-interest.h"
 
 #include <pipewire/pipewire.h>
 
@@ -18,6 +19,11 @@ G_BEGIN_DECLS
 
 typedef struct _WpRegistry WpRegistry;
 typedef struct _WpGlobal WpGlobal;
+typedef struct _WpObjectStore WpObjectStore;
+
+/* the number of buckets of the histogram of the time spent in each
+   iteration of exposing new globals to the object managers */
+#define WP_REGISTRY_N_STALL_BUCKETS 8
 
 /* registry */
 
@@ -26,12 +32,41 @@ struct _WpRegistry
   struct pw_registry *pw_registry;
   struct spa_hook listener;
 
-  GPtrArray *globals; // elementy-type: WpGlobal*
+  /* id -> WpGlobal*; a hash table, so that its size does not depend
+     on the highest id that the server has handed out */
+  GHashTable *globals;
+  /* globals that are not exposed yet, in the order they appeared,
+     and the same globals indexed by id */
   GPtrArray *tmp_globals; // elementy-type: WpGlobal*
+  GHashTable *tmp_globals_index; // id -> WpGlobal*
   GPtrArray *objects; // element-type: GObject*
   GPtrArray *object_managers; // element-type: WpObjectManager*
+  /* the stores of the object managers, in the order they were installed,
+     and the ones that can be shared indexed by key */
+  GPtrArray *object_stores; // element-type: WpObjectStore*
+  GHashTable *object_stores_index; // key -> WpObjectStore*
+
+  /* interest dispatch index; see wp_registry_get_dispatch_bucket() */
+  GHashTable *dispatch_index; // GType -> struct dispatch_bucket*
+  guint n_interests;
+  guint64 interest_checks;
+  guint64 interest_skips;
+  GSource *stats_source;
+
+  /* time-sliced exposure of tmp_globals; see expose_tmp_globals() */
+  struct expose_batch *expose_batch;
+  GSource *expose_source;
+  guint64 expose_stalls[WP_REGISTRY_N_STALL_BUCKETS];
+  gint64 expose_stall_max;
 };
 
+/* whether there are globals that not all object managers have seen yet */
+static inline gboolean
+wp_registry_has_pending_globals (WpRegistry *self)
+{
+  return self->tmp_globals->len > 0 || self->expose_batch != NULL;
+}
+
 void wp_registry_init (WpRegistry *self);
 void wp_registry_clear (WpRegistry *self);
 void wp_registry_attach (WpRegistry *self, struct pw_core *pw_core);
@@ -49,10 +84,23 @@ void wp_registry_remove_object (WpRegistry *reg, gpointer obj);
 
 WpCore * wp_registry_get_core (WpRegistry * self) G_GNUC_CONST;
 
+void wp_registry_invalidate_dispatch_index (WpRegistry * self);
+
 /* core */
 
 WpRegistry * wp_core_get_registry (WpCore * self) G_GNUC_CONST;
 
+/* object interest */
+
+GType wp_object_interest_get_gtype (WpObjectInterest * self);
+gchar * wp_object_interest_get_equals_string (WpObjectInterest * self,
+    const gchar * subject, gboolean allow_numbers);
+gboolean wp_object_interest_get_equals_id (WpObjectInterest * self,
+    WpConstraintType type, const gchar * subject, guint64 * id);
+gchar * wp_object_interest_get_equals_key (WpObjectInterest * self,
+    WpConstraintType type, const gchar * subject, gboolean * numeric);
+void wp_object_interest_append_key (WpObjectInterest * self, GString * key);
+
 /* global */
 
 typedef enum {
@@ -0,0 +1,39 @@
+/* WirePlumber
+ *
+ * Copyright © 2023 The WirePlumber project contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_SPA_POD_ARENA_H__
+#define __WIREPLUMBER_SPA_POD_ARENA_H__
+
+#include "spa-pod.h"
+
+G_BEGIN_DECLS
+
+/* An arena that stores pods back to back in a single buffer. It is used to
+ * collect the results of an enumeration without allocating a buffer for
+ * each pod; when finished, the pods are returned as constant WpSpaPod views
+ * into the buffer, which is freed when the last of them is unrefed */
+typedef struct _WpSpaPodArena WpSpaPodArena;
+
+WpSpaPodArena * wp_spa_pod_arena_new (void);
+
+void wp_spa_pod_arena_free (WpSpaPodArena * self);
+
+/* copies @em pod at the end of the arena */
+void wp_spa_pod_arena_add (WpSpaPodArena * self, const struct spa_pod * pod);
+
+guint wp_spa_pod_arena_get_n_pods (WpSpaPodArena * self);
+
+/* (transfer full) (element-type: WpSpaPod*): returns the pods that were
+ * added so far and leaves the arena empty; the buffer is now owned
+ * by the returned pods */
+GPtrArray * wp_spa_pod_arena_steal_pods (WpSpaPodArena * self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpSpaPodArena, wp_spa_pod_arena_free)
+
+G_END_DECLS
+
+#endif
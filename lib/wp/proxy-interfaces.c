@@ -304,3 +304,26 @@ wp_pipewire_object_set_param (WpPipewireObject * self, const gchar * id,
   return WP_PIPEWIRE_OBJECT_GET_IFACE (self)->set_param (self, id, flags,
       param);
 }
+
+/*!
+ * \brief Retrieves statistics about the params that the object keeps cached,
+ * so that the memory held by each object can be inspected
+ *
+ * Only params whose WP_PIPEWIRE_OBJECT_FEATURE_PARAM_* feature is active are
+ * cached; objects that don't cache params report zero on all fields.
+ *
+ * \ingroup wppipewireobject
+ * \param self the pipewire object
+ * \param stats (out caller-allocates): the location to store the statistics
+ */
+void
+wp_pipewire_object_get_params_stats (WpPipewireObject * self,
+    WpPipewireObjectParamsStats * stats)
+{
+  g_return_if_fail (WP_IS_PIPEWIRE_OBJECT (self));
+  g_return_if_fail (stats != NULL);
+
+  *stats = (WpPipewireObjectParamsStats) { 0, };
+  if (WP_PIPEWIRE_OBJECT_GET_IFACE (self)->get_params_stats)
+    WP_PIPEWIRE_OBJECT_GET_IFACE (self)->get_params_stats (self, stats);
+}
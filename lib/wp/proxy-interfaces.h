@@ -15,6 +15,21 @@
 
 G_BEGIN_DECLS
 
+/*!
+ * \brief Statistics about the params that a WpPipewireObject keeps cached
+ * \ingroup wppipewireobject
+ */
+typedef struct _WpPipewireObjectParamsStats WpPipewireObjectParamsStats;
+struct _WpPipewireObjectParamsStats
+{
+  /*! the number of param ids that have cached params */
+  guint n_ids;
+  /*! the total number of cached params */
+  guint n_params;
+  /*! the total size of the cached params, in bytes */
+  gsize size;
+};
+
 /*!
  * \brief The WpPipewireObject GType
  * \ingroup wppipewireobject
@@ -47,8 +62,11 @@ struct _WpPipewireObjectInterface
   gboolean (*set_param) (WpPipewireObject * self, const gchar * id,
       guint32 flags, WpSpaPod * param);
 
+  void (*get_params_stats) (WpPipewireObject * self,
+      WpPipewireObjectParamsStats * stats);
+
   /*< private >*/
-  WP_PADDING(5)
+  WP_PADDING(4)
 };
 
 WP_API
@@ -85,6 +103,10 @@ WP_API
 gboolean wp_pipewire_object_set_param (WpPipewireObject * self,
     const gchar * id, guint32 flags, WpSpaPod * param);
 
+WP_API
+void wp_pipewire_object_get_params_stats (WpPipewireObject * self,
+    WpPipewireObjectParamsStats * stats);
+
 
 G_END_DECLS
 
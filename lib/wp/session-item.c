@@ -428,6 +428,7 @@ wp_session_item_set_properties (WpSessionItem * self,
   priv = wp_session_item_get_instance_private (self);
   g_clear_pointer (&priv->properties, wp_properties_unref);
   priv->properties = wp_properties_ensure_unique_owner (props);
+  g_object_notify (G_OBJECT (self), "properties");
 }
 
 static gboolean
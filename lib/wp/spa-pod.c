@@ -10,6 +10,9 @@
 
 #include "spa-pod.h"
 #include "spa-type.h"
+#include "core.h"
+#include "log.h"
+#include "private/spa-pod-arena.h"
 
 #include <spa/utils/type-info.h>
 #include <spa/pod/builder.h>
@@ -18,6 +21,9 @@
 
 #define WP_SPA_POD_BUILDER_REALLOC_STEP_SIZE 64
 #define WP_SPA_POD_ID_PROPERTY_NAME_MAX 16
+#define WP_SPA_POD_ARENA_INITIAL_SIZE 1024
+#define WP_SPA_POD_SCRATCH_CHUNK_SIZE 4096
+#define WP_SPA_POD_SCRATCH_MIN_SIZE 256
 
 /*! \defgroup wpspapod WpSpaPod */
 /*!
@@ -81,6 +87,27 @@ struct _WpSpaPod
 
 G_DEFINE_BOXED_TYPE (WpSpaPod, wp_spa_pod, wp_spa_pod_ref, wp_spa_pod_unref)
 
+/* A block of memory that scratch builders of a core allocate from. Builders
+ * hold a reference on the chunk they allocated from, so their pods stay valid
+ * even after the chunk has been replaced by a fresh one */
+typedef struct _WpSpaPodScratchChunk WpSpaPodScratchChunk;
+struct _WpSpaPodScratchChunk
+{
+  gsize offset;                 /* first free byte */
+  guint n_users;                /* number of builders allocated in the chunk */
+  WpSpaPodBuilder *open;        /* the builder that owns the free space */
+};
+
+#define SCRATCH_CHUNK_DATA(c) \
+  ((guint8 *) (c) + SPA_ROUND_UP_N (sizeof (WpSpaPodScratchChunk), 8))
+
+typedef struct _WpSpaPodScratch WpSpaPodScratch;
+struct _WpSpaPodScratch
+{
+  WpSpaPodScratchChunk *chunk;
+  GSource *reset_source;
+};
+
 struct _WpSpaPodBuilder
 {
   struct spa_pod_builder builder;
@@ -88,6 +115,14 @@ struct _WpSpaPodBuilder
   WpSpaType type;
   size_t size;
   guint8 *buf;
+
+  /* small pods are built in place, without allocating */
+  guint64 head[WP_SPA_POD_BUILDER_REALLOC_STEP_SIZE / sizeof (guint64)];
+
+  /* only used for builders that allocate from a core's scratch chunk */
+  WpSpaPodScratchChunk *chunk;
+  gsize chunk_start;
+  gsize chunk_end;
 };
 
 G_DEFINE_BOXED_TYPE (WpSpaPodBuilder, wp_spa_pod_builder,
@@ -104,13 +139,25 @@ struct _WpSpaPodParser
 G_DEFINE_BOXED_TYPE (WpSpaPodParser, wp_spa_pod_parser,
     wp_spa_pod_parser_ref, wp_spa_pod_parser_unref)
 
+static void wp_spa_pod_builder_release_chunk (WpSpaPodBuilder *self);
+
 static int
 wp_spa_pod_builder_overflow (gpointer data, uint32_t size)
 {
   WpSpaPodBuilder *self = data;
   const uint32_t next_size = self->size + WP_SPA_POD_BUILDER_REALLOC_STEP_SIZE;
   const uint32_t new_size = size > next_size ? size : next_size;
-  self->buf = g_realloc (self->buf, new_size);
+
+  /* move the data out of the head or the scratch chunk to the heap */
+  if (!self->buf) {
+    self->buf = g_malloc (new_size);
+    memcpy (self->buf, self->builder.data, self->builder.state.offset);
+    if (self->chunk)
+      wp_spa_pod_builder_release_chunk (self);
+  } else {
+    self->buf = g_realloc (self->buf, new_size);
+  }
+
   self->builder.data = self->buf;
   self->builder.size = new_size;
   self->size = new_size;
@@ -126,9 +173,14 @@ static WpSpaPodBuilder *
 wp_spa_pod_builder_new (size_t size, WpSpaType type)
 {
   WpSpaPodBuilder *self = g_rc_box_new0 (WpSpaPodBuilder);
-  self->size = size;
-  self->buf = g_new0 (guint8, self->size);
-  self->builder = SPA_POD_BUILDER_INIT (self->buf, self->size);
+  if (size <= sizeof (self->head)) {
+    self->size = sizeof (self->head);
+    self->builder = SPA_POD_BUILDER_INIT (self->head, self->size);
+  } else {
+    self->size = size;
+    self->buf = g_new0 (guint8, self->size);
+    self->builder = SPA_POD_BUILDER_INIT (self->buf, self->size);
+  }
   self->type = type;
 
   spa_pod_builder_set_callbacks (&self->builder, &builder_callbacks, self);
@@ -1850,6 +1902,45 @@ wp_spa_pod_filter (WpSpaPod *self, WpSpaPod *filter)
   return NULL;
 }
 
+/*!
+ * \brief Checks if \a self and \a other have a non-empty intersection
+ *
+ * This performs the same intersection as wp_spa_pod_filter(), including
+ * the intersection of choices and ranges, but it does not construct a new
+ * WpSpaPod with the result. It is meant to be used for checking if two
+ * formats are compatible, without caring about the resulting format.
+ *
+ * \ingroup wpspapod
+ * \since 0.4.18
+ * \param self the first pod
+ * \param other the second pod
+ * \returns TRUE if the intersection between \a self and \a other is possible,
+ *   FALSE otherwise
+ */
+gboolean
+wp_spa_pod_intersects (WpSpaPod *self, WpSpaPod *other)
+{
+  char buffer[1024];
+  g_autofree char *heap_buffer = NULL;
+  struct spa_pod_builder b;
+  struct spa_pod *result = NULL;
+  gsize size;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (other, FALSE);
+
+  /* the result is never bigger than both pods together */
+  size = SPA_POD_SIZE (self->pod) + SPA_POD_SIZE (other->pod);
+  if (size <= sizeof (buffer)) {
+    b = SPA_POD_BUILDER_INIT (buffer, sizeof (buffer));
+  } else {
+    heap_buffer = g_malloc (size);
+    b = SPA_POD_BUILDER_INIT (heap_buffer, size);
+  }
+
+  return spa_pod_filter (&b, &result, self->pod, other->pod) >= 0;
+}
+
 /*!
  * \brief Increases the reference count of a spa pod builder
  *
@@ -1866,6 +1957,8 @@ wp_spa_pod_builder_ref (WpSpaPodBuilder *self)
 static void
 wp_spa_pod_builder_free (WpSpaPodBuilder *self)
 {
+  if (self->chunk)
+    wp_spa_pod_builder_release_chunk (self);
   g_clear_pointer (&self->buf, g_free);
 }
 
@@ -1882,6 +1975,140 @@ wp_spa_pod_builder_unref (WpSpaPodBuilder *self)
   g_rc_box_release_full (self, (GDestroyNotify) wp_spa_pod_builder_free);
 }
 
+static WpSpaPodScratchChunk *
+wp_spa_pod_scratch_chunk_new (void)
+{
+  return g_rc_box_alloc0 (SPA_ROUND_UP_N (sizeof (WpSpaPodScratchChunk), 8) +
+      WP_SPA_POD_SCRATCH_CHUNK_SIZE);
+}
+
+static void
+wp_spa_pod_scratch_chunk_unref (WpSpaPodScratchChunk *chunk)
+{
+  g_rc_box_release (chunk);
+}
+
+static void
+wp_spa_pod_builder_release_chunk (WpSpaPodBuilder *self)
+{
+  WpSpaPodScratchChunk *chunk = g_steal_pointer (&self->chunk);
+
+  /* rewind if this was the last allocation of the chunk */
+  if (chunk->open == self) {
+    chunk->open = NULL;
+    chunk->offset = self->chunk_start;
+  } else if (chunk->offset == self->chunk_end) {
+    chunk->offset = self->chunk_start;
+  }
+
+  if (--chunk->n_users == 0)
+    chunk->offset = 0;
+
+  wp_spa_pod_scratch_chunk_unref (chunk);
+}
+
+static void
+wp_spa_pod_scratch_free (WpSpaPodScratch *scratch)
+{
+  if (scratch->reset_source)
+    g_source_destroy (scratch->reset_source);
+  g_clear_pointer (&scratch->reset_source, g_source_unref);
+  g_clear_pointer (&scratch->chunk, wp_spa_pod_scratch_chunk_unref);
+  g_slice_free (WpSpaPodScratch, scratch);
+}
+
+static gboolean
+wp_spa_pod_scratch_reset (WpSpaPodScratch *scratch)
+{
+  g_clear_pointer (&scratch->reset_source, g_source_unref);
+
+  /* pods that are still alive keep the chunk in use; if they pin too much
+     of it, leave it to them and start the next iteration on a fresh one */
+  if (scratch->chunk && scratch->chunk->n_users > 0 &&
+      scratch->chunk->offset > WP_SPA_POD_SCRATCH_CHUNK_SIZE / 2)
+    g_clear_pointer (&scratch->chunk, wp_spa_pod_scratch_chunk_unref);
+
+  return G_SOURCE_REMOVE;
+}
+
+static WpSpaPodScratch *
+wp_spa_pod_scratch_get (WpCore *core)
+{
+  static GQuark quark = 0;
+  WpSpaPodScratch *scratch;
+
+  if (G_UNLIKELY (!quark))
+    quark = g_quark_from_static_string ("wp-spa-pod-scratch");
+
+  scratch = g_object_get_qdata (G_OBJECT (core), quark);
+  if (!scratch) {
+    scratch = g_slice_new0 (WpSpaPodScratch);
+    g_object_set_qdata_full (G_OBJECT (core), quark, scratch,
+        (GDestroyNotify) wp_spa_pod_scratch_free);
+  }
+  return scratch;
+}
+
+/*!
+ * \brief Makes the builder allocate its data from the scratch memory of
+ *   \a core instead of the heap
+ *
+ * The scratch memory is recycled as soon as the pods built on it are
+ * destroyed, so this is meant for short lived pods, such as the ones that
+ * are built only to be passed to wp_pipewire_object_set_param(). Pods that
+ * live longer keep their part of the scratch memory alive and remain valid.
+ *
+ * This must be called right after constructing the builder, before adding
+ * any values to it, and only from the thread of \a core's GMainContext.
+ * If the scratch memory is not available, for instance because another
+ * scratch builder is still open, the builder keeps using the heap.
+ *
+ * \ingroup wpspapod
+ * \since 0.4.18
+ * \param self the spa pod builder object
+ * \param core the core that owns the scratch memory
+ */
+void
+wp_spa_pod_builder_use_scratch (WpSpaPodBuilder *self, WpCore *core)
+{
+  WpSpaPodScratch *scratch;
+  WpSpaPodScratchChunk *chunk;
+  guint8 *data;
+
+  g_return_if_fail (self);
+  g_return_if_fail (WP_IS_CORE (core));
+
+  /* already in scratch memory or already grown out of the head */
+  if (self->chunk || self->buf)
+    return;
+
+  scratch = wp_spa_pod_scratch_get (core);
+  if (!scratch->chunk)
+    scratch->chunk = wp_spa_pod_scratch_chunk_new ();
+  chunk = scratch->chunk;
+
+  if (chunk->open ||
+      chunk->offset + WP_SPA_POD_SCRATCH_MIN_SIZE > WP_SPA_POD_SCRATCH_CHUNK_SIZE)
+    return;
+
+  /* take all the free space of the chunk until the builder ends */
+  data = SCRATCH_CHUNK_DATA (chunk) + chunk->offset;
+  memcpy (data, self->builder.data, self->builder.state.offset);
+  self->chunk = g_rc_box_acquire (chunk);
+  self->chunk_start = chunk->offset;
+  self->chunk_end = WP_SPA_POD_SCRATCH_CHUNK_SIZE;
+  self->size = WP_SPA_POD_SCRATCH_CHUNK_SIZE - chunk->offset;
+  self->builder.data = data;
+  self->builder.size = self->size;
+  chunk->offset = WP_SPA_POD_SCRATCH_CHUNK_SIZE;
+  chunk->open = self;
+  chunk->n_users++;
+
+  if (!scratch->reset_source)
+    wp_core_idle_add (core, &scratch->reset_source,
+        (GSourceFunc) wp_spa_pod_scratch_reset, scratch, NULL);
+}
+
 /*!
  * \brief Creates a spa pod builder of type array
  * \ingroup wpspapod
@@ -2370,6 +2597,15 @@ wp_spa_pod_builder_end (WpSpaPodBuilder *self)
   ret->pod = spa_pod_builder_pop (&self->builder, &self->frame);
   ret->builder = wp_spa_pod_builder_ref (self);
 
+  /* Give back the unused part of the scratch chunk */
+  if (self->chunk && self->chunk->open == self) {
+    self->size = SPA_ROUND_UP_N (self->builder.state.offset, 8);
+    self->builder.size = self->size;
+    self->chunk_end = self->chunk_start + self->size;
+    self->chunk->offset = self->chunk_end;
+    self->chunk->open = NULL;
+  }
+
   /* Also copy the specific object type if it is an object */
   if (spa_pod_is_object (ret->pod))
     ret->static_pod.data_property.table =
@@ -2707,30 +2943,74 @@ wp_spa_pod_parser_get (WpSpaPodParser *self, ...)
   return res;
 }
 
-/*!
- * \brief This is the `va_list` version of wp_spa_pod_parser_get()
- *
- * \ingroup wpspapod
- * \param self the spa pod parser object
- * \param args the variable arguments passed to wp_spa_pod_parser_get()
- * \returns TRUE if the values were obtained, FALSE otherwise
- */
-gboolean
-wp_spa_pod_parser_get_valist (WpSpaPodParser *self, va_list args)
+/* collects the value of \a pod in the next variable argument, as described
+   by \a format; \a pod is NULL when the value is missing, which is only
+   allowed for optional ('?') formats */
+static gboolean
+wp_spa_pod_collect_value (const struct spa_pod *pod, const char *format,
+    WpSpaIdValue key, va_list *args)
+{
+  bool optional;
+
+  if ((optional = (*format == '?')))
+    format++;
+
+  if (!pod || !spa_pod_parser_can_collect (pod, *format)) {
+    if (!optional)
+      return FALSE;
+
+    SPA_POD_PARSER_SKIP (*format, *args);
+    return TRUE;
+  }
+
+  if (pod->type == SPA_TYPE_Choice && *format != 'V' &&
+      SPA_POD_CHOICE_TYPE(pod) == SPA_CHOICE_None)
+    pod = SPA_POD_CHOICE_CHILD(pod);
+
+  switch (*format) {
+  case 'P':  /* Pod */
+  case 'V':  /* Choice */
+  case 'O':  /* Object */
+  case 'T':  /* Struct */
+    *va_arg(*args, WpSpaPod**) = wp_spa_pod_new_wrap_copy (pod);
+    break;
+  case 'K': { /* Id as string - WirePlumber extension */
+    const char ** idstr = va_arg(*args, const char **);
+    uint32_t id = SPA_POD_VALUE(struct spa_pod_id, pod);
+    if (key) {
+      WpSpaIdTable id_table = NULL;
+      wp_spa_id_value_get_value_type (key, &id_table);
+      WpSpaIdValue id_val = wp_spa_id_table_find_value (id_table, id);
+      *idstr = wp_spa_id_value_short_name (id_val);
+    }
+    break;
+  }
+  case 'b':
+    *va_arg(*args, gboolean*) =
+        SPA_POD_VALUE(struct spa_pod_bool, pod) ? TRUE : FALSE;
+    break;
+  default:
+    SPA_POD_PARSER_COLLECT (pod, *format, *args);
+    break;
+  }
+  return TRUE;
+}
+
+static gboolean
+wp_spa_pod_parser_collect (WpSpaPodParser *self, va_list *args)
 {
   const struct spa_pod_prop *prop = NULL;
   WpSpaIdTable table = wp_spa_type_get_values_table (self->type);
 
   do {
     WpSpaIdValue key = NULL;
-    bool optional;
     const struct spa_pod *pod = NULL;
     const char *format;
 
     if (wp_spa_type_is_object (self->type)) {
       guint key_id;
       const struct spa_pod_object *object;
-      const char *key_name = va_arg(args, const char *);
+      const char *key_name = va_arg(*args, const char *);
       if (!key_name)
         break;
 
@@ -2748,55 +3028,39 @@ wp_spa_pod_parser_get_valist (WpSpaPodParser *self, va_list args)
       pod = prop ? &prop->value : NULL;
     }
 
-    if ((format = va_arg(args, char *)) == NULL)
+    if ((format = va_arg(*args, char *)) == NULL)
       break;
 
     if (self->type == SPA_TYPE_Struct)
       pod = spa_pod_parser_next (&self->parser);
 
-    if ((optional = (*format == '?')))
-      format++;
+    if (!wp_spa_pod_collect_value (pod, format, key, args))
+      return FALSE;
+  } while (TRUE);
 
-    if (!pod || !spa_pod_parser_can_collect (pod, *format)) {
-      if (!optional)
-        return FALSE;
+  return TRUE;
+}
 
-      SPA_POD_PARSER_SKIP (*format, args);
-    } else {
-      if (pod->type == SPA_TYPE_Choice && *format != 'V' &&
-          SPA_POD_CHOICE_TYPE(pod) == SPA_CHOICE_None)
-        pod = SPA_POD_CHOICE_CHILD(pod);
+/*!
+ * \brief This is the `va_list` version of wp_spa_pod_parser_get()
+ *
+ * \ingroup wpspapod
+ * \param self the spa pod parser object
+ * \param args the variable arguments passed to wp_spa_pod_parser_get()
+ * \returns TRUE if the values were obtained, FALSE otherwise
+ */
+gboolean
+wp_spa_pod_parser_get_valist (WpSpaPodParser *self, va_list args)
+{
+  va_list ap;
+  gboolean res;
 
-      switch (*format) {
-      case 'P':  /* Pod */
-      case 'V':  /* Choice */
-      case 'O':  /* Object */
-      case 'T':  /* Struct */
-        *va_arg(args, WpSpaPod**) = wp_spa_pod_new_wrap_copy (pod);
-        break;
-      case 'K': { /* Id as string - WirePlumber extension */
-        const char ** idstr = va_arg(args, const char **);
-        uint32_t id = SPA_POD_VALUE(struct spa_pod_id, pod);
-        if (key) {
-          WpSpaIdTable id_table = NULL;
-          wp_spa_id_value_get_value_type (key, &id_table);
-          WpSpaIdValue id_val = wp_spa_id_table_find_value (id_table, id);
-          *idstr = wp_spa_id_value_short_name (id_val);
-        }
-        break;
-      }
-      case 'b':
-        *va_arg(args, gboolean*) =
-            SPA_POD_VALUE(struct spa_pod_bool, pod) ? TRUE : FALSE;
-        break;
-      default:
-        SPA_POD_PARSER_COLLECT (pod, *format, args);
-        break;
-      }
-    }
-  } while (TRUE);
+  /* va_list may be an array type, so take the address of a copy */
+  va_copy (ap, args);
+  res = wp_spa_pod_parser_collect (self, &ap);
+  va_end (ap);
 
-  return TRUE;
+  return res;
 }
 
 /*!
@@ -2811,6 +3075,381 @@ wp_spa_pod_parser_end (WpSpaPodParser *self)
   spa_pod_parser_pop (&self->parser, &self->frame);
 }
 
+/*!
+ * \brief The WpSpaPodSchema GType
+ * \ingroup wpspapod
+ *
+ * A WpSpaPodSchema describes a set of properties of a specific object type,
+ * together with the format that each of them should be collected with.
+ * The property names and the formats are resolved once, when the schema
+ * is created, so that extracting them from many pods with
+ * wp_spa_pod_schema_get() only needs a single pass over the properties of
+ * each pod. This is meant for code that parses the same kind of params
+ * repeatedly, like Props or Route.
+ *
+ * \since 0.4.18
+ */
+
+typedef struct _WpSpaPodSchemaField WpSpaPodSchemaField;
+struct _WpSpaPodSchemaField
+{
+  guint32 key;
+  WpSpaIdValue key_value;   /* NULL for "id-%08x" keys */
+  gchar format[3];          /* with the optional '?' prefix */
+};
+
+struct _WpSpaPodSchema
+{
+  WpSpaType type;
+  WpSpaIdTable id_table;
+  guint n_fields;
+  WpSpaPodSchemaField fields[];
+};
+
+G_DEFINE_BOXED_TYPE (WpSpaPodSchema, wp_spa_pod_schema,
+    wp_spa_pod_schema_ref, wp_spa_pod_schema_unref)
+
+/*!
+ * \brief Creates a schema for the properties of objects of the given type
+ *
+ * The variable arguments are pairs of a property name and a format, as in
+ * wp_spa_pod_get_object(), followed by NULL. A format of NULL is not allowed,
+ * but wp_spa_pod_schema_get_pods() ignores the formats, so any valid one,
+ * like "?P", can be used by callers that only need that.
+ *
+ * \ingroup wpspapod
+ * \param type_name the type name of the objects, ex. "Spa:Pod:Object:Param:Props"
+ * \param ... pairs of property names and formats, followed by NULL
+ * \returns (transfer full) (nullable): the new schema, or NULL if the type or
+ *   one of the properties is not known
+ * \since 0.4.18
+ */
+WpSpaPodSchema *
+wp_spa_pod_schema_new (const char *type_name, ...)
+{
+  WpSpaPodSchema *self;
+  va_list args;
+  va_start (args, type_name);
+  self = wp_spa_pod_schema_new_valist (type_name, args);
+  va_end (args);
+  return self;
+}
+
+/*!
+ * \brief This is the `va_list` version of wp_spa_pod_schema_new()
+ *
+ * \ingroup wpspapod
+ * \param type_name the type name of the objects
+ * \param args pairs of property names and formats, followed by NULL
+ * \returns (transfer full) (nullable): the new schema, or NULL if the type or
+ *   one of the properties is not known
+ * \since 0.4.18
+ */
+WpSpaPodSchema *
+wp_spa_pod_schema_new_valist (const char *type_name, va_list args)
+{
+  g_autoptr (GPtrArray) keys = g_ptr_array_new ();
+  g_autoptr (GPtrArray) formats = g_ptr_array_new ();
+  const char *key_name;
+
+  while ((key_name = va_arg (args, const char *))) {
+    g_ptr_array_add (keys, (gpointer) key_name);
+    g_ptr_array_add (formats, va_arg (args, gpointer));
+  }
+
+  return wp_spa_pod_schema_new_with_fields (type_name, keys->len,
+      (const char * const *) keys->pdata,
+      (const char * const *) formats->pdata);
+}
+
+/*!
+ * \brief Creates a schema from arrays of property names and formats
+ *
+ * This is the same as wp_spa_pod_schema_new(), for callers that do not
+ * know the properties at compile time, like bindings.
+ *
+ * \ingroup wpspapod
+ * \param type_name the type name of the objects
+ * \param n_fields the number of properties
+ * \param keys (array length=n_fields): the names of the properties
+ * \param formats (array length=n_fields): the formats of the properties
+ * \returns (transfer full) (nullable): the new schema, or NULL if the type or
+ *   one of the properties is not known
+ * \since 0.4.18
+ */
+WpSpaPodSchema *
+wp_spa_pod_schema_new_with_fields (const char *type_name, guint n_fields,
+    const char * const *keys, const char * const *formats)
+{
+  WpSpaPodSchema *self;
+  WpSpaType type;
+  WpSpaIdTable table;
+
+  g_return_val_if_fail (type_name != NULL, NULL);
+  g_return_val_if_fail (n_fields == 0 || (keys && formats), NULL);
+
+  type = wp_spa_type_from_name (type_name);
+  if (type == WP_SPA_TYPE_INVALID || !wp_spa_type_is_object (type)) {
+    wp_warning ("'%s' is not an object type", type_name);
+    return NULL;
+  }
+  table = wp_spa_type_get_values_table (type);
+
+  self = g_rc_box_alloc0 (sizeof (WpSpaPodSchema) +
+      n_fields * sizeof (WpSpaPodSchemaField));
+  self->type = type;
+  self->id_table = wp_spa_type_get_object_id_values_table (type);
+  self->n_fields = n_fields;
+
+  for (guint i = 0; i < n_fields; i++) {
+    WpSpaPodSchemaField *f = &self->fields[i];
+    const char *format = formats[i];
+
+    if (!format || strlen (format) <= (format[0] == '?') ||
+        strlen (format) >= sizeof (f->format)) {
+      wp_warning ("invalid format '%s' for '%s'", format, keys[i]);
+      goto error;
+    }
+
+    if (g_str_has_prefix (keys[i], "id-")) {
+      if (sscanf (keys[i], "id-%08x", &f->key) != 1) {
+        wp_warning ("invalid property name '%s'", keys[i]);
+        goto error;
+      }
+    } else {
+      f->key_value = wp_spa_id_table_find_value_from_short_name (table,
+          keys[i]);
+      if (!f->key_value) {
+        wp_warning ("unknown property '%s' in %s", keys[i], type_name);
+        goto error;
+      }
+      f->key = wp_spa_id_value_number (f->key_value);
+    }
+    strcpy (f->format, format);
+  }
+  return self;
+
+error:
+  wp_spa_pod_schema_unref (self);
+  return NULL;
+}
+
+/*!
+ * \brief Increases the reference count of a spa pod schema
+ * \ingroup wpspapod
+ * \param self a spa pod schema
+ * \returns (transfer full): \a self with an additional reference count on it
+ * \since 0.4.18
+ */
+WpSpaPodSchema *
+wp_spa_pod_schema_ref (WpSpaPodSchema *self)
+{
+  return (WpSpaPodSchema *) g_rc_box_acquire ((gpointer) self);
+}
+
+/*!
+ * \brief Decreases the reference count on \a self and frees it when the ref
+ * count reaches zero.
+ *
+ * \ingroup wpspapod
+ * \param self (transfer full): a spa pod schema
+ * \since 0.4.18
+ */
+void
+wp_spa_pod_schema_unref (WpSpaPodSchema *self)
+{
+  g_rc_box_release (self);
+}
+
+/*!
+ * \brief Gets the number of properties described by the schema
+ * \ingroup wpspapod
+ * \param self a spa pod schema
+ * \returns the number of properties
+ * \since 0.4.18
+ */
+guint
+wp_spa_pod_schema_get_n_fields (WpSpaPodSchema *self)
+{
+  g_return_val_if_fail (self, 0);
+  return self->n_fields;
+}
+
+/*!
+ * \brief Gets the id value that describes one of the properties of the schema
+ * \ingroup wpspapod
+ * \param self a spa pod schema
+ * \param index the position of the property in the schema
+ * \returns (nullable): the id value of the property, or NULL if it was
+ *   given as "id-%08x"
+ * \since 0.4.18
+ */
+WpSpaIdValue
+wp_spa_pod_schema_get_field (WpSpaPodSchema *self, guint index)
+{
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (index < self->n_fields, NULL);
+  return self->fields[index].key_value;
+}
+
+/* schemas normally have a handful of fields; the values of larger ones are
+   looked up in a heap allocated array */
+#define SCHEMA_STACK_FIELDS 16
+
+/* finds the values of all the fields in a single pass over the properties
+   of the object; the first property with a given key wins, like with
+   spa_pod_object_find_prop() */
+static gboolean
+wp_spa_pod_schema_find_values (WpSpaPodSchema *self, WpSpaPod *pod,
+    const char **id_name, const struct spa_pod **values)
+{
+  const struct spa_pod_object *object;
+  struct spa_pod_prop *prop;
+  guint n_found = 0;
+
+  if (!wp_spa_pod_is_object (pod) || wp_spa_pod_get_spa_type (pod) != self->type)
+    return FALSE;
+
+  object = (const struct spa_pod_object *) pod->pod;
+  *id_name = wp_spa_id_value_short_name (
+      wp_spa_id_table_find_value (self->id_table, object->body.id));
+
+  for (guint i = 0; i < self->n_fields; i++)
+    values[i] = NULL;
+
+  SPA_POD_OBJECT_FOREACH (object, prop) {
+    for (guint i = 0; i < self->n_fields; i++) {
+      if (self->fields[i].key == prop->key && !values[i]) {
+        values[i] = &prop->value;
+        n_found++;
+      }
+    }
+    if (n_found == self->n_fields)
+      break;
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief Gets the values of the properties described by the schema from an
+ *   object pod
+ *
+ * The variable arguments are the locations to store the values in, in the
+ * order of the properties in the schema, as in wp_spa_pod_get_object().
+ * If a non-optional property is missing or has a different type, FALSE is
+ * returned and none of these locations, including \a id_name, is modified.
+ *
+ * \ingroup wpspapod
+ * \param self a spa pod schema
+ * \param pod an object pod of the type of the schema
+ * \param id_name (out) (optional): the id name of the object
+ * \param ... (out): the locations to store the values in
+ * \returns TRUE if the values were obtained, FALSE otherwise
+ * \since 0.4.18
+ */
+gboolean
+wp_spa_pod_schema_get (WpSpaPodSchema *self, WpSpaPod *pod,
+    const char **id_name, ...)
+{
+  va_list args;
+  gboolean res;
+  va_start (args, id_name);
+  res = wp_spa_pod_schema_get_valist (self, pod, id_name, args);
+  va_end (args);
+  return res;
+}
+
+/*!
+ * \brief This is the `va_list` version of wp_spa_pod_schema_get()
+ *
+ * \ingroup wpspapod
+ * \param self a spa pod schema
+ * \param pod an object pod of the type of the schema
+ * \param id_name (out) (optional): the id name of the object
+ * \param args (out): the locations to store the values in
+ * \returns TRUE if the values were obtained, FALSE otherwise
+ * \since 0.4.18
+ */
+gboolean
+wp_spa_pod_schema_get_valist (WpSpaPodSchema *self, WpSpaPod *pod,
+    const char **id_name, va_list args)
+{
+  const struct spa_pod *stack_values[SCHEMA_STACK_FIELDS];
+  g_autofree const struct spa_pod **heap_values = NULL;
+  const struct spa_pod **values = stack_values;
+  const char *name = NULL;
+  va_list ap;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (pod, FALSE);
+
+  if (self->n_fields > SCHEMA_STACK_FIELDS)
+    values = heap_values = g_new (const struct spa_pod *, self->n_fields);
+  if (!wp_spa_pod_schema_find_values (self, pod, &name, values))
+    return FALSE;
+
+  /* check first, so that nothing is collected if this fails */
+  for (guint i = 0; i < self->n_fields; i++) {
+    const char *format = self->fields[i].format;
+    if (*format != '?' &&
+        (!values[i] || !spa_pod_parser_can_collect (values[i], *format)))
+      return FALSE;
+  }
+
+  va_copy (ap, args);
+  for (guint i = 0; i < self->n_fields; i++)
+    wp_spa_pod_collect_value (values[i], self->fields[i].format,
+        self->fields[i].key_value, &ap);
+  va_end (ap);
+
+  if (id_name)
+    *id_name = name;
+  return TRUE;
+}
+
+/*!
+ * \brief Gets the values of the properties described by the schema from an
+ *   object pod, as pods
+ *
+ * This ignores the formats of the schema and is meant for bindings, which
+ * need to convert the values themselves.
+ *
+ * \ingroup wpspapod
+ * \param self a spa pod schema
+ * \param pod an object pod of the type of the schema
+ * \param id_name (out) (optional): the id name of the object
+ * \param values (out) (array) (transfer full): an array with room for
+ *   wp_spa_pod_schema_get_n_fields() pods; each of them is set to a constant
+ *   pod that refers to the value of the property in \a pod, which needs to
+ *   stay alive while it is used, or NULL if the property is missing
+ * \returns TRUE if \a pod is an object of the type of the schema, FALSE
+ *   otherwise, in which case neither \a id_name nor \a values is modified
+ * \since 0.4.18
+ */
+gboolean
+wp_spa_pod_schema_get_pods (WpSpaPodSchema *self, WpSpaPod *pod,
+    const char **id_name, WpSpaPod **values)
+{
+  const struct spa_pod *stack_found[SCHEMA_STACK_FIELDS];
+  g_autofree const struct spa_pod **heap_found = NULL;
+  const struct spa_pod **found = stack_found;
+  const char *name = NULL;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (pod, FALSE);
+
+  if (self->n_fields > SCHEMA_STACK_FIELDS)
+    found = heap_found = g_new (const struct spa_pod *, self->n_fields);
+  if (!wp_spa_pod_schema_find_values (self, pod, &name, found))
+    return FALSE;
+
+  if (id_name)
+    *id_name = name;
+  for (guint i = 0; i < self->n_fields; i++)
+    values[i] = found[i] ? wp_spa_pod_new_wrap_const (found[i]) : NULL;
+  return TRUE;
+}
+
 struct _WpSpaPodIterator
 {
   WpSpaPod *pod;
@@ -3095,3 +3734,91 @@ wp_spa_pod_new_iterator (WpSpaPod *pod)
 
   return it;
 }
+
+struct _WpSpaPodArena
+{
+  WpSpaPodBuilder *builder;
+  GArray *offsets;
+};
+
+WpSpaPodArena *
+wp_spa_pod_arena_new (void)
+{
+  WpSpaPodArena *self = g_slice_new0 (WpSpaPodArena);
+  self->offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+  return self;
+}
+
+void
+wp_spa_pod_arena_free (WpSpaPodArena * self)
+{
+  g_clear_pointer (&self->builder, wp_spa_pod_builder_unref);
+  g_clear_pointer (&self->offsets, g_array_unref);
+  g_slice_free (WpSpaPodArena, self);
+}
+
+void
+wp_spa_pod_arena_add (WpSpaPodArena * self, const struct spa_pod * pod)
+{
+  WpSpaPodBuilder *b;
+  guint32 offset;
+  size_t needed;
+
+  if (!self->builder)
+    self->builder = wp_spa_pod_builder_new (WP_SPA_POD_ARENA_INITIAL_SIZE,
+        SPA_TYPE_None);
+
+  b = self->builder;
+  offset = b->builder.state.offset;
+  needed = offset + SPA_ROUND_UP_N (SPA_POD_SIZE (pod), 8);
+
+  /* grow geometrically; the builder's overflow callback only grows the
+     buffer in small steps, which is meant for building a single pod */
+  if (needed > b->size) {
+    b->size = MAX (b->size * 2, needed);
+    b->buf = g_realloc (b->buf, b->size);
+    b->builder.data = b->buf;
+    b->builder.size = b->size;
+  }
+
+  spa_pod_builder_primitive (&b->builder, pod);
+  g_array_append_val (self->offsets, offset);
+}
+
+guint
+wp_spa_pod_arena_get_n_pods (WpSpaPodArena * self)
+{
+  return self->offsets->len;
+}
+
+GPtrArray *
+wp_spa_pod_arena_steal_pods (WpSpaPodArena * self)
+{
+  g_autoptr (WpSpaPodBuilder) b = g_steal_pointer (&self->builder);
+  GPtrArray *result = g_ptr_array_new_full (self->offsets->len,
+      (GDestroyNotify) wp_spa_pod_unref);
+
+  if (!b)
+    return result;
+
+  /* the buffer is not going to grow any more, give back the spare space */
+  if (b->builder.state.offset > 0 && b->builder.state.offset < b->size) {
+    b->size = b->builder.state.offset;
+    b->buf = g_realloc (b->buf, b->size);
+    b->builder.data = b->buf;
+    b->builder.size = b->size;
+  }
+
+  /* the pods are constant views into the buffer; each of them holds a
+     reference on the builder, so the buffer is freed with the last one */
+  for (guint i = 0; i < self->offsets->len; i++) {
+    guint32 offset = g_array_index (self->offsets, guint32, i);
+    WpSpaPod *pod = wp_spa_pod_new ((const struct spa_pod *) (b->buf + offset),
+        WP_SPA_POD_REGULAR, FLAG_NO_OWNERSHIP | FLAG_CONSTANT);
+    pod->builder = wp_spa_pod_builder_ref (b);
+    g_ptr_array_add (result, pod);
+  }
+
+  g_array_set_size (self->offsets, 0);
+  return result;
+}
@@ -14,6 +14,7 @@
 #include "defs.h"
 #include "iterator.h"
 #include "spa-type.h"
+#include "core.h"
 
 G_BEGIN_DECLS
 
@@ -292,6 +293,9 @@ gboolean wp_spa_pod_fixate (WpSpaPod *self);
 WP_API
 WpSpaPod *wp_spa_pod_filter (WpSpaPod *self, WpSpaPod *filter);
 
+WP_API
+gboolean wp_spa_pod_intersects (WpSpaPod *self, WpSpaPod *other);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpSpaPod, wp_spa_pod_unref)
 
 
@@ -327,6 +331,9 @@ WpSpaPodBuilder *wp_spa_pod_builder_new_struct (void);
 WP_API
 WpSpaPodBuilder *wp_spa_pod_builder_new_sequence (guint unit);
 
+WP_API
+void wp_spa_pod_builder_use_scratch (WpSpaPodBuilder *self, WpCore *core);
+
 WP_API
 void wp_spa_pod_builder_add_none (WpSpaPodBuilder *self);
 
@@ -476,6 +483,55 @@ void wp_spa_pod_parser_end (WpSpaPodParser *self);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpSpaPodParser, wp_spa_pod_parser_unref)
 
 
+/*!
+ * \brief The WpSpaPodSchema GType
+ * \ingroup wpspapod
+ */
+#define WP_TYPE_SPA_POD_SCHEMA (wp_spa_pod_schema_get_type ())
+WP_API
+GType wp_spa_pod_schema_get_type (void);
+
+typedef struct _WpSpaPodSchema WpSpaPodSchema;
+
+WP_API
+WpSpaPodSchema *wp_spa_pod_schema_new (const char *type_name, ...)
+    G_GNUC_NULL_TERMINATED;
+
+WP_API
+WpSpaPodSchema *wp_spa_pod_schema_new_valist (const char *type_name,
+    va_list args);
+
+WP_API
+WpSpaPodSchema *wp_spa_pod_schema_new_with_fields (const char *type_name,
+    guint n_fields, const char * const *keys, const char * const *formats);
+
+WP_API
+WpSpaPodSchema *wp_spa_pod_schema_ref (WpSpaPodSchema *self);
+
+WP_API
+void wp_spa_pod_schema_unref (WpSpaPodSchema *self);
+
+WP_API
+guint wp_spa_pod_schema_get_n_fields (WpSpaPodSchema *self);
+
+WP_API
+WpSpaIdValue wp_spa_pod_schema_get_field (WpSpaPodSchema *self, guint index);
+
+WP_API
+gboolean wp_spa_pod_schema_get (WpSpaPodSchema *self, WpSpaPod *pod,
+    const char **id_name, ...);
+
+WP_API
+gboolean wp_spa_pod_schema_get_valist (WpSpaPodSchema *self, WpSpaPod *pod,
+    const char **id_name, va_list args);
+
+WP_API
+gboolean wp_spa_pod_schema_get_pods (WpSpaPodSchema *self, WpSpaPod *pod,
+    const char **id_name, WpSpaPod **values);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpSpaPodSchema, wp_spa_pod_schema_unref)
+
+
 G_END_DECLS
 
 #endif
@@ -51,6 +51,20 @@ static const WpSpaType SPA_TYPE_VENDOR_WirePlumber = 0x03000000;
 static GArray *extra_types = NULL;
 static GArray *extra_id_tables = NULL;
 
+/* name indexes, maintained while the dynamic type registry is initialized;
+   without them, lookups fall back to scanning the type tree */
+static GHashTable *types_index = NULL;       /* name -> spa_type_info */
+static GHashTable *extra_types_index = NULL; /* name -> position + 1 */
+static GHashTable *id_tables_index = NULL;   /* name -> WpSpaIdTable */
+static GHashTable *extra_id_tables_index = NULL;
+/* WpSpaIdTable -> WpSpaIdTableIndex, built on the first lookup in a table */
+static GHashTable *id_table_indexes = NULL;
+
+typedef struct {
+  GHashTable *names;       /* full name -> spa_type_info */
+  GHashTable *short_names; /* short name -> spa_type_info */
+} WpSpaIdTableIndex;
+
 typedef struct {
   const char *name;
   const struct spa_type_info *values;
@@ -132,13 +146,46 @@ _spa_type_find_by_name (const struct spa_type_info * info, const char * name)
   return NULL;
 }
 
+/* adds \a key to \a index, unless it is there already, so that lookups
+   return the first match, like the linear scans do */
+static void
+index_add (GHashTable * index, const gchar * key, gconstpointer value)
+{
+  if (!g_hash_table_contains (index, key))
+    g_hash_table_insert (index, (gpointer) key, (gpointer) value);
+}
+
+/* indexes the types in the same order as _spa_type_find_by_name() visits
+   them */
+static void
+types_index_add_tree (const struct spa_type_info * info)
+{
+  while (info->name) {
+    if (info->type == SPA_ID_INVALID && info->values)
+      types_index_add_tree (info->values);
+    index_add (types_index, info->name, info);
+    info++;
+  }
+}
+
 static const struct spa_type_info *
 wp_spa_type_info_find_by_name (const gchar *name)
 {
   const struct spa_type_info *info = NULL;
+  guint pos;
 
   g_return_val_if_fail (name != NULL, NULL);
 
+  /* the extra types are kept in an array that moves when it grows,
+     so they are indexed by position */
+  if (types_index) {
+    if ((info = g_hash_table_lookup (types_index, name)))
+      return info;
+    pos = GPOINTER_TO_UINT (g_hash_table_lookup (extra_types_index, name));
+    return pos ?
+        &g_array_index (extra_types, struct spa_type_info, pos - 1) : NULL;
+  }
+
   if (extra_types)
     info = _spa_type_find_by_name (
         (const struct spa_type_info *) extra_types->data, name);
@@ -352,6 +399,17 @@ wp_spa_id_table_from_name (const gchar *name)
   g_return_val_if_fail (name != NULL, NULL);
   const WpSpaIdTableInfo *info = NULL;
 
+  if (id_tables_index) {
+    WpSpaIdTable table;
+
+    if ((table = g_hash_table_lookup (extra_id_tables_index, name)) ||
+        (table = g_hash_table_lookup (id_tables_index, name)))
+      return table;
+
+    const struct spa_type_info *tinfo = wp_spa_type_info_find_by_name (name);
+    return tinfo ? tinfo->values : NULL;
+  }
+
   /* first look in dynamic id tables */
   if (extra_id_tables) {
     info = (const WpSpaIdTableInfo *) extra_id_tables->data;
@@ -420,6 +478,41 @@ wp_spa_id_table_find_value (WpSpaIdTable table, guint value)
   return NULL;
 }
 
+static void
+wp_spa_id_table_index_free (WpSpaIdTableIndex * self)
+{
+  g_hash_table_unref (self->names);
+  g_hash_table_unref (self->short_names);
+  g_slice_free (WpSpaIdTableIndex, self);
+}
+
+/* returns the name index of \a table, or NULL if the dynamic type registry
+   is not initialized */
+static WpSpaIdTableIndex *
+wp_spa_id_table_get_index (WpSpaIdTable table)
+{
+  WpSpaIdTableIndex *index;
+  const struct spa_type_info *info;
+
+  if (!id_table_indexes)
+    return NULL;
+
+  index = g_hash_table_lookup (id_table_indexes, table);
+  if (!index) {
+    index = g_slice_new (WpSpaIdTableIndex);
+    index->names = g_hash_table_new (g_str_hash, g_str_equal);
+    index->short_names = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (info = table; info->name; info++) {
+      index_add (index->names, info->name, info);
+      index_add (index->short_names, spa_debug_type_short_name (info->name),
+          info);
+    }
+    g_hash_table_insert (id_table_indexes, (gpointer) table, index);
+  }
+  return index;
+}
+
 /*!
  * \brief Finds a named value in an SPA Id table
  *
@@ -433,6 +526,10 @@ wp_spa_id_table_find_value_from_name (WpSpaIdTable table, const gchar * name)
 {
   g_return_val_if_fail (table != NULL, NULL);
 
+  WpSpaIdTableIndex *index = wp_spa_id_table_get_index (table);
+  if (index)
+    return g_hash_table_lookup (index->names, name);
+
   const struct spa_type_info *info = table;
   while (info && info->name) {
     if (!strcmp (info->name, name))
@@ -456,6 +553,10 @@ wp_spa_id_table_find_value_from_short_name (WpSpaIdTable table,
 {
   g_return_val_if_fail (table != NULL, NULL);
 
+  WpSpaIdTableIndex *index = wp_spa_id_table_get_index (table);
+  if (index)
+    return g_hash_table_lookup (index->short_names, short_name);
+
   const struct spa_type_info *info = table;
   while (info && info->name) {
     if (!strcmp (spa_debug_type_short_name (info->name), short_name))
@@ -665,6 +766,9 @@ wp_spa_id_value_array_get_item_type (WpSpaIdValue id, WpSpaIdTable * table)
  * This allows registering new spa types at runtime. The spa type system
  * still works if this function is not called.
  *
+ * It also indexes the names of all types and id tables, so that looking them
+ * up by name no longer needs to scan the whole type system.
+ *
  * Normally called by wp_init() when WP_INIT_SPA_TYPES is passed in its flags.
  *
  * \ingroup wpspatype
@@ -672,6 +776,8 @@ wp_spa_id_value_array_get_item_type (WpSpaIdValue id, WpSpaIdTable * table)
 void
 wp_spa_dynamic_type_init (void)
 {
+  const WpSpaIdTableInfo *tinfo;
+
   extra_types = g_array_new (TRUE, FALSE, sizeof (struct spa_type_info));
   extra_id_tables = g_array_new (TRUE, FALSE, sizeof (WpSpaIdTableInfo));
 
@@ -680,6 +786,20 @@ wp_spa_dynamic_type_init (void)
       SPA_ID_INVALID, SPA_ID_INVALID, "spa_types", SPA_TYPE_ROOT
   };
   g_array_append_val (extra_types, info);
+
+  /* the chain entry itself is matched after the spa types */
+  types_index = g_hash_table_new (g_str_hash, g_str_equal);
+  extra_types_index = g_hash_table_new (g_str_hash, g_str_equal);
+  types_index_add_tree (SPA_TYPE_ROOT);
+  index_add (extra_types_index, info.name, GUINT_TO_POINTER (1));
+
+  id_tables_index = g_hash_table_new (g_str_hash, g_str_equal);
+  extra_id_tables_index = g_hash_table_new (g_str_hash, g_str_equal);
+  for (tinfo = static_id_tables; tinfo->name; tinfo++)
+    index_add (id_tables_index, tinfo->name, tinfo->values);
+
+  id_table_indexes = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) wp_spa_id_table_index_free);
 }
 
 /*!
@@ -696,6 +816,11 @@ wp_spa_dynamic_type_deinit (void)
 {
   g_clear_pointer (&extra_types, g_array_unref);
   g_clear_pointer (&extra_id_tables, g_array_unref);
+  g_clear_pointer (&types_index, g_hash_table_unref);
+  g_clear_pointer (&extra_types_index, g_hash_table_unref);
+  g_clear_pointer (&id_tables_index, g_hash_table_unref);
+  g_clear_pointer (&extra_id_tables_index, g_hash_table_unref);
+  g_clear_pointer (&id_table_indexes, g_hash_table_unref);
 }
 
 /*!
@@ -724,6 +849,7 @@ wp_spa_dynamic_type_register (const gchar *name, WpSpaType parent,
   info.parent = parent;
   info.values = values;
   g_array_append_val (extra_types, info);
+  index_add (extra_types_index, name, GUINT_TO_POINTER (extra_types->len));
   return info.type;
 }
 
@@ -749,5 +875,6 @@ wp_spa_dynamic_id_table_register (const gchar *name,
   info.name = name;
   info.values = values;
   g_array_append_val (extra_id_tables, info);
+  index_add (extra_id_tables_index, name, values);
   return values;
 }
@@ -10,6 +10,9 @@
 
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 
 #include "log.h"
 #include "state.h"
@@ -109,11 +112,298 @@ compress_string (const gchar *str)
   return res;
 }
 
+/* write-behind */
+
+/*
+ * State files are written by a single worker thread, shared by all WpState
+ * objects. Each file has an entry in a global table that holds the latest
+ * content that was submitted for it; submitting new content while a write is
+ * still queued just replaces that content, so bursts of saves (from one or
+ * multiple WpState objects with the same name) result in a single write.
+ *
+ * The latest content is also used to answer wp_state_load() while a write is
+ * pending and to skip writes when nothing has changed; when no write is
+ * pending, it is what was last read from or written to the disk. Entries are
+ * freed once no WpState uses them and they have no writes pending.
+ *
+ * All fields are protected by writer_lock.
+ */
+struct state_file
+{
+  gchar *location;
+  gchar *group;
+  WpProperties *latest;   /* sorted; NULL if unknown */
+  guint64 serial;         /* serial of latest */
+  guint64 written_serial; /* serial of the content that is on disk */
+  guint64 failed_serial;  /* serial of the content that failed to be written */
+  gboolean queued;
+  gboolean writing;
+  guint users;
+  GError *error;          /* error of the last write, if it failed */
+};
+
+static GMutex writer_lock;
+static GCond writer_cond;
+static GHashTable *state_files = NULL; /* location -> struct state_file */
+static GThreadPool *writer_pool = NULL;
+
+static gboolean
+properties_equal (WpProperties * a, WpProperties * b)
+{
+  const struct spa_dict *da = wp_properties_peek_dict (a);
+  const struct spa_dict *db = wp_properties_peek_dict (b);
+
+  /* both dicts are sorted, so they can be compared item by item */
+  if (da->n_items != db->n_items)
+    return FALSE;
+  for (guint i = 0; i < da->n_items; i++) {
+    if (g_strcmp0 (da->items[i].key, db->items[i].key) != 0 ||
+        g_strcmp0 (da->items[i].value, db->items[i].value) != 0)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+write_file_atomically (const gchar * location, const gchar * data, gsize size,
+    GError ** error)
+{
+  g_autofree gchar *tmp = g_strdup_printf ("%s.XXXXXX", location);
+  g_autofree gchar *dir = g_path_get_dirname (location);
+  gsize written = 0;
+  int fd, dir_fd;
+
+  /* 0666 & ~umask, like g_file_set_contents() */
+  fd = g_mkstemp_full (tmp, O_WRONLY | O_CLOEXEC, 0666);
+  if (fd < 0)
+    goto error;
+
+  while (written < size) {
+    ssize_t res = write (fd, data + written, size - written);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res < 0)
+      goto error_close;
+    written += res;
+  }
+
+  if (fsync (fd) < 0)
+    goto error_close;
+  if (close (fd) < 0) {
+    fd = -1;
+    goto error_close;
+  }
+  if (rename (tmp, location) < 0)
+    goto error_unlink;
+
+  /* make the rename itself durable */
+  dir_fd = open (dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd >= 0) {
+    fsync (dir_fd);
+    close (dir_fd);
+  }
+  return TRUE;
+
+error_close:
+  {
+    int err = errno;
+    if (fd >= 0)
+      close (fd);
+    errno = err;
+  }
+error_unlink:
+  {
+    int err = errno;
+    g_unlink (tmp);
+    errno = err;
+  }
+error:
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+      "failed to write %s: %s", location, g_strerror (errno));
+  return FALSE;
+}
+
+static gboolean
+write_state (const gchar * location, const gchar * group, WpProperties * props,
+    GError ** error)
+{
+  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+  g_autofree gchar *data = NULL;
+  gsize size = 0;
+
+  for (it = wp_properties_new_iterator (props);
+      wp_iterator_next (it, &item);
+      g_value_unset (&item)) {
+    WpPropertiesItem *pi = g_value_get_boxed (&item);
+    const gchar *key = wp_properties_item_get_key (pi);
+    const gchar *val = wp_properties_item_get_value (pi);
+    g_autofree gchar *escaped_key = escape_string (key);
+    if (escaped_key)
+      g_key_file_set_string (keyfile, group, escaped_key, val);
+  }
+
+  data = g_key_file_to_data (keyfile, &size, NULL);
+  return write_file_atomically (location, data, size, error);
+}
+
+static WpProperties *
+read_state (const gchar * location, const gchar * group)
+{
+  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  g_auto (GStrv) keys = NULL;
+
+  /* Open */
+  if (!g_key_file_load_from_file (keyfile, location, G_KEY_FILE_NONE, NULL))
+    return g_steal_pointer (&props);
+
+  /* Load all keys */
+  keys = g_key_file_get_keys (keyfile, group, NULL, NULL);
+  if (!keys)
+    return g_steal_pointer (&props);
+
+  for (guint i = 0; keys[i]; i++) {
+    g_autofree gchar *compressed_key = NULL;
+    const gchar *key = keys[i];
+    g_autofree gchar *val = NULL;
+    val = g_key_file_get_string (keyfile, group, key, NULL);
+    if (!val)
+      continue;
+    compressed_key = compress_string (key);
+    if (compressed_key)
+      wp_properties_set (props, compressed_key, val);
+  }
+
+  return g_steal_pointer (&props);
+}
+
+static void
+state_file_free (struct state_file * f)
+{
+  g_clear_pointer (&f->location, g_free);
+  g_clear_pointer (&f->group, g_free);
+  g_clear_pointer (&f->latest, wp_properties_unref);
+  g_clear_error (&f->error);
+  g_slice_free (struct state_file, f);
+}
+
+/* call with writer_lock held */
+static gboolean
+state_file_is_pending (struct state_file * f)
+{
+  return f->queued || f->writing ||
+      (f->written_serial != f->serial && f->failed_serial != f->serial);
+}
+
+/* call with writer_lock held */
+static void
+state_file_maybe_free (struct state_file * f)
+{
+  if (f->users == 0 && !state_file_is_pending (f))
+    g_hash_table_remove (state_files, f->location);
+}
+
+/* call with writer_lock held; takes ownership of error */
+static void
+state_file_write_done (struct state_file * f, guint64 serial, GError * error)
+{
+  f->writing = FALSE;
+  if (error) {
+    f->failed_serial = serial;
+    g_clear_error (&f->error);
+    f->error = error;
+  } else {
+    if (f->written_serial < serial)
+      f->written_serial = serial;
+    g_clear_error (&f->error);
+  }
+  g_cond_broadcast (&writer_cond);
+}
+
+static void
+state_writer_func (struct state_file * f, gpointer user_data)
+{
+  g_autoptr (WpProperties) props = NULL;
+  GError *error = NULL;
+  guint64 serial;
+
+  /* take a private copy, the refcount of 'latest' is not thread-safe */
+  g_mutex_lock (&writer_lock);
+  while (f->writing)
+    g_cond_wait (&writer_cond, &writer_lock);
+  f->queued = FALSE;
+  serial = f->serial;
+  if (f->latest && f->written_serial != serial)
+    props = wp_properties_copy (f->latest);
+  f->writing = (props != NULL);
+  g_cond_broadcast (&writer_cond);
+  g_mutex_unlock (&writer_lock);
+
+  if (props) {
+    wp_debug ("writing state into %s", f->location);
+
+    if (!write_state (f->location, f->group, props, &error))
+      wp_warning ("could not save %s: %s", f->group, error->message);
+  }
+
+  g_mutex_lock (&writer_lock);
+  if (props)
+    state_file_write_done (f, serial, error);
+  state_file_maybe_free (f);
+  g_mutex_unlock (&writer_lock);
+}
+
+/* call with writer_lock held */
+static struct state_file *
+get_state_file (const gchar * location, const gchar * group)
+{
+  struct state_file *f;
+
+  if (G_UNLIKELY (!state_files)) {
+    state_files = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify) state_file_free);
+    writer_pool = g_thread_pool_new ((GFunc) state_writer_func, NULL, 1,
+        FALSE, NULL);
+  }
+
+  f = g_hash_table_lookup (state_files, location);
+  if (!f) {
+    f = g_slice_new0 (struct state_file);
+    f->location = g_strdup (location);
+    f->group = g_strdup (group);
+    g_hash_table_insert (state_files, f->location, f);
+  }
+  return f;
+}
+
+/* call with writer_lock held; the caller must be a user of the file */
+static gboolean
+state_file_wait (struct state_file * f, GError ** error)
+{
+  while (state_file_is_pending (f))
+    g_cond_wait (&writer_cond, &writer_lock);
+
+  if (f->written_serial != f->serial && f->error) {
+    g_propagate_error (error, g_error_copy (f->error));
+    return FALSE;
+  }
+  return TRUE;
+}
+
 /*! \defgroup wpstate WpState */
 /*!
  * \struct WpState
  *
- * The WpState class saves and loads properties from a file
+ * The WpState class saves and loads properties from a file.
+ *
+ * Besides the synchronous wp_state_save(), states can also be saved with
+ * wp_state_save_deferred(), which returns immediately and leaves the actual
+ * disk I/O to a worker thread (write-behind). Files are always replaced
+ * atomically, by writing to a temporary file, syncing it and renaming it
+ * over the old one. Use wp_state_flush() or wp_state_flush_all() to wait
+ * until all deferred writes are on disk, for example on shutdown.
  *
  * \gproperties
  * \gproperty{name, gchar *, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY,
@@ -133,7 +423,7 @@ struct _WpState
   gchar *name;
 
   gchar *location;
-  GKeyFile *keyfile;
+  struct state_file *file;
 };
 
 G_DEFINE_TYPE (WpState, wp_state, G_TYPE_OBJECT)
@@ -175,6 +465,18 @@ wp_state_ensure_location (WpState *self)
   g_return_if_fail (self->location);
 }
 
+/* call with writer_lock held */
+static struct state_file *
+wp_state_get_file (WpState *self)
+{
+  if (!self->file) {
+    wp_state_ensure_location (self);
+    self->file = get_state_file (self->location, self->name);
+    self->file->users++;
+  }
+  return self->file;
+}
+
 static void
 wp_state_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec)
@@ -213,6 +515,14 @@ wp_state_finalize (GObject * object)
 {
   WpState * self = WP_STATE (object);
 
+  if (self->file) {
+    g_mutex_lock (&writer_lock);
+    self->file->users--;
+    state_file_maybe_free (self->file);
+    self->file = NULL;
+    g_mutex_unlock (&writer_lock);
+  }
+
   g_clear_pointer (&self->name, g_free);
   g_clear_pointer (&self->location, g_free);
 
@@ -285,20 +595,36 @@ wp_state_get_location (WpState *self)
 
 /*!
  * \brief Clears the state removing its file
+ *
+ * Any deferred saves of this state are waited for before the file is removed.
+ *
  * \ingroup wpstate
  * \param self the state
  */
 void
 wp_state_clear (WpState *self)
 {
+  struct state_file *f;
+
   g_return_if_fail (WP_IS_STATE (self));
-  wp_state_ensure_location (self);
+
+  g_mutex_lock (&writer_lock);
+  f = wp_state_get_file (self);
+  state_file_wait (f, NULL);
+  g_clear_pointer (&f->latest, wp_properties_unref);
+  f->written_serial = f->serial;
+  g_clear_error (&f->error);
   if (remove (self->location) < 0)
     wp_warning ("failed to remove %s: %s", self->location, g_strerror (errno));
+  g_mutex_unlock (&writer_lock);
 }
 
 /*!
  * \brief Saves new properties in the state, overwriting all previous data.
+ *
+ * This function writes the file synchronously, after waiting for any
+ * deferred writes of the same state to finish.
+ *
  * \ingroup wpstate
  * \param self the state
  * \param props (transfer none): the properties to save
@@ -308,37 +634,150 @@ wp_state_clear (WpState *self)
 gboolean
 wp_state_save (WpState *self, WpProperties *props, GError ** error)
 {
-  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) item = G_VALUE_INIT;
+  g_autoptr (WpProperties) copy = NULL;
+  g_autoptr (WpProperties) latest = NULL;
+  struct state_file *f;
   GError *err = NULL;
+  gboolean ret;
+  guint64 serial;
 
   g_return_val_if_fail (WP_IS_STATE (self), FALSE);
   g_return_val_if_fail (props, FALSE);
-  wp_state_ensure_location (self);
+
+  copy = wp_properties_copy (props);
+  wp_properties_sort (copy);
+  latest = wp_properties_copy (copy);
+
+  /* publish the new content and write it without holding the lock;
+     the 'writing' flag keeps the worker off this file meanwhile */
+  g_mutex_lock (&writer_lock);
+  f = wp_state_get_file (self);
+  state_file_wait (f, NULL);
+  g_clear_pointer (&f->latest, wp_properties_unref);
+  f->latest = g_steal_pointer (&latest);
+  serial = ++f->serial;
+  f->writing = TRUE;
+  g_mutex_unlock (&writer_lock);
 
   wp_info_object (self, "saving state into %s", self->location);
 
-  /* Set the properties */
-  for (it = wp_properties_new_iterator (props);
-      wp_iterator_next (it, &item);
-      g_value_unset (&item)) {
-    WpPropertiesItem *pi = g_value_get_boxed (&item);
-    const gchar *key = wp_properties_item_get_key (pi);
-    const gchar *val = wp_properties_item_get_value (pi);
-    g_autofree gchar *escaped_key = escape_string (key);
-    if (escaped_key)
-      g_key_file_set_string (keyfile, self->name, escaped_key, val);
-  }
+  ret = write_state (self->location, self->name, copy, &err);
+
+  g_mutex_lock (&writer_lock);
+  state_file_write_done (f, serial, ret ? NULL : g_error_copy (err));
+  g_mutex_unlock (&writer_lock);
 
-  if (!g_key_file_save_to_file (keyfile, self->location, &err)) {
+  if (!ret) {
     g_propagate_prefixed_error (error, err, "could not save %s: ", self->name);
     return FALSE;
   }
-
   return TRUE;
 }
 
+/*!
+ * \brief Saves new properties in the state, overwriting all previous data,
+ * without blocking on disk I/O.
+ *
+ * The properties are copied and the file is written later on a worker thread.
+ * If the state already contains exactly these properties, nothing is written.
+ * If another save for the same state is still pending, the two are merged
+ * and only the latest properties are written. Errors are logged; the last
+ * one can also be retrieved with wp_state_flush().
+ *
+ * wp_state_load() returns the saved properties immediately, even if they have
+ * not been written to the disk yet. Once they are written, it reads the file
+ * again.
+ *
+ * \ingroup wpstate
+ * \param self the state
+ * \param props (transfer none): the properties to save
+ */
+void
+wp_state_save_deferred (WpState *self, WpProperties *props)
+{
+  g_autoptr (WpProperties) copy = NULL;
+  struct state_file *f;
+
+  g_return_if_fail (WP_IS_STATE (self));
+  g_return_if_fail (props);
+
+  copy = wp_properties_copy (props);
+  wp_properties_sort (copy);
+
+  g_mutex_lock (&writer_lock);
+  f = wp_state_get_file (self);
+
+  /* content that failed to be written is submitted again, to retry */
+  if (f->latest && properties_equal (f->latest, copy) &&
+      (f->queued || f->written_serial == f->serial)) {
+    wp_trace_object (self, "state %s has not changed", self->name);
+  } else {
+    g_clear_pointer (&f->latest, wp_properties_unref);
+    f->latest = g_steal_pointer (&copy);
+    f->serial++;
+
+    if (!f->queued) {
+      f->queued = TRUE;
+      g_thread_pool_push (writer_pool, f, NULL);
+    }
+  }
+  g_mutex_unlock (&writer_lock);
+}
+
+/*!
+ * \brief Waits until all the deferred saves of this state are written
+ *
+ * \ingroup wpstate
+ * \param self the state
+ * \param error (out)(optional): return location for a GError, or NULL
+ * \returns FALSE if the last deferred write failed, TRUE otherwise
+ */
+gboolean
+wp_state_flush (WpState *self, GError ** error)
+{
+  gboolean ret;
+
+  g_return_val_if_fail (WP_IS_STATE (self), FALSE);
+
+  g_mutex_lock (&writer_lock);
+  ret = state_file_wait (wp_state_get_file (self), error);
+  g_mutex_unlock (&writer_lock);
+
+  return ret;
+}
+
+/*!
+ * \brief Waits until the deferred saves of all states are written
+ *
+ * This is meant to be called on shutdown, after all the components that may
+ * save states have been destroyed.
+ *
+ * \ingroup wpstate
+ */
+static gboolean
+find_pending_state_file (gpointer key, gpointer value, gpointer user_data)
+{
+  return state_file_is_pending (value);
+}
+
+void
+wp_state_flush_all (void)
+{
+  struct state_file *f;
+
+  /* waiting releases the lock, which lets the table change; start over
+     after every wait and keep the file alive while waiting on it */
+  g_mutex_lock (&writer_lock);
+  while (state_files &&
+      (f = g_hash_table_find (state_files, find_pending_state_file, NULL))) {
+    f->users++;
+    state_file_wait (f, NULL);
+    f->users--;
+    state_file_maybe_free (f);
+  }
+  g_mutex_unlock (&writer_lock);
+}
+
 /*!
  * \brief Loads the state data from the file system
  *
@@ -353,36 +792,36 @@ wp_state_save (WpState *self, WpProperties *props, GError ** error)
 WpProperties *
 wp_state_load (WpState *self)
 {
-  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
-  g_autoptr (WpProperties) props = wp_properties_new_empty ();
-  gchar ** keys = NULL;
+  g_autoptr (WpProperties) props = NULL;
+  struct state_file *f;
+  guint64 serial;
 
   g_return_val_if_fail (WP_IS_STATE (self), NULL);
-  wp_state_ensure_location (self);
 
-  /* Open */
-  if (!g_key_file_load_from_file (keyfile, self->location,
-      G_KEY_FILE_NONE, NULL))
-    return g_steal_pointer (&props);
+  /* while a write is pending, the latest saved state is not on the disk yet */
+  g_mutex_lock (&writer_lock);
+  f = wp_state_get_file (self);
+  if (f->latest && state_file_is_pending (f))
+    props = wp_properties_copy (f->latest);
+  serial = f->serial;
+  g_mutex_unlock (&writer_lock);
 
-  /* Load all keys */
-  keys = g_key_file_get_keys (keyfile, self->name, NULL, NULL);
-  if (!keys)
+  if (props)
     return g_steal_pointer (&props);
 
-  for (guint i = 0; keys[i]; i++) {
-    g_autofree gchar *compressed_key = NULL;
-    const gchar *key = keys[i];
-    g_autofree gchar *val = NULL;
-    val = g_key_file_get_string (keyfile, self->name, key, NULL);
-    if (!val)
-      continue;
-    compressed_key = compress_string (key);
-    if (compressed_key)
-      wp_properties_set (props, compressed_key, val);
+  /* otherwise the file is read every time, as it may have been changed
+     outside of this process */
+  props = read_state (self->location, self->name);
+
+  /* remember what is on the disk, so that unchanged saves can be skipped;
+     unless it was saved meanwhile or the last write failed */
+  g_mutex_lock (&writer_lock);
+  if (f->serial == serial && f->written_serial == serial) {
+    g_clear_pointer (&f->latest, wp_properties_unref);
+    f->latest = wp_properties_copy (props);
+    wp_properties_sort (f->latest);
   }
-
-  g_strfreev (keys);
+  g_mutex_unlock (&writer_lock);
 
   return g_steal_pointer (&props);
 }
@@ -38,6 +38,15 @@ void wp_state_clear (WpState *self);
 WP_API
 gboolean wp_state_save (WpState *self, WpProperties *props, GError ** error);
 
+WP_API
+void wp_state_save_deferred (WpState *self, WpProperties *props);
+
+WP_API
+gboolean wp_state_flush (WpState *self, GError ** error);
+
+WP_API
+void wp_state_flush_all (void);
+
 WP_API
 WpProperties * wp_state_load (WpState *self);
 
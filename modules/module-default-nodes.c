@@ -47,6 +47,8 @@ struct _WpDefaultNodes
   WpObjectManager *metadata_om;
   WpObjectManager *rescan_om;
   GSource *timeout_source;
+  WpSpaPodSchema *route_schema;
+  WpSpaPodSchema *enum_route_schema;
 
   /* properties */
   guint save_interval_ms;
@@ -121,7 +123,6 @@ static gboolean
 timeout_save_state_callback (WpDefaultNodes *self)
 {
   g_autoptr (WpProperties) props = wp_properties_new_empty ();
-  g_autoptr (GError) error = NULL;
 
   for (gint i = 0; i < N_DEFAULT_NODES; i++) {
     if (self->defaults[i].config_value)
@@ -135,8 +136,7 @@ timeout_save_state_callback (WpDefaultNodes *self)
     }
   }
 
-  if (!wp_state_save (self->state, props, &error))
-    wp_warning_object (self, "%s", error->message);
+  wp_state_save_deferred (self->state, props);
 
   g_clear_pointer (&self->timeout_source, g_source_unref);
   return G_SOURCE_REMOVE;
@@ -188,10 +188,8 @@ node_has_available_routes (WpDefaultNodes * self, WpNode *node)
       gint route_device = -1;
       guint32 route_avail = SPA_PARAM_AVAILABILITY_unknown;
 
-      if (!wp_spa_pod_get_object (route, NULL,
-          "device", "i", &route_device,
-          "available", "?I", &route_avail,
-          NULL))
+      if (!wp_spa_pod_schema_get (self->route_schema, route, NULL,
+          &route_device, &route_avail))
         continue;
 
       if (route_device != cpd)
@@ -215,10 +213,8 @@ node_has_available_routes (WpDefaultNodes * self, WpNode *node)
       guint32 route_avail = SPA_PARAM_AVAILABILITY_unknown;
       g_autoptr (WpSpaPod) route_devices = NULL;
 
-      if (!wp_spa_pod_get_object (route, NULL,
-          "available", "?I", &route_avail,
-          "devices", "?P", &route_devices,
-          NULL))
+      if (!wp_spa_pod_schema_get (self->enum_route_schema, route, NULL,
+          &route_avail, &route_devices))
         continue;
 
       {
@@ -542,6 +538,24 @@ wp_default_nodes_enable (WpPlugin * plugin, WpTransition * transition)
   g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (plugin));
   g_return_if_fail (core);
 
+  self->route_schema = wp_spa_pod_schema_new ("Spa:Pod:Object:Param:Route",
+      "device", "i",
+      "available", "?I",
+      NULL);
+  self->enum_route_schema = wp_spa_pod_schema_new (
+      "Spa:Pod:Object:Param:Route",
+      "available", "?I",
+      "devices", "?P",
+      NULL);
+  if (!self->route_schema || !self->enum_route_schema) {
+    g_clear_pointer (&self->route_schema, wp_spa_pod_schema_unref);
+    g_clear_pointer (&self->enum_route_schema, wp_spa_pod_schema_unref);
+    wp_transition_return_error (transition,
+        g_error_new (WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVARIANT,
+            "failed to create the pod schemas"));
+    return;
+  }
+
   if (self->use_persistent_storage) {
     self->state = wp_state_new (NAME);
     load_state (self);
@@ -582,6 +596,8 @@ wp_default_nodes_disable (WpPlugin * plugin)
   g_clear_object (&self->metadata_om);
   g_clear_object (&self->rescan_om);
   g_clear_object (&self->state);
+  g_clear_pointer (&self->route_schema, wp_spa_pod_schema_unref);
+  g_clear_pointer (&self->enum_route_schema, wp_spa_pod_schema_unref);
 }
 
 static void
@@ -83,10 +83,8 @@ timeout_save_callback (WpDefaultProfile *self)
 {
   WpDefaultProfilePrivate *priv =
       wp_default_profile_get_instance_private (self);
-  g_autoptr (GError) error = NULL;
 
-  if (!wp_state_save (priv->state, priv->profiles, &error))
-    wp_warning_object (self, "%s", error->message);
+  wp_state_save_deferred (priv->state, priv->profiles);
 
   return G_SOURCE_REMOVE;
 }
@@ -20,7 +20,7 @@ void wp_lua_scripting_json_init (lua_State *L);
 
 /* helpers */
 
-static WpCore *
+WpCore *
 get_wp_core (lua_State *L)
 {
   WpCore *core = NULL;
@@ -301,7 +301,7 @@ log_log (lua_State *L, GLogLevelFlags lvl)
   GType type = G_TYPE_INVALID;
   int index = 1;
 
-  if (!wp_log_level_is_enabled (lvl))
+  if (!wp_log_level_is_enabled (lvl) && !wp_log_flight_recorder_is_active ())
     return 0;
 
   g_warn_if_fail (lua_getstack (L, 1, &ar) == 1);
@@ -355,6 +355,31 @@ static const luaL_Reg log_funcs[] = {
   { NULL, NULL }
 };
 
+/* Debug */
+
+static int
+debug_gc_stats (lua_State *L)
+{
+  WpLuaGcStats stats;
+  wplua_get_gc_stats (L, &stats);
+
+  lua_newtable (L);
+  lua_pushinteger (L, stats.heap_size);
+  lua_setfield (L, -2, "heap_size");
+  lua_pushinteger (L, stats.n_steps);
+  lua_setfield (L, -2, "steps");
+  lua_pushinteger (L, stats.n_cycles);
+  lua_setfield (L, -2, "cycles");
+  lua_pushinteger (L, stats.time_usec);
+  lua_setfield (L, -2, "time_usec");
+  return 1;
+}
+
+static const luaL_Reg debug_funcs[] = {
+  { "gc_stats", debug_gc_stats },
+  { NULL, NULL }
+};
+
 /* WpPlugin */
 
 static int
@@ -815,8 +840,23 @@ object_manager_lookup (lua_State *L)
   return 0;
 }
 
+static int
+object_manager_add_index (lua_State *L)
+{
+  static const gchar *const types[] = { "pw-global", "pw", NULL };
+  WpObjectManager *om = wplua_checkobject (L, 1, WP_TYPE_OBJECT_MANAGER);
+  const gchar *subject = luaL_checkstring (L, 2);
+  int type = luaL_checkoption (L, 3, "pw-global", types);
+
+  wp_object_manager_add_index (om, (type == 0) ?
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY : WP_CONSTRAINT_TYPE_PW_PROPERTY,
+      subject);
+  return 0;
+}
+
 static const luaL_Reg object_manager_methods[] = {
   { "activate", object_manager_activate },
+  { "add_index", object_manager_add_index },
   { "get_n_objects", object_manager_get_n_objects },
   { "iterate", object_manager_iterate },
   { "lookup", object_manager_lookup },
@@ -1067,6 +1107,16 @@ node_send_command (lua_State *L)
   return 0;
 }
 
+static int
+node_has_common_format (lua_State *L)
+{
+  WpNode *node = wplua_checkobject (L, 1, WP_TYPE_NODE);
+  WpNode *other = wplua_checkobject (L, 2, WP_TYPE_NODE);
+  gboolean encoded_only = lua_toboolean (L, 3);
+  lua_pushboolean (L, wp_node_has_common_format (node, other, encoded_only));
+  return 1;
+}
+
 static const luaL_Reg node_methods[] = {
   { "get_state", node_get_state },
   { "get_n_input_ports", node_get_n_input_ports },
@@ -1075,6 +1125,7 @@ static const luaL_Reg node_methods[] = {
   { "iterate_ports", node_iterate_ports },
   { "lookup_port", node_lookup_port },
   { "send_command", node_send_command },
+  { "has_common_format", node_has_common_format },
   { NULL, NULL }
 };
 
@@ -1399,9 +1450,27 @@ pipewire_object_set_param (lua_State *L)
   return 0;
 }
 
+static int
+pipewire_object_get_params_stats (lua_State *L)
+{
+  WpPipewireObject *pwobj = wplua_checkobject (L, 1, WP_TYPE_PIPEWIRE_OBJECT);
+  WpPipewireObjectParamsStats stats;
+
+  wp_pipewire_object_get_params_stats (pwobj, &stats);
+  lua_createtable (L, 0, 3);
+  lua_pushinteger (L, stats.n_ids);
+  lua_setfield (L, -2, "n_ids");
+  lua_pushinteger (L, stats.n_params);
+  lua_setfield (L, -2, "n_params");
+  lua_pushinteger (L, stats.size);
+  lua_setfield (L, -2, "size");
+  return 1;
+}
+
 static const luaL_Reg pipewire_object_methods[] = {
   { "iterate_params", pipewire_object_iterate_params },
   { "set_param" , pipewire_object_set_param },
+  { "get_params_stats", pipewire_object_get_params_stats },
   { "set_params" , pipewire_object_set_param }, /* deprecated, compat only */
   { NULL, NULL }
 };
@@ -1438,6 +1507,16 @@ state_save (lua_State *L)
   return 2;
 }
 
+static int
+state_save_deferred (lua_State *L)
+{
+  WpState *state = wplua_checkobject (L, 1, WP_TYPE_STATE);
+  luaL_checktype (L, 2, LUA_TTABLE);
+  g_autoptr (WpProperties) props = wplua_table_to_properties (L, 2);
+  wp_state_save_deferred (state, props);
+  return 0;
+}
+
 static int
 state_load (lua_State *L)
 {
@@ -1450,6 +1529,7 @@ state_load (lua_State *L)
 static const luaL_Reg state_methods[] = {
   { "clear", state_clear },
   { "save" , state_save },
+  { "save_deferred" , state_save_deferred },
   { "load" , state_load },
   { NULL, NULL }
 };
@@ -1515,6 +1595,9 @@ wp_lua_scripting_api_init (lua_State *L)
   luaL_newlib (L, plugin_funcs);
   lua_setglobal (L, "WpPlugin");
 
+  luaL_newlib (L, debug_funcs);
+  lua_setglobal (L, "WpDebug");
+
   wp_lua_scripting_pod_init (L);
   wp_lua_scripting_json_init (L);
 
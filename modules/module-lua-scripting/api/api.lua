@@ -138,6 +138,7 @@ end
 
 local Debug = {
   dump_table = dump_table,
+  gc_stats = WpDebug.gc_stats,
 }
 
 local Id = {
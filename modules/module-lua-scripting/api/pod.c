@@ -13,8 +13,36 @@
 
 #define MAX_LUA_TYPES 9
 
+/* more than the number of properties of any spa object type; the schema
+ * arrays are kept on the stack and the parsed values on the lua stack */
+#define MAX_SCHEMA_FIELDS 64
+
+WpCore * get_wp_core (lua_State *L);
+
 /* Builder */
 
+/* Container pods are built in the scratch memory of the core, so that the
+ * builder does not grow on the heap step by step. Lua releases pods only when
+ * they are collected, which with the incremental GC may happen many callbacks
+ * later, and each pod left in the scratch memory would pin its chunk until
+ * then, so the pod that lua gets is copied out with its exact size
+ * (see push_built_pod) and the scratch space is given back as soon as the
+ * constructor returns */
+static void
+builder_use_scratch (lua_State *L, WpSpaPodBuilder *b)
+{
+  WpCore *core = get_wp_core (L);
+  if (core)
+    wp_spa_pod_builder_use_scratch (b, core);
+}
+
+static void
+push_built_pod (lua_State *L, WpSpaPodBuilder *b)
+{
+  g_autoptr (WpSpaPod) pod = wp_spa_pod_builder_end (b);
+  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_copy (pod));
+}
+
 typedef gboolean (*primitive_lua_add_func) (WpSpaPodBuilder *, WpSpaIdValue,
     lua_State *, int);
 
@@ -667,6 +695,7 @@ spa_pod_object_new (lua_State *L)
   builder = wp_spa_pod_builder_new_object (fields[0], fields[1]);
   if (!builder)
     luaL_error (L, "Could not create pod object");
+  builder_use_scratch (L, builder);
 
   lua_pop (L, 2);
 
@@ -682,7 +711,7 @@ spa_pod_object_new (lua_State *L)
     lua_pop (L, 1);
   }
 
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -696,6 +725,7 @@ spa_pod_struct_new (lua_State *L)
   luaL_checktype (L, 1, LUA_TTABLE);
 
   builder = wp_spa_pod_builder_new_struct ();
+  builder_use_scratch (L, builder);
 
   lua_pushnil (L);
   while (lua_next (L, 1)) {
@@ -725,7 +755,7 @@ spa_pod_struct_new (lua_State *L)
     lua_pop (L, 1);
   }
 
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -739,6 +769,7 @@ spa_pod_sequence_new (lua_State *L)
   luaL_checktype (L, 1, LUA_TTABLE);
 
   builder = wp_spa_pod_builder_new_sequence (0);
+  builder_use_scratch (L, builder);
 
   lua_pushnil (L);
   while (lua_next (L, -2)) {
@@ -795,7 +826,7 @@ spa_pod_sequence_new (lua_State *L)
     lua_pop(L, 1);
   }
 
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -805,8 +836,9 @@ static int
 spa_pod_array_new (lua_State *L)
 {
   g_autoptr (WpSpaPodBuilder) builder = wp_spa_pod_builder_new_array ();
+  builder_use_scratch (L, builder);
   builder_add_table (L, builder);
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -816,8 +848,9 @@ static int
 spa_pod_choice_none_new (lua_State *L)
 {
   g_autoptr (WpSpaPodBuilder) builder = wp_spa_pod_builder_new_choice ("None");
+  builder_use_scratch (L, builder);
   builder_add_table (L, builder);
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -825,8 +858,9 @@ static int
 spa_pod_choice_range_new (lua_State *L)
 {
   g_autoptr (WpSpaPodBuilder) builder = wp_spa_pod_builder_new_choice ("Range");
+  builder_use_scratch (L, builder);
   builder_add_table (L, builder);
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -834,8 +868,9 @@ static int
 spa_pod_choice_step_new (lua_State *L)
 {
   g_autoptr (WpSpaPodBuilder) builder = wp_spa_pod_builder_new_choice ("Step");
+  builder_use_scratch (L, builder);
   builder_add_table (L, builder);
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -843,8 +878,9 @@ static int
 spa_pod_choice_enum_new (lua_State *L)
 {
   g_autoptr (WpSpaPodBuilder) builder = wp_spa_pod_builder_new_choice ("Enum");
+  builder_use_scratch (L, builder);
   builder_add_table (L, builder);
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -852,8 +888,9 @@ static int
 spa_pod_choice_flags_new (lua_State *L)
 {
   g_autoptr (WpSpaPodBuilder) builder = wp_spa_pod_builder_new_choice ("Flags");
+  builder_use_scratch (L, builder);
   builder_add_table (L, builder);
-  wplua_pushboxed (L, WP_TYPE_SPA_POD, wp_spa_pod_builder_end (builder));
+  push_built_pod (L, builder);
   return 1;
 }
 
@@ -1182,6 +1219,102 @@ spa_pod_filter (lua_State *L)
   return 0;
 }
 
+/* Schema */
+
+static int
+spa_pod_schema_new (lua_State *L)
+{
+  const gchar *type_name = luaL_checkstring (L, 1);
+  luaL_checktype (L, 2, LUA_TTABLE);
+  lua_Integer n_fields = luaL_len (L, 2);
+  const gchar *keys[MAX_SCHEMA_FIELDS];
+  const gchar *formats[MAX_SCHEMA_FIELDS];
+  WpSpaPodSchema *schema;
+
+  luaL_argcheck (L, n_fields <= MAX_SCHEMA_FIELDS, 2,
+      "too many property names");
+
+  /* the key strings stay referenced by the table while the schema is built */
+  for (lua_Integer i = 0; i < n_fields; i++) {
+    lua_rawgeti (L, 2, i + 1);
+    luaL_argcheck (L, lua_type (L, -1) == LUA_TSTRING, 2,
+        "expected a list of property names");
+    keys[i] = lua_tostring (L, -1);
+    formats[i] = "?P";
+    lua_pop (L, 1);
+  }
+
+  schema = wp_spa_pod_schema_new_with_fields (type_name, n_fields, keys,
+      formats);
+  if (!schema)
+    luaL_error (L, "Invalid pod schema for '%s'", type_name);
+
+  wplua_pushboxed (L, WP_TYPE_SPA_POD_SCHEMA, schema);
+  return 1;
+}
+
+struct schema_parse_data
+{
+  WpSpaPodSchema *schema;
+  const gchar *id_name;
+  WpSpaPod **values;
+  guint n_fields;
+};
+
+/* converts the parsed values; this runs in protected mode, so that the values
+   can be released by the caller even if converting them raises an error */
+static int
+spa_pod_schema_push_values (lua_State *L)
+{
+  struct schema_parse_data *d = lua_touserdata (L, 1);
+
+  lua_pop (L, 1);
+  luaL_checkstack (L, d->n_fields + 1, NULL);
+  lua_pushstring (L, d->id_name);
+  for (guint i = 0; i < d->n_fields; i++) {
+    if (d->values[i])
+      push_luapod (L, d->values[i], wp_spa_pod_schema_get_field (d->schema, i));
+    else
+      lua_pushnil (L);
+  }
+  return d->n_fields + 1;
+}
+
+static int
+spa_pod_schema_parse (lua_State *L)
+{
+  WpSpaPodSchema *schema = wplua_checkboxed (L, 1, WP_TYPE_SPA_POD_SCHEMA);
+  WpSpaPod *pod = wplua_checkboxed (L, 2, WP_TYPE_SPA_POD);
+  guint n_fields = wp_spa_pod_schema_get_n_fields (schema);
+  WpSpaPod *values[MAX_SCHEMA_FIELDS];
+  struct schema_parse_data d = { schema, NULL, values, n_fields };
+  int res;
+
+  luaL_argcheck (L, n_fields <= MAX_SCHEMA_FIELDS, 1,
+      "too many fields in the schema");
+
+  if (!wp_spa_pod_schema_get_pods (schema, pod, &d.id_name, values))
+    return 0;
+
+  /* pushing a C function without upvalues and a light userdata does not
+     allocate, so nothing can fail before the values are handed over */
+  lua_pushcfunction (L, spa_pod_schema_push_values);
+  lua_pushlightuserdata (L, &d);
+  res = lua_pcall (L, 1, n_fields + 1, 0);
+
+  for (guint i = 0; i < n_fields; i++)
+    g_clear_pointer (&values[i], wp_spa_pod_unref);
+
+  if (res != LUA_OK)
+    return lua_error (L);
+  return n_fields + 1;
+}
+
+static const luaL_Reg spa_pod_schema_methods[] = {
+  { "parse", spa_pod_schema_parse },
+  { NULL, NULL }
+};
+
 static const luaL_Reg spa_pod_methods[] = {
   { "get_type_name", spa_pod_get_type_name },
   { "parse", spa_pod_parse },
@@ -1208,6 +1341,7 @@ static const luaL_Reg spa_pod_constructors[] = {
   { "Struct", spa_pod_struct_new },
   { "Sequence", spa_pod_sequence_new },
   { "Array", spa_pod_array_new },
+  { "Schema", spa_pod_schema_new },
   { NULL, NULL }
 };
 
@@ -1231,4 +1365,6 @@ wp_lua_scripting_pod_init (lua_State *L)
   lua_setglobal (L, "WpSpaPod");
 
   wplua_register_type_methods (L, WP_TYPE_SPA_POD, NULL, spa_pod_methods);
+  wplua_register_type_methods (L, WP_TYPE_SPA_POD_SCHEMA, NULL,
+      spa_pod_schema_methods);
 }
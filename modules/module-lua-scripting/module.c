@@ -82,6 +82,35 @@ wp_lua_scripting_enable_package_searcher (lua_State *L)
   lua_call (L, 3, 0);
 }
 
+static void
+wp_lua_scripting_configure_gc (lua_State *L, WpCore * core)
+{
+  g_autoptr (WpProperties) p = wp_core_get_properties (core);
+  WpLuaGcPolicy policy = { .mode = WP_LUA_GC_MODE_INCREMENTAL };
+  const gchar *str;
+
+  str = wp_properties_get (p, "wireplumber.lua-gc.mode");
+  if (!g_strcmp0 (str, "generational"))
+    policy.mode = WP_LUA_GC_MODE_GENERATIONAL;
+  else if (!g_strcmp0 (str, "full"))
+    policy.mode = WP_LUA_GC_MODE_FULL;
+  else if (str && g_strcmp0 (str, "incremental") != 0)
+    wp_warning ("unknown wireplumber.lua-gc.mode '%s'; using incremental", str);
+
+  if ((str = wp_properties_get (p, "wireplumber.lua-gc.pause")))
+    policy.pause = atoi (str);
+  if ((str = wp_properties_get (p, "wireplumber.lua-gc.step-multiplier")))
+    policy.step_multiplier = atoi (str);
+  if ((str = wp_properties_get (p, "wireplumber.lua-gc.minor-multiplier")))
+    policy.minor_multiplier = atoi (str);
+  if ((str = wp_properties_get (p, "wireplumber.lua-gc.major-multiplier")))
+    policy.major_multiplier = atoi (str);
+  if ((str = wp_properties_get (p, "wireplumber.lua-gc.step-budget-usec")))
+    policy.step_budget_usec = g_ascii_strtoll (str, NULL, 10);
+
+  wplua_set_gc_policy (L, &policy);
+}
+
 G_DECLARE_FINAL_TYPE (WpLuaScriptingPlugin, wp_lua_scripting_plugin,
                       WP, LUA_SCRIPTING_PLUGIN, WpComponentLoader)
 G_DEFINE_TYPE (WpLuaScriptingPlugin, wp_lua_scripting_plugin,
@@ -112,6 +141,7 @@ wp_lua_scripting_plugin_enable (WpPlugin * plugin, WpTransition * transition)
 
   /* init lua engine */
   self->L = wplua_new ();
+  wp_lua_scripting_configure_gc (self->L, core);
 
   lua_pushliteral (self->L, "wireplumber_core");
   lua_pushlightuserdata (self->L, core);
@@ -100,10 +100,13 @@ _wplua_closure_marshal (GClosure *closure, GValue *return_value,
     lua_pop (L, 1);
   }
 
-  /* clean up */
-  lua_gc (L, LUA_GCCOLLECT, 0);
-  if (reentrant == 0)
+  /* clean up; collection is deferred, according to the gc policy,
+     so that the GObject refs held by garbage userdata are released soon
+     without paying for a full collection on every single callback */
+  if (reentrant == 0) {
     lua_gc (L, LUA_GCRESTART, 0);
+    _wplua_gc_schedule (L);
+  }
 }
 
 static void
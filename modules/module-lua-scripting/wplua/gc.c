@@ -0,0 +1,221 @@
+/* WirePlumber
+ *
+ * Copyright © 2023 The WirePlumber project contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "wplua.h"
+#include "private.h"
+#include <wp/wp.h>
+
+#define DEFAULT_STEP_BUDGET_USEC 1000
+
+/* This structure is added to a lua global and it's only referenced from there,
+   just like the closure store; when the lua_State closes, its finalize
+   function destroys any pending collection source */
+typedef struct _WpLuaGc WpLuaGc;
+struct _WpLuaGc
+{
+  lua_State *L;
+  WpLuaGcPolicy policy;
+  GSource *source;
+  gboolean clean_cycle;
+  WpLuaGcStats stats;
+};
+
+static WpLuaGc *
+_wplua_gc_new (lua_State *L)
+{
+  WpLuaGc *self = g_rc_box_new0 (WpLuaGc);
+  self->L = L;
+  self->policy.mode = WP_LUA_GC_MODE_INCREMENTAL;
+  self->policy.step_budget_usec = DEFAULT_STEP_BUDGET_USEC;
+  return self;
+}
+
+static void
+_wplua_gc_finalize (WpLuaGc * self)
+{
+  if (self->source)
+    g_source_destroy (self->source);
+  g_clear_pointer (&self->source, g_source_unref);
+}
+
+static WpLuaGc *
+_wplua_gc_ref (WpLuaGc * self)
+{
+  return g_rc_box_acquire (self);
+}
+
+static void
+_wplua_gc_unref (WpLuaGc * self)
+{
+  g_rc_box_release_full (self, (GDestroyNotify) _wplua_gc_finalize);
+}
+
+G_DEFINE_BOXED_TYPE(WpLuaGc, _wplua_gc, _wplua_gc_ref, _wplua_gc_unref)
+
+static WpLuaGc *
+_wplua_gc_get (lua_State *L)
+{
+  WpLuaGc *self;
+  lua_pushliteral (L, "wplua_gc");
+  lua_gettable (L, LUA_REGISTRYINDEX);
+  self = wplua_toboxed (L, -1);
+  lua_pop (L, 1);
+  return self;
+}
+
+static gboolean
+_wplua_gc_idle (WpLuaGc * self)
+{
+  lua_State *L = self->L;
+  gint64 start = g_get_monotonic_time ();
+  gint64 now;
+  gboolean finished = FALSE;
+
+  /* in generational mode, a single step is a full minor collection,
+     which is what we need to release the young garbage of the callbacks */
+  if (self->policy.mode == WP_LUA_GC_MODE_GENERATIONAL) {
+    lua_gc (L, LUA_GCSTEP, 0);
+    self->stats.n_steps++;
+    finished = TRUE;
+    now = g_get_monotonic_time ();
+    goto out;
+  }
+
+  /* run incremental steps until a cycle that started after the last callback
+     completes, or until we run out of time for this main loop iteration;
+     the cycle that was in progress when the callback ran may have already
+     marked the objects that became garbage during the callback */
+  do {
+    if (lua_gc (L, LUA_GCSTEP, 0)) {
+      self->stats.n_cycles++;
+      if (self->clean_cycle)
+        finished = TRUE;
+      self->clean_cycle = TRUE;
+    }
+    self->stats.n_steps++;
+    now = g_get_monotonic_time ();
+  } while (!finished && now - start < self->policy.step_budget_usec);
+
+out:
+  self->stats.time_usec += now - start;
+
+  if (finished) {
+    g_clear_pointer (&self->source, g_source_unref);
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+/* the context of the core that the lua_State belongs to, which is set by
+   the lua-scripting module; plain states use the thread-default context */
+static GMainContext *
+_wplua_gc_get_context (lua_State *L)
+{
+  WpCore *core;
+  lua_pushliteral (L, "wireplumber_core");
+  lua_gettable (L, LUA_REGISTRYINDEX);
+  core = lua_touserdata (L, -1);
+  lua_pop (L, 1);
+
+  return core ? wp_core_get_g_main_context (core) :
+      g_main_context_get_thread_default ();
+}
+
+void
+_wplua_gc_schedule (lua_State *L)
+{
+  WpLuaGc *self = _wplua_gc_get (L);
+
+  if (self->policy.mode == WP_LUA_GC_MODE_FULL) {
+    gint64 start = g_get_monotonic_time ();
+    lua_gc (L, LUA_GCCOLLECT, 0);
+    self->stats.n_cycles++;
+    self->stats.time_usec += g_get_monotonic_time () - start;
+    return;
+  }
+
+  /* collect on idle, so that callbacks that fire in bursts
+     (ex. params-changed during hotplug) share a single collection cycle */
+  self->clean_cycle = FALSE;
+  if (!self->source) {
+    self->source = g_idle_source_new ();
+    g_source_set_priority (self->source, G_PRIORITY_LOW);
+    g_source_set_callback (self->source, (GSourceFunc) _wplua_gc_idle,
+        self, NULL);
+    g_source_attach (self->source, _wplua_gc_get_context (L));
+  }
+}
+
+void
+_wplua_init_gc (lua_State *L)
+{
+  lua_pushliteral (L, "wplua_gc");
+  wplua_pushboxed (L, _wplua_gc_get_type (), _wplua_gc_new (L));
+  lua_settable (L, LUA_REGISTRYINDEX);
+}
+
+/**
+ * wplua_set_gc_policy:
+ *
+ * Configures how and when the garbage collector of @em L runs.
+ * Tunables that are set to 0 keep the Lua defaults.
+ */
+void
+wplua_set_gc_policy (lua_State *L, const WpLuaGcPolicy *policy)
+{
+  WpLuaGc *self;
+
+  g_return_if_fail (L != NULL);
+  g_return_if_fail (policy != NULL);
+
+  self = _wplua_gc_get (L);
+  self->policy = *policy;
+  if (self->policy.step_budget_usec <= 0)
+    self->policy.step_budget_usec = DEFAULT_STEP_BUDGET_USEC;
+
+#if LUA_VERSION_NUM >= 504
+  if (policy->mode == WP_LUA_GC_MODE_GENERATIONAL) {
+    lua_gc (L, LUA_GCGEN, policy->minor_multiplier, policy->major_multiplier);
+  } else {
+    lua_gc (L, LUA_GCINC, policy->pause, policy->step_multiplier, 0);
+  }
+#else
+  if (policy->mode == WP_LUA_GC_MODE_GENERATIONAL) {
+    wp_warning ("generational GC requires Lua 5.4; using incremental mode");
+    self->policy.mode = WP_LUA_GC_MODE_INCREMENTAL;
+  }
+  if (policy->pause > 0)
+    lua_gc (L, LUA_GCSETPAUSE, policy->pause);
+  if (policy->step_multiplier > 0)
+    lua_gc (L, LUA_GCSETSTEPMUL, policy->step_multiplier);
+#endif
+
+  wp_debug ("lua_State %p: gc mode %d, pause %d, stepmul %d, minormul %d, "
+      "majormul %d, step budget %" G_GINT64_FORMAT "us", L, self->policy.mode,
+      policy->pause, policy->step_multiplier, policy->minor_multiplier,
+      policy->major_multiplier, self->policy.step_budget_usec);
+}
+
+/**
+ * wplua_get_gc_stats:
+ *
+ * Fills @em stats with the current heap size and the accumulated statistics
+ * of the collections that were run by wplua on @em L
+ */
+void
+wplua_get_gc_stats (lua_State *L, WpLuaGcStats *stats)
+{
+  WpLuaGc *self;
+
+  g_return_if_fail (L != NULL);
+  g_return_if_fail (stats != NULL);
+
+  self = _wplua_gc_get (L);
+  *stats = self->stats;
+  stats->heap_size = (gsize) lua_gc (L, LUA_GCCOUNT, 0) * 1024 +
+      (gsize) lua_gc (L, LUA_GCCOUNTB, 0);
+}
@@ -85,6 +85,147 @@ _wplua_gobject_connect (lua_State *L)
   return 1;
 }
 
+/* Caches the Lua table of the "properties" of objects that replace their
+   WpProperties when they change (or notify about in-place changes), so that
+   scripts that read .properties repeatedly get the same table back instead of
+   a new copy every time. The tables are plain tables, which scripts can
+   modify, as the C functions that convert tables iterate them with lua_next()
+   and would not see through a read-only proxy. Like the closure store, this is
+   only referenced from the lua registry and its finalize function drops all
+   the cached tables */
+typedef struct _WpLuaPropsCache WpLuaPropsCache;
+struct _WpLuaPropsCache
+{
+  lua_State *L;
+  GHashTable *entries;
+};
+
+typedef struct _WpLuaPropsCacheEntry WpLuaPropsCacheEntry;
+struct _WpLuaPropsCacheEntry
+{
+  WpLuaPropsCache *cache;
+  GObject *object;
+  WpProperties *properties;
+  gulong notify_id;
+  int table_ref;
+};
+
+static void
+_wplua_props_cache_entry_invalidate (WpLuaPropsCacheEntry * e)
+{
+  g_clear_pointer (&e->properties, wp_properties_unref);
+  if (e->table_ref != LUA_NOREF && e->cache->L)
+    luaL_unref (e->cache->L, LUA_REGISTRYINDEX, e->table_ref);
+  e->table_ref = LUA_NOREF;
+}
+
+static void
+_wplua_props_cache_object_finalized (gpointer data, GObject * object)
+{
+  WpLuaPropsCache *self = data;
+  WpLuaPropsCacheEntry *e = g_hash_table_lookup (self->entries, object);
+  if (e) {
+    e->object = NULL;
+    g_hash_table_remove (self->entries, object);
+  }
+}
+
+static void
+_wplua_props_cache_entry_free (WpLuaPropsCacheEntry * e)
+{
+  if (e->object) {
+    g_signal_handler_disconnect (e->object, e->notify_id);
+    g_object_weak_unref (e->object, _wplua_props_cache_object_finalized,
+        e->cache);
+  }
+  _wplua_props_cache_entry_invalidate (e);
+  g_slice_free (WpLuaPropsCacheEntry, e);
+}
+
+static WpLuaPropsCache *
+_wplua_props_cache_new (lua_State *L)
+{
+  WpLuaPropsCache *self = g_rc_box_new0 (WpLuaPropsCache);
+  self->L = L;
+  self->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) _wplua_props_cache_entry_free);
+  return self;
+}
+
+static void
+_wplua_props_cache_finalize (WpLuaPropsCache * self)
+{
+  /* the lua_State is closing, the registry references go away with it */
+  self->L = NULL;
+  g_clear_pointer (&self->entries, g_hash_table_unref);
+}
+
+static WpLuaPropsCache *
+_wplua_props_cache_ref (WpLuaPropsCache * self)
+{
+  return g_rc_box_acquire (self);
+}
+
+static void
+_wplua_props_cache_unref (WpLuaPropsCache * self)
+{
+  g_rc_box_release_full (self, (GDestroyNotify) _wplua_props_cache_finalize);
+}
+
+G_DEFINE_BOXED_TYPE(WpLuaPropsCache, _wplua_props_cache,
+                    _wplua_props_cache_ref, _wplua_props_cache_unref)
+
+static WpLuaPropsCache *
+_wplua_props_cache_get (lua_State *L)
+{
+  WpLuaPropsCache *self;
+  lua_pushliteral (L, "wplua_props_cache");
+  lua_gettable (L, LUA_REGISTRYINDEX);
+  self = wplua_toboxed (L, -1);
+  lua_pop (L, 1);
+  return self;
+}
+
+static int
+_wplua_gobject_push_properties (lua_State *L, GObject *obj)
+{
+  WpLuaPropsCache *self = _wplua_props_cache_get (L);
+  WpLuaPropsCacheEntry *e;
+  g_autoptr (WpProperties) props = NULL;
+
+  g_object_get (obj, "properties", &props, NULL);
+  if (!props) {
+    wplua_properties_to_table (L, NULL);
+    return 1;
+  }
+
+  e = g_hash_table_lookup (self->entries, obj);
+  if (!e) {
+    e = g_slice_new0 (WpLuaPropsCacheEntry);
+    e->cache = self;
+    e->object = obj;
+    e->table_ref = LUA_NOREF;
+    e->notify_id = g_signal_connect_swapped (obj, "notify::properties",
+        G_CALLBACK (_wplua_props_cache_entry_invalidate), e);
+    g_object_weak_ref (obj, _wplua_props_cache_object_finalized, self);
+    g_hash_table_insert (self->entries, obj, e);
+  }
+
+  /* the cached table is valid as long as the object has the same properties;
+     keeping a reference on them ensures that the pointer is not reused */
+  if (e->properties == props && e->table_ref != LUA_NOREF) {
+    lua_rawgeti (L, LUA_REGISTRYINDEX, e->table_ref);
+    return 1;
+  }
+
+  _wplua_props_cache_entry_invalidate (e);
+  wplua_properties_to_table (L, props);
+  lua_pushvalue (L, -1);
+  e->table_ref = luaL_ref (L, LUA_REGISTRYINDEX);
+  e->properties = g_steal_pointer (&props);
+  return 1;
+}
+
 static lua_CFunction
 find_method_in_luaL_Reg (luaL_Reg *reg, const gchar *method)
 {
@@ -98,11 +239,12 @@ find_method_in_luaL_Reg (luaL_Reg *reg, const gchar *method)
   return NULL;
 }
 
-static int
-_wplua_gobject___index (lua_State *L)
+/* resolves what @em key refers to on objects of the type of @em obj and
+   pushes it: the C function of the method, the GParamSpec of the property
+   as a light userdata, or false if there is no such method or property */
+static void
+_wplua_gobject_resolve (lua_State *L, GObject *obj, const gchar *key)
 {
-  GObject *obj = wplua_checkobject (L, 1, G_TYPE_OBJECT);
-  const gchar *key = luaL_checkstring (L, 2);
   lua_CFunction func = NULL;
   GHashTable *vtables;
 
@@ -140,21 +282,67 @@ _wplua_gobject___index (lua_State *L)
 
   if (func) {
     lua_pushcfunction (L, func);
-    return 1;
   }
   else {
     /* search in properties */
     GObjectClass *klass = G_OBJECT_GET_CLASS (obj);
     GParamSpec *pspec = g_object_class_find_property (klass, key);
-    if (pspec && (pspec->flags & G_PARAM_READABLE)) {
-      g_auto (GValue) v = G_VALUE_INIT;
-      g_value_init (&v, pspec->value_type);
-      g_object_get_property (obj, key, &v);
-      return wplua_gvalue_to_lua (L, &v);
+    if (pspec && (pspec->flags & G_PARAM_READABLE))
+      lua_pushlightuserdata (L, pspec);
+    else
+      lua_pushboolean (L, FALSE);
+  }
+}
+
+static int
+_wplua_gobject___index (lua_State *L)
+{
+  GObject *obj = wplua_checkobject (L, 1, G_TYPE_OBJECT);
+  const gchar *key = luaL_checkstring (L, 2);
+  gpointer type = GSIZE_TO_POINTER (G_TYPE_FROM_INSTANCE (obj));
+
+  /* keys are resolved once per type and cached in a table for each type,
+     which is stored in the cache table that is the upvalue of this function;
+     misses are not cached, as scripts may look up arbitrary keys */
+  if (lua_rawgetp (L, lua_upvalueindex (1), type) == LUA_TNIL) {
+    lua_pop (L, 1);
+    lua_newtable (L);
+    lua_pushvalue (L, -1);
+    lua_rawsetp (L, lua_upvalueindex (1), type);
+  }
+
+  lua_pushvalue (L, 2);
+  if (lua_rawget (L, -2) == LUA_TNIL) {
+    lua_pop (L, 1);
+    _wplua_gobject_resolve (L, obj, key);
+    if (lua_toboolean (L, -1)) {
+      lua_pushvalue (L, 2);
+      lua_pushvalue (L, -2);
+      lua_rawset (L, -4);
     }
   }
 
-  return 0;
+  switch (lua_type (L, -1)) {
+  case LUA_TFUNCTION:
+    return 1;
+
+  case LUA_TLIGHTUSERDATA: {
+    GParamSpec *pspec = lua_touserdata (L, -1);
+    g_auto (GValue) v = G_VALUE_INIT;
+
+    if (pspec->value_type == WP_TYPE_PROPERTIES &&
+        !g_strcmp0 (pspec->name, "properties") &&
+        (WP_IS_PIPEWIRE_OBJECT (obj) || WP_IS_SESSION_ITEM (obj)))
+      return _wplua_gobject_push_properties (L, obj);
+
+    g_value_init (&v, pspec->value_type);
+    g_object_get_property (obj, pspec->name, &v);
+    return wplua_gvalue_to_lua (L, &v);
+  }
+
+  default:
+    return 0;
+  }
 }
 
 static int
@@ -204,7 +392,32 @@ _wplua_init_gobject (lua_State *L)
   };
 
   luaL_newmetatable (L, "GObject");
-  luaL_setfuncs (L, gobject_meta, 0);
+  lua_newtable (L);
+  lua_pushliteral (L, "wplua_gobject_cache");
+  lua_pushvalue (L, -2);
+  lua_settable (L, LUA_REGISTRYINDEX);
+  luaL_setfuncs (L, gobject_meta, 1);
+  lua_pop (L, 1);
+
+  lua_pushliteral (L, "wplua_props_cache");
+  wplua_pushboxed (L, _wplua_props_cache_get_type (),
+      _wplua_props_cache_new (L));
+  lua_settable (L, LUA_REGISTRYINDEX);
+}
+
+void
+_wplua_gobject_clear_cache (lua_State *L)
+{
+  lua_pushliteral (L, "wplua_gobject_cache");
+  lua_gettable (L, LUA_REGISTRYINDEX);
+  lua_pushnil (L);
+  while (lua_next (L, -2) != 0) {
+    /* clearing fields while traversing is allowed */
+    lua_pop (L, 1);
+    lua_pushvalue (L, -1);
+    lua_pushnil (L);
+    lua_rawset (L, -4);
+  }
   lua_pop (L, 1);
 }
 
@@ -19,8 +19,13 @@ void _wplua_init_gboxed (lua_State *L);
 /* closure.c */
 void _wplua_init_closure (lua_State *L);
 
+/* gc.c */
+void _wplua_init_gc (lua_State *L);
+void _wplua_gc_schedule (lua_State *L);
+
 /* object.c */
 void _wplua_init_gobject (lua_State *L);
+void _wplua_gobject_clear_cache (lua_State *L);
 
 /* userdata.c */
 GValue * _wplua_pushgvalue_userdata (lua_State * L, GType type);
@@ -244,6 +244,12 @@ wplua_lua_to_gvalue (lua_State *L, int idx, GValue *v)
     /* table -> WpProperties */
     else if (lua_istable (L, idx) && G_VALUE_TYPE (v) == WP_TYPE_PROPERTIES)
       g_value_take_boxed (v, wplua_table_to_properties (L, idx));
+    /* function -> GClosure */
+    else if (lua_isfunction (L, idx) && G_VALUE_TYPE (v) == G_TYPE_CLOSURE) {
+      GClosure *closure = wplua_function_to_closure (L, idx);
+      g_value_set_boxed (v, closure);
+      g_closure_sink (closure);
+    }
     break;
   case G_TYPE_OBJECT:
   case G_TYPE_INTERFACE:
@@ -310,6 +316,15 @@ wplua_gvalue_to_lua (lua_State *L, const GValue *v)
   case G_TYPE_BOXED:
     if (G_VALUE_TYPE (v) == WP_TYPE_PROPERTIES)
       wplua_properties_to_table (L, g_value_get_boxed (v));
+    /* GPtrArray of GObjects -> table (array of objects) */
+    else if (G_VALUE_TYPE (v) == WP_TYPE_OBJECT_ARRAY) {
+      GPtrArray *arr = g_value_get_boxed (v);
+      lua_createtable (L, arr ? arr->len : 0, 0);
+      for (guint i = 0; arr && i < arr->len; i++) {
+        wplua_pushobject (L, g_object_ref (g_ptr_array_index (arr, i)));
+        lua_rawseti (L, -2, i + 1);
+      }
+    }
     else
       wplua_pushboxed (L, G_VALUE_TYPE (v), g_value_dup_boxed (v));
     break;
@@ -93,6 +93,7 @@ wplua_new (void)
   _wplua_init_gboxed (L);
   _wplua_init_gobject (L);
   _wplua_init_closure (L);
+  _wplua_init_gc (L);
 
   {
     GHashTable *t = g_hash_table_new (g_direct_hash, g_direct_equal);
@@ -189,6 +190,9 @@ wplua_register_type_methods (lua_State * L, GType type,
     }
 
     g_hash_table_insert (vtables, GUINT_TO_POINTER (type), (gpointer) methods);
+
+    /* methods that were already resolved may be overridden by these */
+    _wplua_gobject_clear_cache (L);
   }
 
   /* register constructor */
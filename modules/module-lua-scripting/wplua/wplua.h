@@ -47,10 +47,53 @@ typedef enum {
   WP_LUA_SANDBOX_ISOLATE_ENV = 1,
 } WpLuaSandboxFlags;
 
+/**
+ * WpLuaGcMode:
+ *
+ * @brief
+ * @em WP_LUA_GC_MODE_INCREMENTAL: incremental collection, with pending work
+ *   finished on idle after callbacks, within a time budget per iteration
+ * @em WP_LUA_GC_MODE_GENERATIONAL: generational collection (Lua 5.4 only),
+ *   with a minor collection run on idle after callbacks
+ * @em WP_LUA_GC_MODE_FULL: a full collection after every callback;
+ *   this is very expensive and only useful for debugging
+ */
+typedef enum {
+  WP_LUA_GC_MODE_INCREMENTAL,
+  WP_LUA_GC_MODE_GENERATIONAL,
+  WP_LUA_GC_MODE_FULL,
+} WpLuaGcMode;
+
+typedef struct _WpLuaGcPolicy WpLuaGcPolicy;
+struct _WpLuaGcPolicy
+{
+  WpLuaGcMode mode;
+  /* incremental mode tunables; 0 keeps the Lua default */
+  gint pause;
+  gint step_multiplier;
+  /* generational mode tunables; 0 keeps the Lua default */
+  gint minor_multiplier;
+  gint major_multiplier;
+  /* time that can be spent collecting per main loop iteration */
+  gint64 step_budget_usec;
+};
+
+typedef struct _WpLuaGcStats WpLuaGcStats;
+struct _WpLuaGcStats
+{
+  gsize heap_size;
+  guint64 n_steps;
+  guint64 n_cycles;
+  gint64 time_usec;
+};
+
 lua_State * wplua_new (void);
 lua_State * wplua_ref (lua_State *L);
 void wplua_unref (lua_State * L);
 
+void wplua_set_gc_policy (lua_State *L, const WpLuaGcPolicy *policy);
+void wplua_get_gc_stats (lua_State *L, WpLuaGcStats *stats);
+
 void wplua_enable_sandbox (lua_State * L, WpLuaSandboxFlags flags);
 int wplua_push_sandbox (lua_State * L);
 
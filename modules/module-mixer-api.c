@@ -44,6 +44,8 @@ struct _WpMixerApi
   WpObjectManager *om;
   GHashTable *node_infos;
   guint32 seq;
+  WpSpaPodSchema *props_schema;
+  WpSpaPodSchema *route_schema;
 
   /* properties */
   gint scale;
@@ -126,30 +128,24 @@ wp_mixer_api_set_property (GObject * object, guint property_id,
 }
 
 static gboolean
-node_info_fill (struct node_info * info, WpSpaPod * props)
+node_info_fill (WpMixerApi * self, struct node_info * info, WpSpaPod * props)
 {
   g_autoptr (WpSpaPod) channelVolumes = NULL;
   g_autoptr (WpSpaPod) channelMap = NULL;
   g_autoptr (WpSpaPod) monitorVolumes = NULL;
+  gboolean mute = FALSE;
+  /* default values */
+  float svolume = 1.0, base = 1.0, step = 1.0 / 65536.0;
 
-  if (!wp_spa_pod_get_object (props, NULL,
-          "mute", "b", &info->mute,
-          "channelVolumes", "P", &channelVolumes,
-          NULL))
+  if (!wp_spa_pod_schema_get (self->props_schema, props, NULL,
+          &mute, &channelVolumes, &channelMap, &base, &step, &svolume,
+          &monitorVolumes))
     return FALSE;
 
-  /* default values */
-  info->svolume = 1.0;
-  info->base = 1.0;
-  info->step = 1.0 / 65536.0;
-
-  wp_spa_pod_get_object (props, NULL,
-      "channelMap", "?P", &channelMap,
-      "volumeBase", "?f", &info->base,
-      "volumeStep", "?f", &info->step,
-      "volume",     "?f", &info->svolume,
-      "monitorVolumes", "?P", &monitorVolumes,
-      NULL);
+  info->mute = mute;
+  info->svolume = svolume;
+  info->base = base;
+  info->step = step;
 
   info->volume.channels = spa_pod_copy_array (
       wp_spa_pod_get_spa_pod (channelVolumes), SPA_TYPE_Float,
@@ -196,16 +192,13 @@ collect_node_info (WpMixerApi * self, struct node_info *info,
       gint32 r_index = -1, r_device = -1;
       g_autoptr (WpSpaPod) props = NULL;
 
-      if (!wp_spa_pod_get_object (param, NULL,
-              "index", "i", &r_index,
-              "device", "i", &r_device,
-              "props", "P", &props,
-              NULL))
+      if (!wp_spa_pod_schema_get (self->route_schema, param, NULL,
+              &r_index, &r_device, &props))
         continue;
       if (r_device != p_device)
         continue;
 
-      if (props && node_info_fill (info, props)) {
+      if (props && node_info_fill (self, info, props)) {
         info->device_id = wp_proxy_get_bound_id (WP_PROXY (dev));
         info->route_index = r_index;
         info->route_device = r_device;
@@ -223,7 +216,7 @@ collect_node_info (WpMixerApi * self, struct node_info *info,
     it = wp_pipewire_object_enum_params_sync (node, "Props", NULL);
     for (; it && wp_iterator_next (it, &val); g_value_unset (&val)) {
       WpSpaPod *param = g_value_get_boxed (&val);
-      if (node_info_fill (info, param)) {
+      if (node_info_fill (self, info, param)) {
         g_value_unset (&val);
         break;
       }
@@ -325,6 +318,29 @@ wp_mixer_api_enable (WpPlugin * plugin, WpTransition * transition)
   g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (plugin));
   g_return_if_fail (core);
 
+  self->props_schema = wp_spa_pod_schema_new ("Spa:Pod:Object:Param:Props",
+      "mute", "b",
+      "channelVolumes", "P",
+      "channelMap", "?P",
+      "volumeBase", "?f",
+      "volumeStep", "?f",
+      "volume", "?f",
+      "monitorVolumes", "?P",
+      NULL);
+  self->route_schema = wp_spa_pod_schema_new ("Spa:Pod:Object:Param:Route",
+      "index", "i",
+      "device", "i",
+      "props", "P",
+      NULL);
+  if (!self->props_schema || !self->route_schema) {
+    g_clear_pointer (&self->props_schema, wp_spa_pod_schema_unref);
+    g_clear_pointer (&self->route_schema, wp_spa_pod_schema_unref);
+    wp_transition_return_error (transition,
+        g_error_new (WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_INVARIANT,
+            "failed to create the pod schemas"));
+    return;
+  }
+
   self->node_infos = g_hash_table_new_full (g_direct_hash, g_direct_equal,
       NULL, node_info_free);
 
@@ -365,6 +381,8 @@ wp_mixer_api_disable (WpPlugin * plugin)
 
   g_clear_object (&self->om);
   g_clear_pointer (&self->node_infos, g_hash_table_unref);
+  g_clear_pointer (&self->props_schema, wp_spa_pod_schema_unref);
+  g_clear_pointer (&self->route_schema, wp_spa_pod_schema_unref);
 }
 
 static inline gdouble
@@ -474,10 +492,13 @@ wp_mixer_api_set_volume (WpMixerApi * self, guint32 id, GVariant * vvolume)
   }
 
   /* set param */
+  g_autoptr (WpCore) core = wp_object_get_core (WP_OBJECT (self));
   g_autoptr (WpSpaPod) props = NULL;
   g_autoptr (WpSpaPodBuilder) b =
       wp_spa_pod_builder_new_object ("Spa:Pod:Object:Param:Props", "Props");
 
+  wp_spa_pod_builder_use_scratch (b, core);
+
   if (new_volume.channels > 0)
     wp_spa_pod_builder_add (b, "channelVolumes", "a",
         sizeof(float), SPA_TYPE_Float,
@@ -10,11 +10,13 @@
 
 #define DBUS_INTERFACE_NAME "org.freedesktop.impl.portal.PermissionStore"
 #define DBUS_OBJECT_PATH "/org/freedesktop/impl/portal/PermissionStore"
+#define DBUS_ERROR_NOT_FOUND "org.freedesktop.portal.Error.NotFound"
 
 enum
 {
   ACTION_GET_DBUS,
   ACTION_LOOKUP,
+  ACTION_LOOKUP_ASYNC,
   ACTION_SET,
   SIGNAL_CHANGED,
   LAST_SIGNAL
@@ -28,6 +30,13 @@ struct _WpPortalPermissionStorePlugin
 
   WpDbus *dbus;
   guint signal_id;
+
+  /* "table\nid" -> the permissions (a{sas}), or NULL if the entry does not
+     exist; this is kept up to date with the Changed signal, so it is only
+     filled while subscribed to it */
+  GHashTable *cache;
+  /* "table\nid" -> GPtrArray of the GClosures of the lookups in progress */
+  GHashTable *pending;
 };
 
 G_DECLARE_FINAL_TYPE (WpPortalPermissionStorePlugin,
@@ -42,6 +51,69 @@ wp_portal_permissionstore_plugin_get_dbus (WpPortalPermissionStorePlugin *self)
   return self->dbus ? g_object_ref (self->dbus) : NULL;
 }
 
+static inline gchar *
+make_cache_key (const gchar *table, const gchar *id)
+{
+  return g_strconcat (table, "\n", id, NULL);
+}
+
+static void
+maybe_variant_unref (gpointer v)
+{
+  if (v)
+    g_variant_unref (v);
+}
+
+static gboolean
+cache_lookup (WpPortalPermissionStorePlugin *self, const gchar *key,
+    GVariant **permissions)
+{
+  gpointer value = NULL;
+
+  if (!g_hash_table_lookup_extended (self->cache, key, NULL, &value))
+    return FALSE;
+
+  *permissions = value ? g_variant_ref (value) : NULL;
+  return TRUE;
+}
+
+static void
+cache_store (WpPortalPermissionStorePlugin *self, const gchar *key,
+    GVariant *permissions)
+{
+  /* without the Changed signal, the cache cannot be kept up to date */
+  if (self->signal_id == 0)
+    return;
+
+  g_hash_table_replace (self->cache, g_strdup (key),
+      permissions ? g_variant_ref (permissions) : NULL);
+}
+
+/* returns whether the result of a Lookup call can be cached, giving
+   the permissions in @em permissions */
+static gboolean
+parse_lookup_result (WpPortalPermissionStorePlugin *self, GVariant *res,
+    GError *error, GVariant **permissions)
+{
+  g_autoptr (GVariant) data = NULL;
+
+  *permissions = NULL;
+
+  if (error) {
+    g_autofree gchar *remote_error = g_dbus_error_get_remote_error (error);
+
+    /* the entry does not exist (yet); it will be announced with Changed */
+    if (!g_strcmp0 (remote_error, DBUS_ERROR_NOT_FOUND))
+      return TRUE;
+
+    wp_warning_object (self, "Failed to call Lookup: %s", error->message);
+    return FALSE;
+  }
+
+  g_variant_get (res, "(@a{sas}@v)", permissions, &data);
+  return TRUE;
+}
+
 static GVariant *
 wp_portal_permissionstore_plugin_lookup (WpPortalPermissionStorePlugin *self,
     const gchar *table, const gchar *id)
@@ -49,7 +121,11 @@ wp_portal_permissionstore_plugin_lookup (WpPortalPermissionStorePlugin *self,
   g_autoptr (GDBusConnection) conn = NULL;
   g_autoptr (GError) error = NULL;
   g_autoptr (GVariant) res = NULL;
-  GVariant *permissions = NULL, *data = NULL;
+  g_autofree gchar *key = make_cache_key (table, id);
+  GVariant *permissions = NULL;
+
+  if (cache_lookup (self, key, &permissions))
+    return permissions;
 
   conn = wp_dbus_get_connection (self->dbus);
   g_return_val_if_fail (conn, NULL);
@@ -59,15 +135,128 @@ wp_portal_permissionstore_plugin_lookup (WpPortalPermissionStorePlugin *self,
       DBUS_OBJECT_PATH, DBUS_INTERFACE_NAME, "Lookup",
       g_variant_new ("(ss)", table, id), NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
       &error);
-  if (error) {
-    wp_warning_object (self, "Failed to call Lookup: %s", error->message);
-    return NULL;
+
+  if (parse_lookup_result (self, res, error, &permissions))
+    cache_store (self, key, permissions);
+
+  return permissions;
+}
+
+static void
+invoke_lookup_closure (GClosure *closure, GVariant *permissions)
+{
+  GValue value = G_VALUE_INIT;
+
+  g_value_init (&value, G_TYPE_VARIANT);
+  g_value_set_variant (&value, permissions);
+  g_closure_invoke (closure, NULL, 1, &value, NULL);
+  g_value_unset (&value);
+}
+
+typedef struct {
+  WpPortalPermissionStorePlugin *self;
+  gchar *key;
+} LookupData;
+
+static void
+on_lookup_done (GObject * obj, GAsyncResult * res, gpointer user_data)
+{
+  LookupData *data = user_data;
+  WpPortalPermissionStorePlugin *self = data->self;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GVariant) result = NULL;
+  g_autoptr (GVariant) permissions = NULL;
+  g_autoptr (GPtrArray) closures = NULL;
+
+  result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (obj), res, &error);
+  if (parse_lookup_result (self, result, error, &permissions)) {
+    GVariant *newer = NULL;
+
+    /* a Changed signal that arrived while the call was in progress is
+       newer than this reply; keep it and answer with it */
+    if (cache_lookup (self, data->key, &newer)) {
+      g_clear_pointer (&permissions, g_variant_unref);
+      permissions = newer;
+    } else {
+      cache_store (self, data->key, permissions);
+    }
   }
 
-  /* Get the permissions */
-  g_variant_get (res, "(@a{sas}@v)", &permissions, &data);
+  /* answer all the lookups of this entry that were made meanwhile */
+  if (g_hash_table_steal_extended (self->pending, data->key, NULL,
+          (gpointer *) &closures)) {
+    for (guint i = 0; i < closures->len; i++)
+      invoke_lookup_closure (g_ptr_array_index (closures, i), permissions);
+  }
 
-  return permissions ? g_variant_ref (permissions) : NULL;
+  /* the key is owned by the pending table */
+  g_free (data->key);
+  g_object_unref (data->self);
+  g_slice_free (LookupData, data);
+}
+
+static void
+wp_portal_permissionstore_plugin_lookup_async (
+    WpPortalPermissionStorePlugin *self, const gchar *table, const gchar *id,
+    GClosure *closure)
+{
+  g_autoptr (GDBusConnection) conn = NULL;
+  g_autoptr (GVariant) permissions = NULL;
+  g_autofree gchar *key = make_cache_key (table, id);
+  GPtrArray *closures = NULL;
+  LookupData *data = NULL;
+
+  g_return_if_fail (closure);
+
+  g_closure_ref (closure);
+  g_closure_sink (closure);
+
+  /* fast path, without D-Bus */
+  if (cache_lookup (self, key, &permissions)) {
+    invoke_lookup_closure (closure, permissions);
+    g_closure_unref (closure);
+    return;
+  }
+
+  /* a lookup of the same entry is in progress, wait for it */
+  closures = g_hash_table_lookup (self->pending, key);
+  if (closures) {
+    g_ptr_array_add (closures, closure);
+    return;
+  }
+
+  conn = wp_dbus_get_connection (self->dbus);
+  if (!conn) {
+    wp_warning_object (self, "Failed to call Lookup: not connected");
+    invoke_lookup_closure (closure, NULL);
+    g_closure_unref (closure);
+    return;
+  }
+
+  closures = g_ptr_array_new_with_free_func ((GDestroyNotify) g_closure_unref);
+  g_ptr_array_add (closures, closure);
+  g_hash_table_insert (self->pending, g_strdup (key), closures);
+
+  data = g_slice_new0 (LookupData);
+  data->self = g_object_ref (self);
+  data->key = g_steal_pointer (&key);
+
+  g_dbus_connection_call (conn, DBUS_INTERFACE_NAME,
+      DBUS_OBJECT_PATH, DBUS_INTERFACE_NAME, "Lookup",
+      g_variant_new ("(ss)", table, id), NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+      on_lookup_done, data);
+}
+
+static void
+on_set_done (GObject * obj, GAsyncResult * res, gpointer user_data)
+{
+  g_autoptr (WpPortalPermissionStorePlugin) self = user_data;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GVariant) result = NULL;
+
+  result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (obj), res, &error);
+  if (error)
+    wp_warning_object (self, "Failed to call Set: %s", error->message);
 }
 
 static void
@@ -75,20 +264,22 @@ wp_portal_permissionstore_plugin_set (WpPortalPermissionStorePlugin *self,
     const gchar *table, gboolean create, const gchar *id, GVariant *permissions)
 {
   g_autoptr (GDBusConnection) conn = NULL;
-  g_autoptr (GError) error = NULL;
-  g_autoptr (GVariant) res = NULL;
-  GVariant *data = NULL;
+  g_autofree gchar *key = make_cache_key (table, id);
 
   conn = wp_dbus_get_connection (self->dbus);
   g_return_if_fail (conn);
 
+  /* the new permissions are cached when the store announces them
+     with the Changed signal */
+  g_hash_table_remove (self->cache, key);
+
   /* Set */
-  res = g_dbus_connection_call_sync (conn, DBUS_INTERFACE_NAME,
+  g_dbus_connection_call (conn, DBUS_INTERFACE_NAME,
       DBUS_OBJECT_PATH, DBUS_INTERFACE_NAME, "Set",
-      g_variant_new ("(sbs@a{sas}@v)", table, id, permissions, data), NULL,
-      G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
-  if (error)
-    wp_warning_object (self, "Failed to call Set: %s", error->message);
+      g_variant_new ("(sbs@a{sas}v)", table, create, id, permissions,
+          g_variant_new_byte (0)),
+      NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, on_set_done,
+      g_object_ref (self));
 }
 
 static void
@@ -101,12 +292,17 @@ wp_portal_permissionstore_plugin_changed (GDBusConnection *connection,
       WP_PORTAL_PERMISSIONSTORE_PLUGIN (user_data);
   const char *table = NULL, *id = NULL;
   gboolean deleted = FALSE;
-  GVariant *permissions = NULL, *data = NULL;
+  g_autoptr (GVariant) permissions = NULL;
+  g_autoptr (GVariant) data = NULL;
+  g_autofree gchar *key = NULL;
 
   g_return_if_fail (parameters);
-  g_variant_get (parameters, "(ssb@v@a{sas})", &table, &id, &deleted, &data,
+  g_variant_get (parameters, "(&s&sb@v@a{sas})", &table, &id, &deleted, &data,
       &permissions);
 
+  key = make_cache_key (table, id);
+  cache_store (self, key, deleted ? NULL : permissions);
+
   g_signal_emit (self, signals[SIGNAL_CHANGED], 0, table, id, deleted,
       permissions);
 }
@@ -121,6 +317,9 @@ clear_signal (WpPortalPermissionStorePlugin *self)
     g_dbus_connection_signal_unsubscribe (conn, self->signal_id);
     self->signal_id = 0;
   }
+
+  /* without the signal, the cache can get out of date */
+  g_hash_table_remove_all (self->cache);
 }
 
 static void
@@ -156,6 +355,10 @@ on_dbus_state_changed (GObject * obj, GParamSpec * spec,
 static void
 wp_portal_permissionstore_plugin_init (WpPortalPermissionStorePlugin * self)
 {
+  self->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      maybe_variant_unref);
+  self->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_ptr_array_unref);
 }
 
 static void
@@ -180,6 +383,8 @@ wp_portal_permissionstore_plugin_finalize (GObject * object)
       WP_PORTAL_PERMISSIONSTORE_PLUGIN (object);
 
   g_clear_object (&self->dbus);
+  g_clear_pointer (&self->cache, g_hash_table_unref);
+  g_clear_pointer (&self->pending, g_hash_table_unref);
 
   G_OBJECT_CLASS (wp_portal_permissionstore_plugin_parent_class)->finalize (
       object);
@@ -266,6 +471,25 @@ wp_portal_permissionstore_plugin_class_init (
       NULL, NULL, NULL, G_TYPE_VARIANT,
       2, G_TYPE_STRING, G_TYPE_STRING);
 
+  /**
+   * WpPortalPermissionStorePlugin::lookup-async:
+   *
+   * @brief
+   * @em table: the table name
+   * @em id: the Id name
+   * @em callback: a closure that is called with the GVariant with the
+   *   permissions, or NULL if they could not be found
+   *
+   * Looks up the permissions without blocking. If the permissions are known
+   * already, @em callback is called before this returns.
+   */
+  signals[ACTION_LOOKUP_ASYNC] = g_signal_new_class_handler (
+      "lookup-async", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      (GCallback) wp_portal_permissionstore_plugin_lookup_async,
+      NULL, NULL, NULL, G_TYPE_NONE,
+      3, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_CLOSURE);
+
   /**
    * WpPortalPermissionStorePlugin::set:
    *
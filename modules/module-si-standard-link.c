@@ -26,11 +26,20 @@ struct _WpSiStandardLink
 
   /* activate */
   GPtrArray *node_links;
-  guint n_active_links;
-  guint n_failed_links;
+  struct link_batch *link_batch;
   guint n_async_ops_wait;
 };
 
+/* tracks the activation of all the pw links of one create_links() call */
+struct link_batch
+{
+  WpTransition *transition;
+  guint n_links;
+  guint n_pending;
+  guint n_failed;
+  gint64 start_time;
+};
+
 enum {
   SIGNAL_LINK_ERROR,
   LAST_SIGNAL,
@@ -142,6 +151,27 @@ request_destroy_link (gpointer data, gpointer user_data)
   wp_global_proxy_request_destroy (WP_GLOBAL_PROXY (link));
 }
 
+static void
+link_batch_clear (struct link_batch *batch)
+{
+  g_clear_object (&batch->transition);
+}
+
+static struct link_batch *
+link_batch_new (WpTransition *transition)
+{
+  struct link_batch *batch = g_rc_box_new0 (struct link_batch);
+  batch->transition = g_object_ref (transition);
+  batch->start_time = g_get_monotonic_time ();
+  return batch;
+}
+
+static void
+link_batch_unref (struct link_batch *batch)
+{
+  g_rc_box_release_full (batch, (GDestroyNotify) link_batch_clear);
+}
+
 static void
 clear_node_links (GPtrArray **node_links_p)
 {
@@ -178,43 +208,66 @@ si_standard_link_disable_active (WpSessionItem *si)
   }
 
   clear_node_links (&self->node_links);
+  g_clear_pointer (&self->link_batch, link_batch_unref);
 
-  self->n_active_links = 0;
-  self->n_failed_links = 0;
   self->n_async_ops_wait = 0;
 
   wp_object_update_features (WP_OBJECT (self), 0,
       WP_SESSION_ITEM_FEATURE_ACTIVE);
 }
 
+static void
+record_link_setup_stats (WpSiStandardLink * self, struct link_batch * batch)
+{
+  gint64 elapsed = g_get_monotonic_time () - batch->start_time;
+  g_autoptr (WpProperties) props =
+      wp_session_item_get_properties (WP_SESSION_ITEM (self));
+
+  wp_debug_object (self, "%u of %u pw links activated in %" G_GINT64_FORMAT
+      " us", batch->n_links - batch->n_failed, batch->n_links, elapsed);
+
+  props = wp_properties_ensure_unique_owner (g_steal_pointer (&props));
+  wp_properties_setf (props, "link.setup.n-links", "%u", batch->n_links);
+  wp_properties_setf (props, "link.setup.time-us", "%" G_GINT64_FORMAT,
+      elapsed);
+  wp_session_item_set_properties (WP_SESSION_ITEM (self),
+      g_steal_pointer (&props));
+}
+
 static void
 on_link_activated (WpObject * proxy, GAsyncResult * res,
-    WpTransition * transition)
+    struct link_batch * batch)
 {
+  WpTransition *transition = batch->transition;
   WpSiStandardLink *self = wp_transition_get_source_object (transition);
-  guint len = self->node_links ? self->node_links->len : 0;
 
-  /* Count the number of failed and active links */
-  if (wp_object_activate_finish (proxy, res, NULL))
-    self->n_active_links++;
-  else
-    self->n_failed_links++;
+  /* Count the number of failed links */
+  if (!wp_object_activate_finish (proxy, res, NULL))
+    batch->n_failed++;
 
-  /* Wait for all links to finish activation */
-  if (self->n_failed_links + self->n_active_links != len)
+  /* Wait for all links to finish activation; ignore links of batches that
+     have been cleared in the meantime */
+  if (--batch->n_pending > 0 || self->link_batch != batch) {
+    link_batch_unref (batch);
     return;
+  }
+
+  record_link_setup_stats (self, batch);
 
   /* We only active feature if all links activated successfully */
-  if (self->n_failed_links > 0) {
+  if (batch->n_failed > 0) {
     clear_node_links (&self->node_links);
     wp_transition_return_error (transition, g_error_new (
         WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
         "%d of %d PipeWire links failed to activate",
-        self->n_failed_links, len));
+        batch->n_failed, batch->n_links));
   } else {
     wp_object_update_features (WP_OBJECT (self),
         WP_SESSION_ITEM_FEATURE_ACTIVE, 0);
   }
+
+  g_clear_pointer (&self->link_batch, link_batch_unref);
+  link_batch_unref (batch);
 }
 
 static void
@@ -281,12 +334,12 @@ create_links (WpSiStandardLink * self, WpTransition * transition,
   struct port out_port = {0};
   struct port *in_port;
   GVariantIter *iter = NULL;
+  struct link_batch *batch;
   guint i;
 
   /* Clear old links if any */
-  self->n_active_links = 0;
-  self->n_failed_links = 0;
   clear_node_links (&self->node_links);
+  g_clear_pointer (&self->link_batch, link_batch_unref);
 
   /* tuple format:
       uint32 node_id;
@@ -358,17 +411,28 @@ create_links (WpSiStandardLink * self, WpTransition * transition,
     link = wp_link_new_from_factory (core, "link-factory", props);
     g_ptr_array_add (self->node_links, link);
 
-    /* activate to ensure it is created without errors */
-    wp_object_activate_closure (WP_OBJECT (link),
-        WP_OBJECT_FEATURES_ALL & ~WP_LINK_FEATURE_ESTABLISHED, NULL,
-        g_cclosure_new_object (
-            (GCallback) on_link_activated, G_OBJECT (transition)));
-
     g_signal_connect_object (link, "state-changed",
       G_CALLBACK (on_link_state_changed), self, 0);
   }
   g_variant_iter_free (iter);
-  return self->node_links->len > 0;
+
+  if (self->node_links->len == 0)
+    return FALSE;
+
+  /* activate all links in one go, to ensure they are created without errors;
+     their requests reach the server together, so they complete in the same
+     round-trip and a single counter tracks them all */
+  batch = link_batch_new (transition);
+  batch->n_links = batch->n_pending = self->node_links->len;
+  self->link_batch = g_rc_box_acquire (batch);
+
+  for (i = 0; i < self->node_links->len; i++) {
+    wp_object_activate (g_ptr_array_index (self->node_links, i),
+        WP_OBJECT_FEATURES_ALL & ~WP_LINK_FEATURE_ESTABLISHED, NULL,
+        (GAsyncReadyCallback) on_link_activated,
+        i == 0 ? batch : g_rc_box_acquire (batch));
+  }
+  return TRUE;
 }
 
 static void
@@ -10,6 +10,7 @@
 #include <glib-unix.h>
 #include <pipewire/pipewire.h>
 #include <locale.h>
+#include <unistd.h>
 
 #define WP_DOMAIN_DAEMON (wp_domain_daemon_quark ())
 static G_DEFINE_QUARK (wireplumber-daemon, wp_domain_daemon);
@@ -24,6 +25,8 @@ enum WpExitCode
   WP_EXIT_CONFIG = 78,      /* configuration error */
 };
 
+#define DEFAULT_FLIGHT_RECORDER_SIZE 8192
+
 static gboolean show_version = FALSE;
 static gchar * config_file = NULL;
 
@@ -392,6 +395,54 @@ signal_handler_term (gpointer data)
   return signal_handler (SIGTERM, data);
 }
 
+static gboolean
+signal_handler_usr1 (gpointer data)
+{
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *filename = NULL;
+  g_autofree gchar *basename = g_strdup_printf (
+      "wireplumber-flight-recorder-%d.log", getpid ());
+
+  filename = g_build_filename (g_get_user_runtime_dir (), basename, NULL);
+  if (wp_log_flight_recorder_dump (filename, &error))
+    wp_message ("flight recorder dumped to %s", filename);
+  else
+    wp_warning ("failed to dump the flight recorder: %s", error->message);
+  return G_SOURCE_CONTINUE;
+}
+
+/* WIREPLUMBER_FLIGHT_RECORDER=[SIZE][:LEVEL], where LEVEL is one of the level
+   letters of WIREPLUMBER_DEBUG; the recorder formats every message up to its
+   level, even the ones that are not written, so it is only started on request */
+static void
+start_flight_recorder (void)
+{
+  const gchar *env = g_getenv ("WIREPLUMBER_FLIGHT_RECORDER");
+  guint64 size = DEFAULT_FLIGHT_RECORDER_SIZE;
+  GLogLevelFlags level = G_LOG_LEVEL_DEBUG;
+  gchar *end = NULL;
+
+  if (!env || env[0] == '\0')
+    return;
+
+  size = g_ascii_strtoull (env, &end, 10);
+  if (end == env)
+    size = DEFAULT_FLIGHT_RECORDER_SIZE;
+  if (*end == ':') {
+    switch (end[1]) {
+      case 'W': level = G_LOG_LEVEL_WARNING; break;
+      case 'M': level = G_LOG_LEVEL_MESSAGE; break;
+      case 'I': level = G_LOG_LEVEL_INFO; break;
+      case 'D': level = G_LOG_LEVEL_DEBUG; break;
+      case 'T': level = WP_LOG_LEVEL_TRACE; break;
+      default: break;
+    }
+  }
+
+  if (size > 0 && size <= G_MAXUINT32 &&
+      wp_log_flight_recorder_start ((guint) size, level))
+    g_unix_signal_add (SIGUSR1, signal_handler_usr1, NULL);
+}
 
 static gboolean
 init_start (WpTransition * transition)
@@ -423,6 +474,8 @@ main (gint argc, gchar **argv)
   setlocale (LC_ALL, "");
   setlocale (LC_NUMERIC, "C");
   wp_init (WP_INIT_ALL);
+  wp_log_install_crash_handler ();
+  start_flight_recorder ();
 
   context = g_option_context_new ("- PipeWire Session/Policy Manager");
   g_option_context_add_main_entries (context, entries, NULL);
@@ -481,5 +534,6 @@ main (gint argc, gchar **argv)
   /* run */
   g_main_loop_run (d.loop);
   wp_core_disconnect (d.core);
+  wp_state_flush_all ();
   return d.exit_code;
 }
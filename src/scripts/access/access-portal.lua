@@ -106,16 +106,27 @@ if pps_plugin then
   }
   nodes_om:activate()
 
+  -- the lookups do not block; the permissions are cached by the plugin,
+  -- so the callback is usually called right away
   clients_om:connect("object-added", function (om, client)
-    local new_perms = pps_plugin:call("lookup", "devices", "camera");
-    updateClientPermissions (client, new_perms)
+    local client_id = client["bound-id"]
+    pps_plugin:call("lookup-async", "devices", "camera", function (new_perms)
+      -- the client may have gone away while waiting for the store
+      local client = clients_om:lookup {
+        Constraint { "bound-id", "=", client_id, type = "gobject" }
+      }
+      if client then
+        updateClientPermissions (client, new_perms)
+      end
+    end)
   end)
 
   nodes_om:connect("object-added", function (om, node)
-    local new_perms = pps_plugin:call("lookup", "devices", "camera");
-    for client in clients_om:iterate() do
-      updateClientPermissions (client, new_perms)
-    end
+    pps_plugin:call("lookup-async", "devices", "camera", function (new_perms)
+      for client in clients_om:iterate() do
+        updateClientPermissions (client, new_perms)
+      end
+    end)
   end)
 
   pps_plugin:connect("changed", function (p, table, id, deleted, permissions)
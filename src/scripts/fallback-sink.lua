@@ -71,15 +71,19 @@ function checkSinksAfterTimeout()
   end)
 end
 
-node_om:connect("object-added", function (_, node)
-  Log.debug("object added: " .. node.properties["object.id"] .. " " ..
-      tostring(node.properties["node.name"]))
+node_om:connect("objects-added", function (_, nodes)
+  for _, node in ipairs(nodes) do
+    Log.debug("object added: " .. node.properties["object.id"] .. " " ..
+        tostring(node.properties["node.name"]))
 
-  sink_ids[node.properties["object.id"]] = node.properties["node.name"]
+    sink_ids[node.properties["object.id"]] = node.properties["node.name"]
+  end
 
   checkSinksAfterTimeout()
 end)
 
+-- object-removed is emitted while the node still has its properties,
+-- unlike the batched objects-removed signal
 node_om:connect("object-removed", function (_, node)
   Log.debug("object removed: " .. node.properties["object.id"] .. " " ..
       tostring(node.properties["node.name"]))
@@ -0,0 +1,230 @@
+-- WirePlumber
+--
+-- Copyright © 2023 The WirePlumber project contributors
+--
+-- SPDX-License-Identifier: MIT
+--
+-- Indexes the linkables and the links that the policy deals with, so that
+-- targets can be found without iterating over all the linkables, and keeps
+-- track of what each stream depended on the last time it was handled
+-- (target names and ids, the default nodes, links...), so that on every event
+-- only the streams that are affected by the change need to be handled again.
+--
+-- Dependencies are plain string keys; key(prop, value) makes the keys that
+-- refer to linkable properties and links, while "default" refers to anything
+-- that may change the default or the best target (default nodes, routes,
+-- devices appearing or disappearing) and "links" to any link change.
+
+local LinkablesIndex = {}
+
+-- the linkable properties that targets can be looked up with
+local TARGET_PROPS = { "node.id", "object.serial", "node.name", "object.path" }
+
+local function key (prop, value)
+  return prop .. "=" .. tostring (value)
+end
+
+local function setAdd (t, k, v, value)
+  local s = t[k]
+  if not s then
+    s = {}
+    t[k] = s
+  end
+  s[v] = value or true
+end
+
+local function setRemove (t, k, v)
+  local s = t[k]
+  if s then
+    s[v] = nil
+    if next (s) == nil then
+      t[k] = nil
+    end
+  end
+end
+
+-- returns an iterator over the values of set s, in the order of their keys;
+-- the set is copied, so it may be modified while iterating; keys that have
+-- no value (ex. ids of linkables that are gone) are skipped
+local function iterateSet (s, values)
+  local ids = {}
+  for id in pairs (s or {}) do
+    table.insert (ids, id)
+  end
+  table.sort (ids)
+
+  local i = 0
+  return function ()
+    while i < #ids do
+      i = i + 1
+      local value = values (ids[i])
+      if value ~= nil then
+        return value
+      end
+    end
+    return nil
+  end
+end
+
+function LinkablesIndex.new ()
+  local index = {
+    items = {},       -- id -> linkable
+    item_info = {},   -- id -> { keys = { key... }, group = link-group }
+    by_key = {},      -- key -> set of linkable ids
+    groups = {},      -- node.link-group -> set of linkable ids
+    links = {},       -- linkable id -> { link id -> link }
+    deps = {},        -- stream id -> set of keys
+    dependents = {},  -- key -> set of stream ids
+    dirty = {},       -- set of linkable ids that need to be handled again
+  }
+
+  -- setmetatable() is not available in the sandbox, so copy the methods
+  for name, method in pairs (LinkablesIndex) do
+    index[name] = method
+  end
+  return index
+end
+
+LinkablesIndex.key = key
+
+function LinkablesIndex:addLinkable (id, linkable, properties)
+  local info = { keys = {}, group = properties["node.link-group"] }
+
+  for _, prop in ipairs (TARGET_PROPS) do
+    local value = properties[prop]
+    if value ~= nil then
+      local k = key (prop, value)
+      table.insert (info.keys, k)
+      setAdd (self.by_key, k, id)
+      self:markKey (k)
+    end
+  end
+  if info.group then
+    setAdd (self.groups, info.group, id)
+  end
+
+  self.items[id] = linkable
+  self.item_info[id] = info
+  self:mark (id)
+end
+
+function LinkablesIndex:removeLinkable (id)
+  local info = self.item_info[id]
+  if not info then
+    return
+  end
+
+  for _, k in ipairs (info.keys) do
+    setRemove (self.by_key, k, id)
+    self:markKey (k)
+  end
+  if info.group then
+    setRemove (self.groups, info.group, id)
+  end
+
+  self.items[id] = nil
+  self.item_info[id] = nil
+  self.dirty[id] = nil
+  self:clearDeps (id)
+end
+
+function LinkablesIndex:get (id)
+  return id and self.items[id]
+end
+
+-- iterates over the linkables whose property 'prop' is equal to 'value'
+function LinkablesIndex:lookup (prop, value)
+  return iterateSet (self.by_key[key (prop, value)],
+      function (id) return self.items[id] end)
+end
+
+function LinkablesIndex:lookupFirst (prop, value)
+  return self:lookup (prop, value) ()
+end
+
+-- iterates over the linkables that have the given node.link-group
+function LinkablesIndex:iterateGroup (group)
+  return iterateSet (self.groups[group],
+      function (id) return self.items[id] end)
+end
+
+function LinkablesIndex:addLink (link, out_id, in_id)
+  setAdd (self.links, out_id, link.id, link)
+  setAdd (self.links, in_id, link.id, link)
+  self:markLinks (out_id, in_id)
+end
+
+function LinkablesIndex:removeLink (link, out_id, in_id)
+  setRemove (self.links, out_id, link.id)
+  setRemove (self.links, in_id, link.id)
+  self:markLinks (out_id, in_id)
+end
+
+-- iterates over the links that have the given linkable on either side
+function LinkablesIndex:iterateLinks (id)
+  local links = self.links[id]
+  return iterateSet (links, function (link_id) return links[link_id] end)
+end
+
+function LinkablesIndex:addDep (id, k)
+  setAdd (self.deps, id, k)
+  setAdd (self.dependents, k, id)
+end
+
+function LinkablesIndex:clearDeps (id)
+  local deps = self.deps[id]
+  if deps then
+    for k in pairs (deps) do
+      setRemove (self.dependents, k, id)
+    end
+    self.deps[id] = nil
+  end
+end
+
+function LinkablesIndex:mark (id)
+  if id then
+    self.dirty[id] = true
+  end
+end
+
+function LinkablesIndex:markKey (k)
+  for id in pairs (self.dependents[k] or {}) do
+    self.dirty[id] = true
+  end
+end
+
+function LinkablesIndex:markLinks (out_id, in_id)
+  self:mark (out_id)
+  self:mark (in_id)
+  self:markKey (key ("link", out_id))
+  self:markKey (key ("link", in_id))
+  self:markKey ("links")
+end
+
+function LinkablesIndex:markAll ()
+  for id in pairs (self.items) do
+    self.dirty[id] = true
+  end
+end
+
+function LinkablesIndex:clean (id)
+  self.dirty[id] = nil
+end
+
+function LinkablesIndex:hasDirty ()
+  return next (self.dirty) ~= nil
+end
+
+-- returns the linkables that need to be handled again, in the order they
+-- were added, and clears the dirty set
+function LinkablesIndex:takeDirty ()
+  local dirty = self.dirty
+  self.dirty = {}
+  local result = {}
+  for si in iterateSet (dirty, function (id) return self.items[id] end) do
+    table.insert (result, si)
+  end
+  return result
+end
+
+return LinkablesIndex
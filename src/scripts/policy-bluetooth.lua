@@ -86,10 +86,7 @@ local function storeAfterTimeout()
     timeout_source:destroy()
   end
   timeout_source = Core.timeout_add(1000, function ()
-    local saved, err = state:save(headset_profiles)
-    if not saved then
-      Log.warning(err)
-    end
+    state:save_deferred(headset_profiles)
     timeout_source = nil
   end)
 end
@@ -130,18 +127,23 @@ local function isBluez5DefaultAudioSink()
   return isBluez5AudioSink(default_audio_sink)
 end
 
+-- findProfile() is called for every profile of every route, so let it
+-- extract only the fields it needs
+local profile_schema = Pod.Schema("Spa:Pod:Object:Param:Profile",
+    { "index", "name", "priority" })
+
 local function findProfile(device, index, name)
   for p in device:iterate_params("EnumProfile") do
-    local profile = parseParam(p, "EnumProfile")
-    if not profile then
+    local id, p_index, p_name, p_priority = profile_schema:parse(p)
+    if id ~= "EnumProfile" then
       goto skip_enum_profile
     end
 
-    Log.debug("Profile name: " .. profile.name .. ", priority: "
-              .. tostring(profile.priority) .. ", index: " .. tostring(profile.index))
-    if (index ~= nil and profile.index == index) or
-        (name ~= nil and profile.name == name) then
-      return profile.priority, profile.index, profile.name
+    Log.debug("Profile name: " .. p_name .. ", priority: "
+              .. tostring(p_priority) .. ", index: " .. tostring(p_index))
+    if (index ~= nil and p_index == index) or
+        (name ~= nil and p_name == name) then
+      return p_priority, p_index, p_name
     end
 
     ::skip_enum_profile::
@@ -375,10 +377,12 @@ streams_om:connect("object-removed", function (_, stream)
   triggerRestoreProfile()
 end)
 
-devices_om:connect("object-added", function (_, device)
-  -- Devices are unswitched initially
-  if isSwitched(device) then
-    saveLastProfile(device, nil)
+devices_om:connect("objects-added", function (_, devices)
+  for _, device in ipairs(devices) do
+    -- Devices are unswitched initially
+    if isSwitched(device) then
+      saveLastProfile(device, nil)
+    end
   end
   handleAllStreams()
 end)
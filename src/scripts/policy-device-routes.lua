@@ -77,10 +77,7 @@ function storeAfterTimeout()
     timeout_source:destroy()
   end
   timeout_source = Core.timeout_add(1000, function ()
-    local saved, err = state:save(state_table)
-    if not saved then
-      Log.warning(err)
-    end
+    state:save_deferred(state_table)
     timeout_source = nil
   end)
 end
@@ -13,14 +13,19 @@ config.move = config.move or false
 config.follow = config.follow or false
 config.filter_forward_format = config["filter.forward-format"] or false
 
+local LinkablesIndex = require ("linkables-index")
+
 local self = {}
+self.index = LinkablesIndex.new ()
 self.scanning = false
 self.pending_rescan = false
 self.events_skipped = false
 self.pending_error_timer = nil
 
+-- handles only the linkables that were affected by the events
+-- that happened since the last rescan
 function rescan()
-  for si in linkables_om:iterate() do
+  for _, si in ipairs (self.index:takeDirty ()) do
     handleLinkable (si)
   end
 end
@@ -131,7 +136,10 @@ function createLink (si, si_target, passthrough, exclusive)
   si_link:register ()
 
   -- activate
+  local out_id = out_item.id
+  local in_id = in_item.id
   si_link:activate (Feature.SessionItem.ACTIVE, function (l, e)
+    self.index:markLinks (out_id, in_id)
     if e then
       Log.info (l, "failed to activate si-standard-link: " .. tostring(e))
       if si_flags[si_id] ~= nil then
@@ -150,21 +158,11 @@ function createLink (si, si_target, passthrough, exclusive)
 end
 
 function isLinked(si_target)
-  local target_id = si_target.id
-  local linked = false
-  local exclusive = false
-
-  for l in links_om:iterate() do
+  for l in self.index:iterateLinks (si_target.id) do
     local p = l.properties
-    local out_id = tonumber(p["out.item.id"])
-    local in_id = tonumber(p["in.item.id"])
-    linked = (out_id == target_id) or (in_id == target_id)
-    if linked then
-      exclusive = parseBool(p["exclusive"]) or parseBool(p["passthrough"])
-      break
-    end
+    return true, parseBool(p["exclusive"]) or parseBool(p["passthrough"])
   end
-  return linked, exclusive
+  return false, false
 end
 
 function canPassthrough (si, si_target)
@@ -177,17 +175,7 @@ function canPassthrough (si, si_target)
   -- make sure that the nodes have at least one common non-raw format
   local n1 = si:get_associated_proxy ("node")
   local n2 = si_target:get_associated_proxy ("node")
-  for p1 in n1:iterate_params("EnumFormat") do
-    local p1p = p1:parse()
-    if p1p.properties.mediaSubtype ~= "raw" then
-      for p2 in n2:iterate_params("EnumFormat") do
-        if p1:filter(p2) then
-          return true
-        end
-      end
-    end
-  end
-  return false
+  return n1:has_common_format (n2, true)
 end
 
 function canLink (properties, si_target)
@@ -233,20 +221,15 @@ function canLink (properties, si_target)
 
     -- make sure target is not linked with another node with same link group
     -- start by locating other nodes in the target's link-group, in opposite direction
-    for n in linkables_om:iterate {
-      Constraint { "id", "!", si_target.id, type = "gobject" },
-      Constraint { "item.node.direction", "!", target_props["item.node.direction"] },
-      Constraint { "node.link-group", "=", target_link_group },
-    } do
-      -- iterate their peers and return false if one of them cannot link
-      for silink in links_om:iterate() do
-        local out_id = tonumber(silink.properties["out.item.id"])
-        local in_id = tonumber(silink.properties["in.item.id"])
-        if out_id == n.id or in_id == n.id then
+    for n in self.index:iterateGroup (target_link_group) do
+      if n.id ~= si_target.id and n.properties["item.node.direction"] ~=
+          target_props["item.node.direction"] then
+        -- iterate their peers and return false if one of them cannot link
+        for silink in self.index:iterateLinks (n.id) do
+          local out_id = tonumber(silink.properties["out.item.id"])
+          local in_id = tonumber(silink.properties["in.item.id"])
           local peer_id = (out_id == n.id) and in_id or out_id
-          local peer = linkables_om:lookup {
-            Constraint { "id", "=", peer_id, type = "gobject" },
-          }
+          local peer = self.index:get (peer_id)
           if peer and not canLinkGroupCheck (link_group, peer, hops + 1) then
             return false
           end
@@ -287,8 +270,9 @@ end
 -- Use the target.node metadata, if config.move is enabled,
 -- then use the node.target property that was set on the node
 -- `properties` must be the properties dictionary of the session item
--- that is currently being handled
-function findDefinedTarget (properties)
+-- that is currently being handled and `si_id` its id, which is recorded
+-- as depending on the target, so that it is handled again when it appears
+function findDefinedTarget (properties, si_id)
   local metadata = config.move and metadata_om:lookup()
   local target_direction = getTargetDirection(properties)
   local target_key
@@ -326,22 +310,21 @@ function findDefinedTarget (properties)
   end
 
   if target_value and tonumber(target_value) then
-    local si_target = linkables_om:lookup {
-      Constraint { target_key, "=", target_value },
-    }
+    self.index:addDep (si_id, LinkablesIndex.key (target_key, target_value))
+    local si_target = self.index:lookupFirst (target_key, target_value)
     if si_target and canLink (properties, si_target) then
       return si_target, true, node_defined
     end
   end
 
   if target_value then
-    for si_target in linkables_om:iterate() do
-      local target_props = si_target.properties
-      if (target_props["node.name"] == target_value or
-          target_props["object.path"] == target_value) and
-          target_props["item.node.direction"] == target_direction and
-          canLink (properties, si_target) then
-        return si_target, true, node_defined
+    for _, key in ipairs { "node.name", "object.path" } do
+      self.index:addDep (si_id, LinkablesIndex.key (key, target_value))
+      for si_target in self.index:lookup (key, target_value) do
+        if si_target.properties["item.node.direction"] == target_direction and
+            canLink (properties, si_target) then
+          return si_target, true, node_defined
+        end
       end
     end
   end
@@ -551,17 +534,15 @@ function findUndefinedTarget (si)
 end
 
 function lookupLink (si_id, si_target_id)
-  local link = links_om:lookup {
-    Constraint { "out.item.id", "=", si_id },
-    Constraint { "in.item.id", "=", si_target_id }
-  }
-  if not link then
-    link = links_om:lookup {
-      Constraint { "in.item.id", "=", si_id },
-      Constraint { "out.item.id", "=", si_target_id }
-    }
+  for link in self.index:iterateLinks (si_id) do
+    local out_id = tonumber (link.properties["out.item.id"])
+    local in_id = tonumber (link.properties["in.item.id"])
+    if (out_id == si_id and in_id == si_target_id) or
+        (in_id == si_id and out_id == si_target_id) then
+      return link
+    end
   end
-  return link
+  return nil
 end
 
 function checkLinkable(si, handle_nonstreams)
@@ -616,6 +597,8 @@ function checkPending ()
   elseif self.events_skipped then
     Log.debug("pending linkables ready")
     self.events_skipped = false
+    -- the events that were skipped may have affected any of the linkables
+    self.index:markAll ()
     scheduleRescan ()
     return true
   end
@@ -657,6 +640,10 @@ function handleLinkable (si)
     return
   end
 
+  -- the dependencies are recorded again below, while looking for a target
+  local si_id = si.id
+  self.index:clearDeps (si_id)
+
   local valid, si_props = checkLinkable(si)
   if not valid then
     return
@@ -679,9 +666,14 @@ function handleLinkable (si)
   local exclusive = parseBool(si_props["node.exclusive"])
   local si_must_passthrough = parseBool(si_props["item.node.encoded-only"])
 
+  -- filters depend on the links of the other nodes in their link group
+  if si_props["node.link-group"] then
+    self.index:addDep (si_id, "links")
+  end
+
   -- find defined target
   local si_target, has_defined_target, has_node_defined_target
-      = findDefinedTarget(si_props)
+      = findDefinedTarget(si_props, si_id)
   local can_passthrough = si_target and canPassthrough(si, si_target)
 
   if si_target and si_must_passthrough and not can_passthrough then
@@ -690,20 +682,24 @@ function handleLinkable (si)
 
   -- if the client has seen a target that we haven't yet prepared, schedule
   -- a rescan one more time and hope for the best
-  local si_id = si.id
   if has_defined_target
       and not si_target
       and not si_flags[si_id].was_handled
       and not si_flags[si_id].done_waiting then
     Log.info (si, "... waiting for target")
     si_flags[si_id].done_waiting = true
+    self.index:mark (si_id)
     scheduleRescan()
     return
   end
 
   -- find fallback target
   if not si_target and (reconnect or not has_defined_target) then
+    self.index:addDep (si_id, "default")
     si_target, can_passthrough = findUndefinedTarget(si)
+  elseif has_node_defined_target and config.follow then
+    -- see checkFollowDefault()
+    self.index:addDep (si_id, "default")
   end
 
   -- Check if item is linked to proper target, otherwise re-link
@@ -745,6 +741,7 @@ function handleLinkable (si)
 
   -- check target's availability
   if si_target then
+    self.index:addDep (si_id, LinkablesIndex.key ("link", si_target.id))
     local target_is_linked, target_is_exclusive = isLinked(si_target)
     if target_is_exclusive then
       Log.info(si, "... target is linked exclusively")
@@ -809,20 +806,18 @@ function unhandleLinkable (si)
       tostring(si_props["node.name"]), tostring(si_props["node.id"])))
 
   -- remove any links associated with this item
-  for silink in links_om:iterate() do
+  for silink in self.index:iterateLinks (si.id) do
     local out_id = tonumber (silink.properties["out.item.id"])
     local in_id = tonumber (silink.properties["in.item.id"])
-    if out_id == si.id or in_id == si.id then
-      if out_id == si.id and
-          si_flags[in_id] and si_flags[in_id].peer_id == out_id then
-        si_flags[in_id].peer_id = nil
-      elseif in_id == si.id and
-          si_flags[out_id] and si_flags[out_id].peer_id == in_id then
-        si_flags[out_id].peer_id = nil
-      end
-      silink:remove ()
-      Log.info (silink, "... link removed")
+    if out_id == si.id and
+        si_flags[in_id] and si_flags[in_id].peer_id == out_id then
+      si_flags[in_id].peer_id = nil
+    elseif in_id == si.id and
+        si_flags[out_id] and si_flags[out_id].peer_id == in_id then
+      si_flags[out_id].peer_id = nil
     end
+    silink:remove ()
+    Log.info (silink, "... link removed")
   end
 
   si_flags[si.id] = nil
@@ -872,6 +867,7 @@ links_om = ObjectManager {
 -- listen for default node changes if config.follow is enabled
 if config.follow and default_nodes ~= nil then
   default_nodes:connect("changed", function ()
+    self.index:markKey ("default")
     scheduleRescan ()
   end)
 end
@@ -881,6 +877,10 @@ if config.move then
   metadata_om:connect("object-added", function (om, metadata)
     metadata:connect("changed", function (m, subject, key, t, value)
       if key == "target.node" or key == "target.object" then
+        -- the subject is the node id of the stream that is moved
+        for si in self.index:lookup ("node.id", subject) do
+          self.index:mark (si.id)
+        end
         scheduleRescan ()
       end
     end)
@@ -985,20 +985,43 @@ linkables_om:connect("object-added", function (om, si)
     checkFiltersPortsState (si)
   end
 
+  -- this marks the streams that were waiting for this linkable as a target
+  self.index:addLinkable (si.id, si, si_props)
+
   if si_props["item.node.type"] ~= "stream" then
+    self.index:markKey ("default")
     scheduleRescan ()
   else
+    self.index:clean (si.id)
     handleLinkable (si)
   end
 end)
 
 linkables_om:connect("object-removed", function (om, si)
   unhandleLinkable (si)
+  self.index:removeLinkable (si.id)
+  if si.properties["item.node.type"] ~= "stream" then
+    self.index:markKey ("default")
+  end
   scheduleRescan ()
 end)
 
+links_om:connect("object-added", function (om, link)
+  local p = link.properties
+  self.index:addLink (link,
+      tonumber (p["out.item.id"]), tonumber (p["in.item.id"]))
+end)
+
+links_om:connect("object-removed", function (om, link)
+  local p = link.properties
+  self.index:removeLink (link,
+      tonumber (p["out.item.id"]), tonumber (p["in.item.id"]))
+end)
+
 devices_om:connect("object-added", function (om, device)
   device:connect("params-changed", function (d, param_name)
+    -- routes affect which targets are the best ones
+    self.index:markKey ("default")
     scheduleRescan ()
   end)
 end)
@@ -1006,6 +1029,7 @@ end)
 metadata_om:activate()
 endpoints_om:activate()
 clients_om:activate()
+linkables_om:add_index ("node.id")
 linkables_om:activate()
 pending_linkables_om:activate()
 links_om:activate()
@@ -82,24 +82,16 @@ function parseArray(str, convert_value, with_type)
   return array
 end
 
-function parseParam(param, id)
-  local route = param:parse()
-  if route.pod_type == "Object" and route.object_id == id then
-    return route.properties
-  else
-    return nil
-  end
-end
+-- the stream properties that are saved, resolved once
+props_schema = Pod.Schema("Spa:Pod:Object:Param:Props",
+    { "volume", "mute", "channelVolumes", "channelMap" })
 
 function storeAfterTimeout()
   if timeout_source then
     timeout_source:destroy()
   end
   timeout_source = Core.timeout_add(1000, function ()
-    local saved, err = state:save(state_table)
-    if not saved then
-      Log.warning(err)
-    end
+    state:save_deferred(state_table)
     timeout_source = nil
   end)
 end
@@ -298,22 +290,23 @@ function saveStream(node)
         tostring(stream_props["node.name"]))
 
     for p in node:iterate_params("Props") do
-      local props = parseParam(p, "Props")
-      if not props then
+      local id, volume, mute, channelVolumes, channelMap =
+          props_schema:parse(p)
+      if id ~= "Props" then
         goto skip_prop
       end
 
-      if props.volume then
-        state_table[key_base .. ":volume"] = tostring(props.volume)
+      if volume then
+        state_table[key_base .. ":volume"] = tostring(volume)
       end
-      if props.mute ~= nil then
-        state_table[key_base .. ":mute"] = tostring(props.mute)
+      if mute ~= nil then
+        state_table[key_base .. ":mute"] = tostring(mute)
       end
-      if props.channelVolumes then
-        state_table[key_base .. ":channelVolumes"] = serializeArray(props.channelVolumes)
+      if channelVolumes then
+        state_table[key_base .. ":channelVolumes"] = serializeArray(channelVolumes)
       end
-      if props.channelMap then
-        state_table[key_base .. ":channelMap"] = serializeArray(props.channelMap)
+      if channelMap then
+        state_table[key_base .. ":channelMap"] = serializeArray(channelMap)
       end
 
       ::skip_prop::
@@ -472,6 +465,7 @@ rs_metadata:activate(Features.ALL, function (m, e)
 end)
 
 allnodes_om = ObjectManager { Interest { type = "node" } }
+allnodes_om:add_index ("node.name", "pw")
 allnodes_om:activate()
 
 streams_om = ObjectManager {
@@ -9,6 +9,8 @@
 #include <wp/wp.h>
 #include <stdio.h>
 #include <locale.h>
+#include <signal.h>
+#include <errno.h>
 #include <spa/utils/defs.h>
 #include <pipewire/keys.h>
 #include <pipewire/extensions/session-manager/keys.h>
@@ -383,6 +385,20 @@ status_run (WpCtl * self)
         wp_properties_get (properties, PW_KEY_APP_PROCESS_USER),
         wp_properties_get (properties, PW_KEY_APP_PROCESS_HOST),
         wp_properties_get (properties, PW_KEY_APP_PROCESS_ID));
+
+    /* registry counters, published by the wireplumber daemon */
+    if (wp_properties_get (properties, "wireplumber.registry.interest-checks"))
+      printf (TREE_INDENT_EMPTY "        interest checks: %s, skipped: %s\n",
+          wp_properties_get (properties, "wireplumber.registry.interest-checks"),
+          wp_properties_get (properties, "wireplumber.registry.interest-skips"));
+    if (wp_properties_get (properties, "wireplumber.registry.expose-stalls"))
+      printf (TREE_INDENT_EMPTY "        expose stalls: %s, max: %s us\n",
+          wp_properties_get (properties, "wireplumber.registry.expose-stalls"),
+          wp_properties_get (properties, "wireplumber.registry.expose-stall-max"));
+    if (wp_properties_get (properties, "wireplumber.registry.object-stores"))
+      printf (TREE_INDENT_EMPTY "        object managers: %s, stores: %s\n",
+          wp_properties_get (properties, "wireplumber.registry.object-managers"),
+          wp_properties_get (properties, "wireplumber.registry.object-stores"));
   }
   g_clear_pointer (&it, wp_iterator_unref);
   printf ("\n");
@@ -1347,6 +1363,66 @@ out:
   g_main_loop_quit (self->loop);
 }
 
+/* dump-flight-recorder */
+
+static gboolean
+dump_flight_recorder_prepare (WpCtl * self, GError ** error)
+{
+  wp_object_manager_add_interest (self->om, WP_TYPE_CLIENT,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "wireplumber.daemon", "=s", "true",
+      NULL);
+  wp_object_manager_request_object_features (self->om, WP_TYPE_CLIENT,
+      WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+  return TRUE;
+}
+
+static void
+dump_flight_recorder_run (WpCtl * self)
+{
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) val = G_VALUE_INIT;
+  g_autoptr (GArray) pids = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  it = wp_object_manager_new_iterator (self->om);
+  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
+    WpPipewireObject *client = g_value_get_object (&val);
+    const gchar *pid_str;
+    gint pid;
+    gboolean seen = FALSE;
+
+    pid_str = wp_pipewire_object_get_property (client, PW_KEY_SEC_PID);
+    if (!pid_str)
+      pid_str = wp_pipewire_object_get_property (client,
+          PW_KEY_APP_PROCESS_ID);
+    if (!pid_str || (pid = atoi (pid_str)) <= 0)
+      continue;
+
+    /* a daemon may have more than one connection */
+    for (guint i = 0; i < pids->len; i++)
+      seen = seen || g_array_index (pids, gint, i) == pid;
+    if (seen)
+      continue;
+    g_array_append_val (pids, pid);
+
+    if (kill (pid, SIGUSR1) < 0) {
+      fprintf (stderr, "Failed to signal WirePlumber (pid %d): %s\n",
+          pid, g_strerror (errno));
+      self->exit_code = 3;
+      continue;
+    }
+    printf ("Requested a flight recorder dump from WirePlumber (pid %d), "
+        "written to $XDG_RUNTIME_DIR/wireplumber-flight-recorder-%d.log\n",
+        pid, pid);
+  }
+
+  if (pids->len == 0) {
+    fprintf (stderr, "WirePlumber is not running\n");
+    self->exit_code = 3;
+  }
+
+  g_main_loop_quit (self->loop);
+}
+
 #define N_ENTRIES 3
 
 static const struct subcommand {
@@ -1489,6 +1565,18 @@ static const struct subcommand {
     .parse_positional = clear_default_parse_positional,
     .prepare = clear_default_prepare,
     .run = clear_default_run,
+  },
+  {
+    .name = "dump-flight-recorder",
+    .positional_args = "",
+    .summary = "Makes WirePlumber write its recent log activity to a file",
+    .description = "The WirePlumber daemon keeps its most recent log "
+        "messages in memory, at all levels; this writes them to "
+        "$XDG_RUNTIME_DIR/wireplumber-flight-recorder-PID.log",
+    .entries = { { NULL } },
+    .parse_positional = NULL,
+    .prepare = dump_flight_recorder_prepare,
+    .run = dump_flight_recorder_run,
   }
 };
 
@@ -143,6 +143,11 @@ test_si_standard_link_main (TestFixture * f, gconstpointer user_data)
       NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
   g_main_loop_run (f->base.loop);
 
+  /* verify the link setup instrumentation */
+  g_assert_cmpstr (wp_session_item_get_property (link, "link.setup.n-links"),
+      ==, "2");
+  g_assert_nonnull (wp_session_item_get_property (link, "link.setup.time-us"));
+
   /* verify the graph state */
   {
     g_autoptr (WpNode) out_node = NULL;
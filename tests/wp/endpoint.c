@@ -516,6 +516,17 @@ test_endpoint_with_props (TestEndpointFixture *fixture, gconstpointer data)
     g_assert_cmpint (boolean_value, ==, FALSE);
   }
 
+  /* verify the params cache stats */
+  {
+    WpPipewireObjectParamsStats stats;
+
+    wp_pipewire_object_get_params_stats (
+        WP_PIPEWIRE_OBJECT (fixture->proxy_endpoint), &stats);
+    g_assert_cmpuint (stats.n_ids, >=, 1);
+    g_assert_cmpuint (stats.n_params, >=, stats.n_ids);
+    g_assert_cmpuint (stats.size, >, 0);
+  }
+
   /* setup change signals */
   g_signal_connect (fixture->proxy_endpoint, "params-changed",
       (GCallback) test_endpoint_params_changed, fixture);
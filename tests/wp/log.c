@@ -0,0 +1,172 @@
+/* WirePlumber
+ *
+ * Copyright © 2023 The WirePlumber project contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define G_LOG_DOMAIN "wp-test-log"
+
+#include <wp/wp.h>
+#include <glib/gstdio.h>
+
+static guint n_formatted = 0;
+
+static const gchar *
+format_arg (void)
+{
+  n_formatted++;
+  return "arg";
+}
+
+static void
+test_log_call_site (void)
+{
+  WpLogCallSite site_test = { 0 };
+  WpLogCallSite site_other = { 0 };
+
+  wp_log_set_level ("D:wp-test*,other");
+  g_assert_true (wp_log_call_site_is_enabled (&site_test, G_LOG_LEVEL_DEBUG,
+      "wp-test-log"));
+  g_assert_true (wp_log_call_site_is_enabled (&site_other, G_LOG_LEVEL_DEBUG,
+      "other"));
+
+  /* the verdicts are cached until the categories change */
+  g_assert_true (wp_log_call_site_is_enabled (&site_test, G_LOG_LEVEL_DEBUG,
+      "wp-test-log"));
+
+  wp_log_set_level ("D:other");
+  g_assert_false (wp_log_call_site_is_enabled (&site_test, G_LOG_LEVEL_DEBUG,
+      "wp-test-log"));
+  g_assert_true (wp_log_call_site_is_enabled (&site_other, G_LOG_LEVEL_DEBUG,
+      "other"));
+
+  wp_log_set_level ("D:wp-*");
+  g_assert_true (wp_log_call_site_is_enabled (&site_test, G_LOG_LEVEL_DEBUG,
+      "wp-test-log"));
+  g_assert_false (wp_log_call_site_is_enabled (&site_other, G_LOG_LEVEL_DEBUG,
+      "other"));
+
+  /* no categories enables everything */
+  wp_log_set_level ("D");
+  g_assert_true (wp_log_call_site_is_enabled (&site_test, G_LOG_LEVEL_DEBUG,
+      "wp-test-log"));
+  g_assert_true (wp_log_call_site_is_enabled (&site_other, G_LOG_LEVEL_DEBUG,
+      "other"));
+
+  /* ... up to the enabled level */
+  g_assert_false (wp_log_call_site_is_enabled (&site_test, WP_LOG_LEVEL_TRACE,
+      "wp-test-log"));
+}
+
+static void
+test_log_disabled_no_format (void)
+{
+  n_formatted = 0;
+
+  /* disabled category: the arguments are not even evaluated */
+  wp_log_set_level ("D:other");
+  for (guint i = 0; i < 3; i++)
+    wp_debug ("message %s", format_arg ());
+  g_assert_cmpuint (n_formatted, ==, 0);
+
+  /* disabled level */
+  wp_log_set_level ("I:wp-test*");
+  wp_debug ("message %s", format_arg ());
+  g_assert_cmpuint (n_formatted, ==, 0);
+
+  /* enabled */
+  wp_log_set_level ("D:wp-test*");
+  wp_debug ("message %s", format_arg ());
+  g_assert_cmpuint (n_formatted, ==, 1);
+
+  wp_log_set_level ("D");
+}
+
+static void
+test_log_critical_disabled_category (void)
+{
+  if (g_test_subprocess ()) {
+    /* criticals are fatal under g_test, even in disabled categories */
+    wp_log_set_level ("D:other");
+    wp_critical ("critical message");
+    return;
+  }
+
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_failed ();
+}
+
+static void
+test_log_flight_recorder (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  g_autofree gchar *filename = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *expected = NULL;
+
+  /* messages are recorded even if they are not enabled for output */
+  wp_log_set_level ("W:other");
+
+  g_assert_false (wp_log_flight_recorder_is_active ());
+  g_assert_true (wp_log_flight_recorder_start (10, G_LOG_LEVEL_DEBUG));
+  g_assert_true (wp_log_flight_recorder_is_active ());
+  g_assert_false (wp_log_flight_recorder_start (10, WP_LOG_LEVEL_TRACE));
+
+  /* 10 is rounded up to 16, so only the last 16 messages are kept */
+  for (guint i = 0; i < 20; i++)
+    wp_debug ("debug message %u", i);
+
+  /* levels above the recorded one are not even evaluated */
+  n_formatted = 0;
+  wp_trace ("trace message %s", format_arg ());
+  g_assert_cmpuint (n_formatted, ==, 0);
+
+  tmpdir = g_dir_make_tmp ("wp-test-log-XXXXXX", &error);
+  g_assert_no_error (error);
+  filename = g_build_filename (tmpdir, "flight-recorder.log", NULL);
+
+  g_assert_true (wp_log_flight_recorder_dump (filename, &error));
+  g_assert_no_error (error);
+  g_assert_true (g_file_get_contents (filename, &contents, NULL, &error));
+  g_assert_no_error (error);
+
+  g_assert_null (strstr (contents, "debug message 3\n"));
+  for (guint i = 4; i < 20; i++) {
+    g_autofree gchar *msg = g_strdup_printf ("debug message %u\n", i);
+    g_assert_nonnull (strstr (contents, msg));
+  }
+  g_assert_null (strstr (contents, "trace message"));
+  g_assert_nonnull (strstr (contents, "D "));
+  g_assert_nonnull (strstr (contents, "wp-test-log"));
+
+  /* long messages are truncated */
+  expected = g_strnfill (200, 'x');
+  wp_debug ("%s", expected);
+  g_clear_pointer (&contents, g_free);
+  g_assert_true (wp_log_flight_recorder_dump (filename, &error));
+  g_assert_true (g_file_get_contents (filename, &contents, NULL, &error));
+  g_assert_null (strstr (contents, expected));
+  g_assert_nonnull (strstr (contents, "xxxxxxxxxx\n"));
+
+  g_unlink (filename);
+  g_rmdir (tmpdir);
+  wp_log_set_level ("D");
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_log_set_writer_func (wp_log_writer_default, NULL, NULL);
+
+  g_test_add_func ("/wp/log/call-site", test_log_call_site);
+  g_test_add_func ("/wp/log/disabled-no-format", test_log_disabled_no_format);
+  g_test_add_func ("/wp/log/critical-disabled-category",
+      test_log_critical_disabled_category);
+  /* must be last, the recorder stays active */
+  g_test_add_func ("/wp/log/flight-recorder", test_log_flight_recorder);
+
+  return g_test_run ();
+}
@@ -454,6 +454,76 @@ test_metadata_basic (TestFixture *fixture, gconstpointer data)
   g_assert_null (fixture->proxy_metadata);
 }
 
+static void
+test_metadata_index (TestFixture *fixture, gconstpointer data)
+{
+  g_autoptr (WpMetadata) metadata =
+      WP_METADATA (wp_impl_metadata_new (fixture->base.core));
+  g_autoptr (WpIterator) iter = NULL;
+  g_auto (GValue) val = G_VALUE_INIT;
+  guint subject = -1;
+  const gchar *key = NULL, *type = NULL, *value = NULL;
+  guint n_items = 0;
+
+  for (guint i = 0; i < 100; i++) {
+    g_autofree gchar *v = g_strdup_printf ("%u", i);
+    wp_metadata_set (metadata, i % 10, "target.node", "Spa:Id", v);
+    wp_metadata_set (metadata, i % 10, v, NULL, v);
+  }
+
+  /* the last set value wins, type included */
+  value = wp_metadata_find (metadata, 3, "target.node", &type);
+  g_assert_cmpstr (type, ==, "Spa:Id");
+  g_assert_cmpstr (value, ==, "93");
+  value = wp_metadata_find (metadata, 3, "43", &type);
+  g_assert_cmpstr (type, ==, "string");
+  g_assert_cmpstr (value, ==, "43");
+  g_assert_null (wp_metadata_find (metadata, 3, "44", NULL));
+  g_assert_null (wp_metadata_find (metadata, 100, "target.node", NULL));
+
+  /* per-subject iteration keeps insertion order; replaced keys stay in place */
+  iter = wp_metadata_new_iterator (metadata, 7);
+  g_assert_true (wp_iterator_next (iter, &val));
+  wp_metadata_iterator_item_extract (&val, &subject, &key, &type, &value);
+  g_assert_cmpint (subject, ==, 7);
+  g_assert_cmpstr (key, ==, "target.node");
+  g_assert_cmpstr (value, ==, "97");
+  g_value_unset (&val);
+  g_assert_true (wp_iterator_next (iter, &val));
+  wp_metadata_iterator_item_extract (&val, &subject, &key, &type, &value);
+  g_assert_cmpstr (key, ==, "7");
+  g_value_unset (&val);
+
+  /* items returned by an iterator survive removal from the metadata */
+  wp_metadata_set (metadata, 7, NULL, NULL, NULL);
+  g_assert_null (wp_metadata_find (metadata, 7, "target.node", NULL));
+  g_assert_true (wp_iterator_next (iter, &val));
+  wp_metadata_iterator_item_extract (&val, &subject, &key, &type, &value);
+  g_assert_cmpint (subject, ==, 7);
+  g_assert_cmpstr (key, ==, "17");
+  g_assert_cmpstr (value, ==, "17");
+  g_value_unset (&val);
+  g_clear_pointer (&iter, wp_iterator_unref);
+
+  /* removing single keys */
+  wp_metadata_set (metadata, 3, "target.node", NULL, NULL);
+  g_assert_null (wp_metadata_find (metadata, 3, "target.node", NULL));
+  g_assert_cmpstr (wp_metadata_find (metadata, 3, "3", NULL), ==, "3");
+
+  iter = wp_metadata_new_iterator (metadata, PW_ID_ANY);
+  for (; wp_iterator_next (iter, &val); g_value_unset (&val)) {
+    wp_metadata_iterator_item_extract (&val, &subject, NULL, NULL, NULL);
+    g_assert_cmpint (subject, !=, 7);
+    n_items++;
+  }
+  g_assert_cmpuint (n_items, ==, 10 * 11 - 11 - 1);
+  g_clear_pointer (&iter, wp_iterator_unref);
+
+  wp_metadata_clear (metadata);
+  iter = wp_metadata_new_iterator (metadata, PW_ID_ANY);
+  g_assert_false (wp_iterator_next (iter, &val));
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -462,6 +532,8 @@ main (gint argc, gchar *argv[])
 
   g_test_add ("/wp/metadata/basic", TestFixture, NULL,
       test_metadata_setup, test_metadata_basic, test_metadata_teardown);
+  g_test_add ("/wp/metadata/index", TestFixture, NULL,
+      test_metadata_setup, test_metadata_index, test_metadata_teardown);
 
   return g_test_run ();
 }
@@ -0,0 +1,256 @@
+/* WirePlumber
+ *
+ * Copyright © 2023 The WirePlumber project contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+#include <spa/node/node.h>
+#include <spa/node/utils.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/filter.h>
+#include <spa/param/format.h>
+#include <spa/param/audio/raw.h>
+
+/* a server-side node without ports, whose EnumFormat params can change */
+typedef struct {
+  struct spa_node node;
+  struct spa_hook_list hooks;
+  struct spa_node_info info;
+  struct spa_param_info params[1];
+  guint32 formats[4];
+  guint n_formats;
+  struct pw_impl_node *impl;
+} TestNode;
+
+static void
+test_node_emit_info (TestNode *n)
+{
+  n->info.change_mask = SPA_NODE_CHANGE_MASK_PARAMS;
+  spa_node_emit_info (&n->hooks, &n->info);
+  n->info.change_mask = 0;
+}
+
+static int
+test_node_add_listener (void *object, struct spa_hook *listener,
+    const struct spa_node_events *events, void *data)
+{
+  TestNode *n = object;
+  struct spa_hook_list save;
+
+  spa_hook_list_isolate (&n->hooks, &save, listener, events, data);
+  test_node_emit_info (n);
+  spa_hook_list_join (&n->hooks, &save);
+  return 0;
+}
+
+static int
+test_node_set_callbacks (void *object,
+    const struct spa_node_callbacks *callbacks, void *data)
+{
+  return 0;
+}
+
+static int
+test_node_sync (void *object, int seq)
+{
+  TestNode *n = object;
+  spa_node_emit_result (&n->hooks, seq, 0, 0, NULL);
+  return 0;
+}
+
+static int
+test_node_enum_params (void *object, int seq, uint32_t id, uint32_t start,
+    uint32_t num, const struct spa_pod *filter)
+{
+  TestNode *n = object;
+  struct spa_result_node_params result = { .id = id, .next = start };
+  guint32 count = 0;
+
+  if (id != SPA_PARAM_EnumFormat)
+    return -ENOENT;
+
+  while (count < num && result.next < n->n_formats) {
+    guint8 buffer[1024];
+    struct spa_pod_builder b = SPA_POD_BUILDER_INIT (buffer, sizeof (buffer));
+    struct spa_pod *param;
+
+    result.index = result.next++;
+    param = spa_pod_builder_add_object (&b,
+        SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+        SPA_FORMAT_mediaType, SPA_POD_Id (SPA_MEDIA_TYPE_audio),
+        SPA_FORMAT_mediaSubtype, SPA_POD_Id (SPA_MEDIA_SUBTYPE_raw),
+        SPA_FORMAT_AUDIO_format, SPA_POD_Id (n->formats[result.index]));
+    if (spa_pod_filter (&b, &result.param, param, filter) < 0)
+      continue;
+
+    spa_node_emit_result (&n->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS,
+        &result);
+    count++;
+  }
+  return 0;
+}
+
+static const struct spa_node_methods test_node_methods = {
+  SPA_VERSION_NODE_METHODS,
+  .add_listener = test_node_add_listener,
+  .set_callbacks = test_node_set_callbacks,
+  .sync = test_node_sync,
+  .enum_params = test_node_enum_params,
+};
+
+static void
+test_node_set_formats (TestNode *n, const guint32 *formats, guint n_formats)
+{
+  g_assert_cmpuint (n_formats, <=, G_N_ELEMENTS (n->formats));
+  memcpy (n->formats, formats, n_formats * sizeof (guint32));
+  n->n_formats = n_formats;
+}
+
+static void
+test_node_register (TestNode *n, WpTestServer *server, const gchar *name,
+    const guint32 *formats, guint n_formats)
+{
+  g_autoptr (WpTestServerLocker) lock = wp_test_server_locker_new (server);
+
+  n->node.iface = SPA_INTERFACE_INIT (SPA_TYPE_INTERFACE_Node,
+      SPA_VERSION_NODE, &test_node_methods, n);
+  spa_hook_list_init (&n->hooks);
+  n->info = SPA_NODE_INFO_INIT ();
+  n->params[0] = SPA_PARAM_INFO (SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+  n->info.params = n->params;
+  n->info.n_params = G_N_ELEMENTS (n->params);
+  test_node_set_formats (n, formats, n_formats);
+
+  n->impl = pw_context_create_node (server->context,
+      pw_properties_new (PW_KEY_NODE_NAME, name, NULL), 0);
+  g_assert_nonnull (n->impl);
+  g_assert_cmpint (pw_impl_node_set_implementation (n->impl, &n->node), >=, 0);
+  g_assert_cmpint (pw_impl_node_register (n->impl, NULL), ==, 0);
+}
+
+/* changes the formats and notifies the clients, like SPA plugins do */
+static void
+test_node_change_formats (TestNode *n, WpTestServer *server,
+    const guint32 *formats, guint n_formats)
+{
+  g_autoptr (WpTestServerLocker) lock = wp_test_server_locker_new (server);
+
+  test_node_set_formats (n, formats, n_formats);
+  n->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+  test_node_emit_info (n);
+}
+
+typedef struct {
+  WpBaseTestFixture base;
+  TestNode node_a;
+  TestNode node_b;
+} TestFixture;
+
+static void
+test_node_setup (TestFixture *f, gconstpointer user_data)
+{
+  wp_base_test_fixture_setup (&f->base, 0);
+}
+
+static void
+test_node_teardown (TestFixture *f, gconstpointer user_data)
+{
+  wp_base_test_fixture_teardown (&f->base);
+}
+
+static void
+on_params_changed (WpPipewireObject *object, const gchar *id, TestFixture *f)
+{
+  if (!g_strcmp0 (id, "EnumFormat"))
+    g_main_loop_quit (f->base.loop);
+}
+
+static void
+change_formats_and_wait (TestFixture *f, TestNode *n, WpNode *proxy,
+    const guint32 *formats, guint n_formats)
+{
+  gulong id = g_signal_connect (proxy, "params-changed",
+      G_CALLBACK (on_params_changed), f);
+  test_node_change_formats (n, &f->base.server, formats, n_formats);
+  g_main_loop_run (f->base.loop);
+  g_signal_handler_disconnect (proxy, id);
+}
+
+static void
+test_node_common_format_cache (TestFixture *f, gconstpointer user_data)
+{
+  static const guint32 f32[] = { SPA_AUDIO_FORMAT_F32 };
+  static const guint32 s16[] = { SPA_AUDIO_FORMAT_S16 };
+  static const guint32 f32_s16[] = {
+    SPA_AUDIO_FORMAT_F32, SPA_AUDIO_FORMAT_S16
+  };
+  g_autoptr (WpObjectManager) om = NULL;
+  g_autoptr (WpNode) a = NULL;
+  g_autoptr (WpNode) b = NULL;
+
+  test_node_register (&f->node_a, &f->base.server, "test-node-a",
+      f32, G_N_ELEMENTS (f32));
+  test_node_register (&f->node_b, &f->base.server, "test-node-b",
+      f32_s16, G_N_ELEMENTS (f32_s16));
+
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, WP_TYPE_NODE, NULL);
+  wp_object_manager_request_object_features (om, WP_TYPE_NODE,
+      WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL |
+      WP_PIPEWIRE_OBJECT_FEATURE_PARAM_FORMAT);
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+
+  a = wp_object_manager_lookup (om, WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_NODE_NAME, "=s", "test-node-a",
+      NULL);
+  b = wp_object_manager_lookup (om, WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_NODE_NAME, "=s", "test-node-b",
+      NULL);
+  g_assert_nonnull (a);
+  g_assert_nonnull (b);
+
+  /* F32 is common; asking again gives the cached answer */
+  g_assert_true (wp_node_has_common_format (a, b, FALSE));
+  g_assert_true (wp_node_has_common_format (a, b, FALSE));
+  g_assert_true (wp_node_has_common_format (b, a, FALSE));
+  /* all the formats are raw */
+  g_assert_false (wp_node_has_common_format (a, b, TRUE));
+
+  /* the other node changes: no common format any more */
+  change_formats_and_wait (f, &f->node_b, b, s16, G_N_ELEMENTS (s16));
+  g_assert_false (wp_node_has_common_format (a, b, FALSE));
+  g_assert_false (wp_node_has_common_format (a, b, FALSE));
+  g_assert_false (wp_node_has_common_format (b, a, FALSE));
+
+  /* this node changes: S16 is common again */
+  change_formats_and_wait (f, &f->node_a, a, s16, G_N_ELEMENTS (s16));
+  g_assert_true (wp_node_has_common_format (a, b, FALSE));
+  g_assert_true (wp_node_has_common_format (b, a, FALSE));
+
+  /* the other node goes away; its params are dropped with its proxy */
+  g_signal_connect_swapped (b, "pw-proxy-destroyed",
+      G_CALLBACK (g_main_loop_quit), f->base.loop);
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+    g_clear_pointer (&f->node_b.impl, pw_impl_node_destroy);
+  }
+  g_main_loop_run (f->base.loop);
+
+  g_assert_false (wp_node_has_common_format (a, b, FALSE));
+  g_assert_false (wp_node_has_common_format (b, a, FALSE));
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/wp/node/common-format-cache", TestFixture, NULL,
+      test_node_setup, test_node_common_format_cache, test_node_teardown);
+
+  return g_test_run ();
+}
@@ -7,6 +7,7 @@
  */
 
 #include <wp/wp.h>
+#include <stdlib.h>
 
 enum {
   PROP_0,
@@ -871,6 +872,106 @@ test_object_interest_validate (TestFixture * f, gconstpointer data)
   TEST_EXPECT_VALIDATION_ERROR (i);
 }
 
+#define BENCH_N_PROPS 10000
+
+/* matching as it was done before interests were compiled: the constraint
+   values are unpacked from the GVariant and the pattern is compiled again
+   on every call */
+static gboolean
+bench_reference_matches (WpProperties * props, GVariant * roles,
+    GVariant * range)
+{
+  const gchar *media_class = wp_properties_get (props, "media.class");
+  const gchar *role = wp_properties_get (props, "media.role");
+  const gchar *id = wp_properties_get (props, "object.id");
+  GVariantIter iter;
+  GVariant *child;
+  gboolean found = FALSE;
+  gint32 min, max, val;
+
+  if (!media_class || !g_pattern_match_simple ("Audio/*", media_class))
+    return FALSE;
+
+  if (!role)
+    return FALSE;
+  g_variant_iter_init (&iter, roles);
+  while (!found && (child = g_variant_iter_next_value (&iter))) {
+    found = !g_strcmp0 (g_variant_get_string (child, NULL), role);
+    g_variant_unref (child);
+  }
+  if (!found)
+    return FALSE;
+
+  if (!id)
+    return FALSE;
+  g_variant_get (range, "(ii)", &min, &max);
+  val = strtol (id, NULL, 10);
+  return (val >= min && val <= max);
+}
+
+static void
+test_object_interest_benchmark (TestFixture * f, gconstpointer data)
+{
+  static const gchar *media_classes[] = {
+    "Audio/Sink", "Audio/Source", "Stream/Output/Audio", "Video/Source",
+  };
+  static const gchar *roles[] = {
+    "Music", "Movie", "Game", "Notification", "Phone",
+  };
+  g_autoptr (GPtrArray) props = NULL;
+  g_autoptr (WpObjectInterest) i = NULL;
+  g_autoptr (GVariant) roles_list = NULL;
+  g_autoptr (GVariant) range = NULL;
+  guint n_compiled = 0, n_reference = 0;
+  gint64 start, compiled_time, reference_time;
+
+  props = g_ptr_array_new_with_free_func ((GDestroyNotify) wp_properties_unref);
+  for (guint n = 0; n < BENCH_N_PROPS; n++) {
+    WpProperties *p = wp_properties_new (
+        "media.class", media_classes[n % G_N_ELEMENTS (media_classes)],
+        "media.role", roles[n % G_N_ELEMENTS (roles)],
+        NULL);
+    wp_properties_setf (p, "object.id", "%u", n);
+    wp_properties_setf (p, "node.name", "test-node-%u", n);
+    g_ptr_array_add (props, p);
+  }
+
+  i = wp_object_interest_new (WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "#s", "Audio/*",
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.role", "c(sss)",
+          "Music", "Movie", "Game",
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "object.id", "~(ii)", 100, 8000,
+      NULL);
+  g_assert_true (wp_object_interest_validate (i, NULL));
+
+  roles_list = g_variant_ref_sink (
+      g_variant_new ("(sss)", "Music", "Movie", "Game"));
+  range = g_variant_ref_sink (g_variant_new ("(ii)", 100, 8000));
+
+  start = g_get_monotonic_time ();
+  for (guint n = 0; n < props->len; n++) {
+    if (wp_object_interest_matches_full (i, 0, WP_TYPE_NODE, NULL, NULL,
+            g_ptr_array_index (props, n)) == WP_INTEREST_MATCH_ALL)
+      n_compiled++;
+  }
+  compiled_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  for (guint n = 0; n < props->len; n++) {
+    if (bench_reference_matches (g_ptr_array_index (props, n), roles_list,
+            range))
+      n_reference++;
+  }
+  reference_time = g_get_monotonic_time () - start;
+
+  g_assert_cmpuint (n_compiled, ==, n_reference);
+  g_assert_cmpuint (n_compiled, >, 0);
+
+  g_test_message ("matched %u of %u properties; compiled: %" G_GINT64_FORMAT
+      " us, reference: %" G_GINT64_FORMAT " us", n_compiled, props->len,
+      compiled_time, reference_time);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -931,5 +1032,12 @@ main (int argc, char *argv[])
       test_object_interest_validate,
       test_object_interest_teardown);
 
+  if (g_test_perf ())
+    g_test_add ("/wp/object-interest/perf/benchmark",
+        TestFixture, NULL,
+        test_object_interest_setup,
+        test_object_interest_benchmark,
+        test_object_interest_teardown);
+
   return g_test_run ();
 }
@@ -158,6 +158,699 @@ test_om_iterate_remove (TestFixture *f, gconstpointer user_data)
       WP_CONSTRAINT_TYPE_PW_PROPERTY, "property1", "=s", "1234", NULL));
 }
 
+static void
+test_om_dispatch_index (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om_sink = NULL;
+  g_autoptr (WpObjectManager) om_source = NULL;
+  g_autoptr (WpObjectManager) om_all = NULL;
+  g_autoptr (WpObjectManager) om_late = NULL;
+  WpSessionItem *si = NULL;
+
+  /* install the managers before any objects exist */
+  om_sink = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_sink, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "=s", "Audio/Sink",
+      NULL);
+  wp_core_install_object_manager (f->base.core, om_sink);
+
+  om_source = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_source, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "=s", "Audio/Source",
+      NULL);
+  wp_core_install_object_manager (f->base.core, om_source);
+
+  om_all = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_all, si_dummy_get_type (), NULL);
+  wp_core_install_object_manager (f->base.core, om_all);
+
+  /* this one gets its interests after it is installed */
+  om_late = wp_object_manager_new ();
+  wp_core_install_object_manager (f->base.core, om_late);
+
+  si = g_object_new (si_dummy_get_type (), "core", f->base.core, NULL);
+  g_assert_true (wp_session_item_configure (si,
+      wp_properties_new ("media.class", "Audio/Sink", NULL)));
+  wp_session_item_register (si);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_sink), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_source), ==, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_all), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_late), ==, 0);
+
+  /* two interests on the same manager must add the object only once */
+  wp_object_manager_add_interest (om_late, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "=s", "Audio/Source",
+      NULL);
+  wp_object_manager_add_interest (om_late, si_dummy_get_type (), NULL);
+
+  si = g_object_new (si_dummy_get_type (), "core", f->base.core, NULL);
+  g_assert_true (wp_session_item_configure (si,
+      wp_properties_new ("media.class", "Audio/Source", NULL)));
+  wp_session_item_register (si);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_sink), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_source), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_all), ==, 2);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_late), ==, 1);
+
+  /* objects without the indexed property only reach unkeyed interests */
+  si = g_object_new (si_dummy_get_type (), "core", f->base.core, NULL);
+  g_assert_true (wp_session_item_configure (si,
+      wp_properties_new ("property1", "1234", NULL)));
+  wp_session_item_register (si);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_sink), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_source), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_all), ==, 3);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_late), ==, 2);
+}
+
+static void
+test_om_id_lookup (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = NULL;
+  g_autoptr (WpMetadata) m1 = NULL;
+  g_autoptr (WpMetadata) m2 = NULL;
+  g_autoptr (WpMetadata) found = NULL;
+  g_autoptr (WpProperties) props = NULL;
+  g_autofree gchar *serial_str = NULL;
+  WpSessionItem *si = NULL;
+  guint32 id;
+
+  /* export two metadata objects */
+  m1 = WP_METADATA (wp_impl_metadata_new (f->base.client_core));
+  wp_object_activate (WP_OBJECT (m1), WP_OBJECT_FEATURES_ALL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  m2 = WP_METADATA (wp_impl_metadata_new (f->base.client_core));
+  wp_object_activate (WP_OBJECT (m2), WP_OBJECT_FEATURES_ALL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  /* session items are never indexed; they must still be found */
+  si = g_object_new (si_dummy_get_type (), "core", f->base.core, NULL);
+  g_assert_true (wp_session_item_configure (si,
+      wp_properties_new ("object.serial", "4000000000", NULL)));
+  wp_session_item_register (si);
+
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, WP_TYPE_METADATA, NULL);
+  wp_object_manager_add_interest (om, si_dummy_get_type (), NULL);
+  wp_object_manager_request_object_features (om, WP_TYPE_METADATA,
+      WP_OBJECT_FEATURES_ALL);
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 3);
+
+  /* look up the second metadata by bound-id, in all the supported forms */
+  id = wp_proxy_get_bound_id (WP_PROXY (m2));
+  found = wp_object_manager_lookup (om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", id, NULL);
+  g_assert_nonnull (found);
+  g_assert_cmpuint (wp_proxy_get_bound_id (WP_PROXY (found)), ==, id);
+  g_clear_object (&found);
+
+  found = wp_object_manager_lookup (om, G_TYPE_OBJECT,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=x", (gint64) id, NULL);
+  g_assert_nonnull (found);
+  g_assert_cmpuint (wp_proxy_get_bound_id (WP_PROXY (found)), ==, id);
+
+  /* and by serial */
+  props = wp_global_proxy_get_global_properties (WP_GLOBAL_PROXY (found));
+  serial_str = g_strdup (wp_properties_get (props, PW_KEY_OBJECT_SERIAL));
+  g_assert_nonnull (serial_str);
+  g_clear_object (&found);
+
+  found = wp_object_manager_lookup (om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "object.serial", "=s", serial_str,
+      NULL);
+  g_assert_nonnull (found);
+  g_assert_cmpuint (wp_proxy_get_bound_id (WP_PROXY (found)), ==, id);
+  g_clear_object (&found);
+
+  /* other constraints are still checked on the indexed object */
+  g_assert_null (wp_object_manager_lookup (om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", id,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "object.serial", "=s", "0",
+      NULL));
+  g_assert_null (wp_object_manager_lookup (om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", 123456, NULL));
+
+  found = wp_object_manager_lookup (om, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "object.serial", "=s",
+      "4000000000", NULL);
+  g_assert_true (found == (gpointer) si);
+  g_clear_object (&found);
+
+  /* removed objects disappear from the index */
+  g_signal_connect_swapped (om, "object-removed",
+      G_CALLBACK (g_main_loop_quit), f->base.loop);
+  g_clear_object (&m2);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 2);
+  g_assert_null (wp_object_manager_lookup (om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", id, NULL));
+
+  id = wp_proxy_get_bound_id (WP_PROXY (m1));
+  found = wp_object_manager_lookup (om, WP_TYPE_METADATA,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", id, NULL);
+  g_assert_nonnull (found);
+  g_clear_object (&found);
+
+  wp_session_item_remove (si);
+  g_assert_null (wp_object_manager_lookup (om, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "object.serial", "=s",
+      "4000000000", NULL));
+}
+
+typedef struct {
+  guint added;
+  guint removed;
+} ObjectCounts;
+
+static void
+on_object_added_count (WpObjectManager *om, GObject *object,
+    ObjectCounts *counts)
+{
+  counts->added++;
+}
+
+static void
+on_object_removed_count (WpObjectManager *om, GObject *object,
+    ObjectCounts *counts)
+{
+  counts->removed++;
+}
+
+static WpObjectManager *
+new_counting_om (ObjectCounts *counts)
+{
+  WpObjectManager *om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "=s", "Audio/Sink",
+      NULL);
+  g_signal_connect (om, "object-added",
+      G_CALLBACK (on_object_added_count), counts);
+  g_signal_connect (om, "object-removed",
+      G_CALLBACK (on_object_removed_count), counts);
+  return om;
+}
+
+static void
+on_object_added_remove (WpObjectManager *om, WpSessionItem *si,
+    gpointer data)
+{
+  if (!g_strcmp0 (wp_session_item_get_property (si, "test.remove"), "yes"))
+    wp_session_item_remove (si);
+}
+
+static WpSessionItem *
+register_si_dummy (WpCore *core, const gchar *media_class,
+    const gchar *remove)
+{
+  WpSessionItem *si = g_object_new (si_dummy_get_type (), "core", core, NULL);
+  g_assert_true (wp_session_item_configure (si,
+      wp_properties_new ("media.class", media_class, "test.remove", remove,
+          NULL)));
+  wp_session_item_register (si);
+  return si;
+}
+
+static void
+test_om_shared_store (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om_a = NULL;
+  g_autoptr (WpObjectManager) om_b = NULL;
+  g_autoptr (WpObjectManager) om_late = NULL;
+  ObjectCounts counts_a = { 0 }, counts_b = { 0 }, counts_late = { 0 };
+  WpSessionItem *si1, *si2;
+
+  /* identical managers share their objects, but not their signals */
+  om_a = new_counting_om (&counts_a);
+  g_signal_connect (om_a, "object-added",
+      G_CALLBACK (on_object_added_remove), NULL);
+  test_ensure_object_manager_is_installed (om_a, f->base.core, f->base.loop);
+  om_b = new_counting_om (&counts_b);
+  test_ensure_object_manager_is_installed (om_b, f->base.core, f->base.loop);
+
+  si1 = register_si_dummy (f->base.core, "Audio/Sink", "no");
+  register_si_dummy (f->base.core, "Audio/Source", "no");
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_a), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), ==, 1);
+  g_assert_cmpuint (counts_a.added, ==, 1);
+  g_assert_cmpuint (counts_b.added, ==, 1);
+
+  /* an object that is removed while object-added is emitted on om_a is
+     never announced on om_b */
+  register_si_dummy (f->base.core, "Audio/Sink", "yes");
+  g_assert_cmpuint (counts_a.added, ==, 2);
+  g_assert_cmpuint (counts_a.removed, ==, 1);
+  g_assert_cmpuint (counts_b.added, ==, 1);
+  g_assert_cmpuint (counts_b.removed, ==, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), ==, 1);
+
+  /* a manager that is installed later gets the existing objects at once */
+  om_late = new_counting_om (&counts_late);
+  g_signal_connect_swapped (om_late, "installed",
+      G_CALLBACK (g_main_loop_quit), f->base.loop);
+  wp_core_install_object_manager (f->base.core, om_late);
+  g_assert_cmpuint (counts_late.added, ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_late), ==, 1);
+  g_main_loop_run (f->base.loop);
+
+  /* a manager that changes its interests does not affect the others */
+  wp_object_manager_add_interest (om_b, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "=s",
+      "Audio/Source", NULL);
+  si2 = register_si_dummy (f->base.core, "Audio/Source", "no");
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_a), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), ==, 2);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_late), ==, 1);
+
+  /* removals reach all of them */
+  wp_session_item_remove (si1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_a), ==, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), ==, 1);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_late), ==, 0);
+  g_assert_cmpuint (counts_a.removed, ==, 2);
+  g_assert_cmpuint (counts_b.removed, ==, 1);
+  g_assert_cmpuint (counts_late.removed, ==, 1);
+
+  /* the store outlives the first manager that used it */
+  g_clear_object (&om_a);
+  register_si_dummy (f->base.core, "Audio/Sink", "no");
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_late), ==, 1);
+  g_assert_cmpuint (counts_late.added, ==, 2);
+
+  wp_session_item_remove (si2);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), ==, 1);
+}
+
+#define N_DETACH_OBJECTS 200
+
+typedef struct {
+  TestFixture *f;
+  WpObjectManager *om_a;
+  WpObjectManager *om_b;
+  guint added_a;
+  guint added_b;
+} DetachData;
+
+static void
+on_object_added_detach (WpObjectManager *om, GObject *object, DetachData *d)
+{
+  if (om == d->om_a && d->added_a++ == 0) {
+    /* the other objects are still being prepared or exposed */
+    wp_object_manager_add_interest (d->om_b, si_dummy_get_type (), NULL);
+  }
+  if (om == d->om_b)
+    d->added_b++;
+
+  if (d->added_a >= N_DETACH_OBJECTS && d->added_b >= N_DETACH_OBJECTS)
+    g_main_loop_quit (d->f->base.loop);
+}
+
+static void
+test_om_shared_store_detach (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (GPtrArray) objects = g_ptr_array_new_with_free_func (
+      g_object_unref);
+  g_autoptr (WpObjectManager) om_a = NULL;
+  g_autoptr (WpObjectManager) om_b = NULL;
+  DetachData d = { f, NULL, NULL, 0, 0 };
+
+  /* identical managers, which share their store */
+  om_a = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_a, WP_TYPE_METADATA, NULL);
+  wp_object_manager_request_object_features (om_a, WP_TYPE_METADATA,
+      WP_PROXY_FEATURE_BOUND);
+  test_ensure_object_manager_is_installed (om_a, f->base.core, f->base.loop);
+
+  om_b = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_b, WP_TYPE_METADATA, NULL);
+  wp_object_manager_request_object_features (om_b, WP_TYPE_METADATA,
+      WP_PROXY_FEATURE_BOUND);
+  test_ensure_object_manager_is_installed (om_b, f->base.core, f->base.loop);
+
+  d.om_a = om_a;
+  d.om_b = om_b;
+  g_signal_connect (om_a, "object-added",
+      G_CALLBACK (on_object_added_detach), &d);
+  g_signal_connect (om_b, "object-added",
+      G_CALLBACK (on_object_added_detach), &d);
+
+  /* om_b leaves the shared store when the first of these appears;
+     it must still get all of them */
+  for (guint i = 0; i < N_DETACH_OBJECTS; i++) {
+    WpImplMetadata *m = wp_impl_metadata_new (f->base.client_core);
+    g_ptr_array_add (objects, m);
+    wp_object_activate (WP_OBJECT (m), WP_OBJECT_FEATURES_ALL, NULL,
+        NULL, NULL);
+  }
+  g_main_loop_run (f->base.loop);
+
+  g_assert_cmpuint (d.added_a, ==, N_DETACH_OBJECTS);
+  g_assert_cmpuint (d.added_b, ==, N_DETACH_OBJECTS);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_a), ==,
+      N_DETACH_OBJECTS);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om_b), ==,
+      N_DETACH_OBJECTS);
+}
+
+typedef struct {
+  guint n_batches;
+  GPtrArray *last;
+} ObjectBatches;
+
+static void
+on_objects_batch (WpObjectManager *om, GPtrArray *objects,
+    ObjectBatches *batches)
+{
+  g_assert_cmpuint (objects->len, >, 0);
+  batches->n_batches++;
+  g_clear_pointer (&batches->last, g_ptr_array_unref);
+  batches->last = g_ptr_array_ref (objects);
+}
+
+static void
+test_om_batched_signals (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = NULL;
+  ObjectBatches added = { 0 }, removed = { 0 };
+  WpSessionItem *si[3], *si_gone;
+
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "=s", "Audio/Sink",
+      NULL);
+  g_signal_connect (om, "objects-added",
+      G_CALLBACK (on_objects_batch), &added);
+  g_signal_connect (om, "objects-removed",
+      G_CALLBACK (on_objects_batch), &removed);
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+  g_signal_connect_swapped (om, "objects-changed",
+      G_CALLBACK (g_main_loop_quit), f->base.loop);
+
+  /* all the objects of a pass are delivered together, in order; an object
+     that is removed before the emission is not delivered at all */
+  for (guint i = 0; i < G_N_ELEMENTS (si); i++)
+    si[i] = register_si_dummy (f->base.core, "Audio/Sink", "no");
+  register_si_dummy (f->base.core, "Audio/Source", "no");
+  si_gone = register_si_dummy (f->base.core, "Audio/Sink", "no");
+  wp_session_item_remove (si_gone);
+  g_assert_cmpuint (added.n_batches, ==, 0);
+
+  g_main_loop_run (f->base.loop);
+  g_assert_cmpuint (added.n_batches, ==, 1);
+  g_assert_cmpuint (removed.n_batches, ==, 0);
+  g_assert_cmpuint (added.last->len, ==, 3);
+  for (guint i = 0; i < G_N_ELEMENTS (si); i++)
+    g_assert_true (g_ptr_array_index (added.last, i) == si[i]);
+
+  /* and so are removals */
+  wp_session_item_remove (si[0]);
+  wp_session_item_remove (si[2]);
+  g_main_loop_run (f->base.loop);
+  g_assert_cmpuint (added.n_batches, ==, 1);
+  g_assert_cmpuint (removed.n_batches, ==, 1);
+  g_assert_cmpuint (removed.last->len, ==, 2);
+  g_assert_true (g_ptr_array_index (removed.last, 0) == si[0]);
+  g_assert_true (g_ptr_array_index (removed.last, 1) == si[2]);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, 1);
+
+  g_clear_pointer (&added.last, g_ptr_array_unref);
+  g_clear_pointer (&removed.last, g_ptr_array_unref);
+}
+
+static guint
+count_matching (WpObjectManager *om, WpObjectInterest *interest)
+{
+  g_autoptr (WpIterator) it =
+      wp_object_manager_new_filtered_iterator_full (om, interest);
+  g_auto (GValue) value = G_VALUE_INIT;
+  guint n = 0;
+
+  for (; wp_iterator_next (it, &value); g_value_unset (&value))
+    n++;
+  return n;
+}
+
+static void
+test_om_prop_index (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = NULL;
+  g_autoptr (WpObjectManager) om_plain = NULL;
+  g_autoptr (WpSessionItem) found = NULL;
+  WpSessionItem *si[4];
+  const gchar *names[] = { "foo", "bar", "baz", "foo" };
+  const gchar *ids[] = { "42", "042", "7", "abc" };
+
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, si_dummy_get_type (), NULL);
+  wp_object_manager_add_index (om, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "node.name");
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+
+  /* the same, without indexes, to compare results; the interest differs,
+     so that it does not share the objects (and the indexes) of om */
+  om_plain = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_plain, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "node.name", "+", NULL);
+  test_ensure_object_manager_is_installed (om_plain, f->base.core,
+      f->base.loop);
+
+  for (guint i = 0; i < G_N_ELEMENTS (si); i++) {
+    si[i] = g_object_new (si_dummy_get_type (), "core", f->base.core, NULL);
+    g_assert_true (wp_session_item_configure (si[i],
+        wp_properties_new ("node.name", names[i], "device.id", ids[i], NULL)));
+    wp_session_item_register (si[i]);
+  }
+
+  /* an index added when there are objects already */
+  wp_object_manager_add_index (om, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "device.id");
+
+#define ASSERT_COUNT(n, ...) G_STMT_START { \
+    g_assert_cmpuint (count_matching (om, wp_object_interest_new ( \
+        si_dummy_get_type (), __VA_ARGS__, NULL)), ==, n); \
+    g_assert_cmpuint (count_matching (om_plain, wp_object_interest_new ( \
+        si_dummy_get_type (), __VA_ARGS__, NULL)), ==, n); \
+  } G_STMT_END
+
+  ASSERT_COUNT (2, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "node.name", "=s", "foo");
+  ASSERT_COUNT (0, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "node.name", "=s", "none");
+  ASSERT_COUNT (1, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "node.name", "=s", "foo",
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "device.id", "=s", "abc");
+
+  /* numbers match properties that hold them in any form */
+  ASSERT_COUNT (1, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "device.id", "=s", "42");
+  ASSERT_COUNT (2, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "device.id", "=i", 42);
+  ASSERT_COUNT (1, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "device.id", "=x", (gint64) 7);
+  ASSERT_COUNT (1, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "device.id", "=u", 0);
+
+  /* the first match is the first object that was added */
+  found = wp_object_manager_lookup (om, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "node.name", "=s", "foo", NULL);
+  g_assert_true (found == si[0]);
+  g_clear_object (&found);
+
+  /* property changes update the index */
+  wp_session_item_set_properties (si[2],
+      wp_properties_new ("node.name", "foo", NULL));
+  ASSERT_COUNT (3, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "node.name", "=s", "foo");
+  ASSERT_COUNT (0, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "node.name", "=s", "baz");
+  ASSERT_COUNT (0, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "device.id", "=i", 7);
+
+  /* and so do removals */
+  wp_session_item_remove (si[0]);
+  ASSERT_COUNT (2, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "node.name", "=s", "foo");
+  ASSERT_COUNT (1, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      "device.id", "=i", 42);
+
+  found = wp_object_manager_lookup (om, si_dummy_get_type (),
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "node.name", "=s", "foo", NULL);
+  g_assert_true (found == si[2] || found == si[3]);
+
+#undef ASSERT_COUNT
+}
+
+/* enough objects to need more than one time slice to expose them all */
+#define N_SLICED_OBJECTS 1000
+
+typedef struct {
+  GMainLoop *loop;
+  guint n_pending;
+} PendingActivations;
+
+static void
+on_activated_count (WpObject *object, GAsyncResult *res,
+    PendingActivations *p)
+{
+  g_autoptr (GError) error = NULL;
+  g_assert_true (wp_object_activate_finish (object, res, &error));
+  g_assert_no_error (error);
+
+  if (--p->n_pending == 0)
+    g_main_loop_quit (p->loop);
+}
+
+typedef struct {
+  guint n_added;
+  guint32 last_id;
+  gboolean installed;
+  /* objects-changed emissions before all the objects were exposed */
+  guint n_changed_early;
+} ExposeOrder;
+
+static void
+on_object_added_in_order (WpObjectManager *om, WpProxy *proxy,
+    ExposeOrder *order)
+{
+  guint32 id = wp_proxy_get_bound_id (proxy);
+
+  g_assert_false (order->installed);
+  g_assert_cmpuint (id, >, order->last_id);
+  order->last_id = id;
+  order->n_added++;
+}
+
+static void
+on_objects_changed_in_order (WpObjectManager *om, ExposeOrder *order)
+{
+  if (order->n_added < N_SLICED_OBJECTS)
+    order->n_changed_early++;
+}
+
+static void
+on_installed_in_order (WpObjectManager *om, ExposeOrder *order)
+{
+  g_assert_cmpuint (order->n_added, ==, N_SLICED_OBJECTS);
+  order->installed = TRUE;
+}
+
+/* sums up the buckets of the published expose stall histogram */
+static guint64
+count_expose_slices (const gchar *histogram)
+{
+  g_auto (GStrv) buckets = g_strsplit (histogram, " ", -1);
+  guint64 n = 0;
+
+  for (guint i = 0; buckets[i]; i++) {
+    const gchar *count = strchr (buckets[i], ':');
+    g_assert_nonnull (count);
+    n += g_ascii_strtoull (count + 1, NULL, 10);
+  }
+  return n;
+}
+
+static gboolean
+quit_loop (GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+test_om_sliced_expose (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (GPtrArray) objects = g_ptr_array_new_with_free_func (
+      g_object_unref);
+  g_autoptr (WpCore) core = NULL;
+  g_autoptr (WpObjectManager) om = NULL;
+  g_autoptr (WpObjectManager) om_daemon = NULL;
+  g_autoptr (WpPipewireObject) daemon = NULL;
+  g_autoptr (WpProperties) props = NULL;
+  PendingActivations pending = { f->base.loop, N_SLICED_OBJECTS };
+  ExposeOrder order = { 0 };
+  const gchar *histogram;
+
+  /* export the objects before the core that watches them connects */
+  for (guint i = 0; i < N_SLICED_OBJECTS; i++) {
+    WpImplMetadata *m = wp_impl_metadata_new (f->base.client_core);
+    g_ptr_array_add (objects, m);
+    wp_object_activate (WP_OBJECT (m), WP_OBJECT_FEATURES_ALL, NULL,
+        (GAsyncReadyCallback) on_activated_count, &pending);
+  }
+  g_main_loop_run (f->base.loop);
+
+  /* a daemon core, which publishes its registry counters; all the
+     objects appear on its registry at once, when it connects */
+  core = wp_core_new (f->base.context, wp_properties_new (
+          PW_KEY_REMOTE_NAME, f->base.server.name,
+          "wireplumber.daemon", "true",
+          NULL));
+
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, WP_TYPE_METADATA, NULL);
+  wp_object_manager_request_object_features (om, WP_TYPE_METADATA,
+      WP_PROXY_FEATURE_BOUND);
+  g_signal_connect (om, "object-added",
+      G_CALLBACK (on_object_added_in_order), &order);
+  g_signal_connect (om, "installed",
+      G_CALLBACK (on_installed_in_order), &order);
+  g_signal_connect (om, "objects-changed",
+      G_CALLBACK (on_objects_changed_in_order), &order);
+  wp_core_install_object_manager (core, om);
+
+  g_assert_true (wp_core_connect (core));
+  g_signal_connect_swapped (om, "installed",
+      G_CALLBACK (g_main_loop_quit), f->base.loop);
+  g_main_loop_run (f->base.loop);
+
+  g_assert_true (order.installed);
+  /* proxies of the first slices became ready between slices, which
+     must not have made the manager report 'installed' early */
+  g_assert_cmpuint (order.n_changed_early, >, 0);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==,
+      N_SLICED_OBJECTS);
+
+  /* the counters are published at most once per second */
+  wp_core_timeout_add (core, NULL, 1500, (GSourceFunc) quit_loop,
+      f->base.loop, NULL);
+  g_main_loop_run (f->base.loop);
+  wp_core_sync (core, NULL, (GAsyncReadyCallback) test_core_done_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  /* read them the way wpctl does */
+  om_daemon = wp_object_manager_new ();
+  wp_object_manager_add_interest (om_daemon, WP_TYPE_CLIENT,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "wireplumber.daemon", "=s", "true",
+      NULL);
+  wp_object_manager_request_object_features (om_daemon, WP_TYPE_CLIENT,
+      WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+  test_ensure_object_manager_is_installed (om_daemon, f->base.client_core,
+      f->base.loop);
+
+  daemon = wp_object_manager_lookup (om_daemon, WP_TYPE_CLIENT, NULL);
+  g_assert_nonnull (daemon);
+  props = wp_pipewire_object_get_properties (daemon);
+
+  histogram = wp_properties_get (props, "wireplumber.registry.expose-stalls");
+  g_assert_nonnull (histogram);
+  g_assert_cmpuint (count_expose_slices (histogram), >, 1);
+  g_assert_nonnull (
+      wp_properties_get (props, "wireplumber.registry.expose-stall-max"));
+
+  g_clear_object (&om);
+  wp_core_disconnect (core);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -168,6 +861,20 @@ main (gint argc, gchar *argv[])
       test_om_setup, test_om_interest_on_pw_props, test_om_teardown);
   g_test_add ("/wp/om/iterate_remove", TestFixture, NULL,
       test_om_setup, test_om_iterate_remove, test_om_teardown);
+  g_test_add ("/wp/om/dispatch-index", TestFixture, NULL,
+      test_om_setup, test_om_dispatch_index, test_om_teardown);
+  g_test_add ("/wp/om/id-lookup", TestFixture, NULL,
+      test_om_setup, test_om_id_lookup, test_om_teardown);
+  g_test_add ("/wp/om/prop-index", TestFixture, NULL,
+      test_om_setup, test_om_prop_index, test_om_teardown);
+  g_test_add ("/wp/om/shared-store", TestFixture, NULL,
+      test_om_setup, test_om_shared_store, test_om_teardown);
+  g_test_add ("/wp/om/shared-store-detach", TestFixture, NULL,
+      test_om_setup, test_om_shared_store_detach, test_om_teardown);
+  g_test_add ("/wp/om/batched-signals", TestFixture, NULL,
+      test_om_setup, test_om_batched_signals, test_om_teardown);
+  g_test_add ("/wp/om/sliced-expose", TestFixture, NULL,
+      test_om_setup, test_om_sliced_expose, test_om_teardown);
 
   return g_test_run ();
 }
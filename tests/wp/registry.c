@@ -0,0 +1,96 @@
+/* WirePlumber
+ *
+ * Copyright © 2023 The WirePlumber project contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+
+#define N_GLOBALS 5000
+
+typedef struct {
+  WpBaseTestFixture base;
+  GPtrArray *metadata;
+  guint n_added;
+} TestFixture;
+
+static void
+test_registry_setup (TestFixture *self, gconstpointer user_data)
+{
+  wp_base_test_fixture_setup (&self->base, WP_BASE_TEST_FLAG_DONT_CONNECT);
+  self->metadata = g_ptr_array_new ();
+}
+
+static void
+test_registry_teardown (TestFixture *self, gconstpointer user_data)
+{
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&self->base.server);
+
+    for (guint i = 0; i < self->metadata->len; i++)
+      pw_impl_metadata_destroy (g_ptr_array_index (self->metadata, i));
+  }
+  g_clear_pointer (&self->metadata, g_ptr_array_unref);
+
+  wp_base_test_fixture_teardown (&self->base);
+}
+
+static void
+on_object_added (WpObjectManager *om, WpMetadata *metadata, TestFixture *f)
+{
+  if (++f->n_added == N_GLOBALS)
+    g_main_loop_quit (f->base.loop);
+}
+
+static void
+test_registry_startup (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = NULL;
+  gint64 start, elapsed;
+
+  /* create the globals on the server before connecting, so that they all
+     arrive in the initial burst of the registry, like on startup */
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    for (guint i = 0; i < N_GLOBALS; i++) {
+      g_autofree gchar *name = g_strdup_printf ("test-metadata-%u", i);
+      struct pw_impl_metadata *m = pw_context_create_metadata (
+          f->base.server.context, name, NULL, 0);
+      g_assert_nonnull (m);
+      g_assert_cmpint (pw_impl_metadata_register (m, NULL), ==, 0);
+      g_ptr_array_add (f->metadata, m);
+    }
+  }
+
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, WP_TYPE_METADATA, NULL);
+  g_signal_connect (om, "object-added", G_CALLBACK (on_object_added), f);
+  wp_core_install_object_manager (f->base.core, om);
+
+  start = g_get_monotonic_time ();
+  g_assert_true (wp_core_connect (f->base.core));
+  g_main_loop_run (f->base.loop);
+  elapsed = g_get_monotonic_time () - start;
+
+  g_assert_cmpuint (f->n_added, ==, N_GLOBALS);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, N_GLOBALS);
+
+  g_test_message ("%u globals exposed in %" G_GINT64_FORMAT " us",
+      N_GLOBALS, elapsed);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/wp/registry/startup", TestFixture, NULL,
+      test_registry_setup, test_registry_startup, test_registry_teardown);
+
+  return g_test_run ();
+}
@@ -500,6 +500,133 @@ test_spa_pod_object (void)
   }
 }
 
+static void
+test_spa_pod_schema (void)
+{
+  g_autoptr (WpSpaPodSchema) schema = wp_spa_pod_schema_new (
+      "Spa:Pod:Object:Param:Props",
+      "mute", "b",
+      "volume", "?f",
+      "channelVolumes", "?P",
+      "device", "s",
+      "id-01000000", "?i",
+      NULL);
+  g_assert_nonnull (schema);
+  g_assert_cmpuint (wp_spa_pod_schema_get_n_fields (schema), ==, 5);
+  g_assert_cmpstr (wp_spa_id_value_short_name (
+          wp_spa_pod_schema_get_field (schema, 2)), ==, "channelVolumes");
+  g_assert_null (wp_spa_pod_schema_get_field (schema, 4));
+
+  /* all the fields, in any order */
+  {
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+        "Spa:Pod:Object:Param:Props", "Props",
+        "id-01000000", "i", 7,
+        "device", "s", "device-name",
+        "volume", "f", 0.5,
+        "mute", "b", TRUE,
+        NULL);
+    const char *id_name = NULL, *device = NULL;
+    gboolean mute = FALSE;
+    float vol = 0.0;
+    g_autoptr (WpSpaPod) volumes = NULL;
+    gint32 custom = 0;
+
+    g_assert_true (wp_spa_pod_schema_get (schema, pod, &id_name,
+        &mute, &vol, &volumes, &device, &custom));
+    g_assert_cmpstr (id_name, ==, "Props");
+    g_assert_true (mute);
+    g_assert_cmpfloat_with_epsilon (vol, 0.5, 0.01);
+    g_assert_null (volumes);
+    g_assert_cmpstr (device, ==, "device-name");
+    g_assert_cmpint (custom, ==, 7);
+  }
+
+  /* a missing required field fails and leaves the values untouched */
+  {
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+        "Spa:Pod:Object:Param:Props", "Props",
+        "mute", "b", TRUE,
+        "volume", "f", 0.5,
+        NULL);
+    gboolean mute = FALSE;
+    float vol = 0.0;
+    WpSpaPod *volumes = NULL;
+    const char *device = NULL;
+    const char *id_name = NULL;
+    gint32 custom = 0;
+
+    g_assert_false (wp_spa_pod_schema_get (schema, pod, &id_name,
+        &mute, &vol, &volumes, &device, &custom));
+    g_assert_null (id_name);
+    g_assert_false (mute);
+    g_assert_cmpfloat (vol, ==, 0.0);
+  }
+
+  /* objects of other types are not parsed */
+  {
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+        "Spa:Pod:Object:Param:Profile", "Profile",
+        "index", "i", 1,
+        NULL);
+    WpSpaPod *values[5] = { NULL, };
+
+    g_assert_false (wp_spa_pod_schema_get_pods (schema, pod, NULL, values));
+  }
+
+  /* values as pods */
+  {
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+        "Spa:Pod:Object:Param:Props", "Props",
+        "mute", "b", TRUE,
+        NULL);
+    WpSpaPod *values[5] = { NULL, };
+    gboolean mute = FALSE;
+
+    g_assert_true (wp_spa_pod_schema_get_pods (schema, pod, NULL, values));
+    g_assert_nonnull (values[0]);
+    g_assert_true (wp_spa_pod_get_boolean (values[0], &mute));
+    g_assert_true (mute);
+    for (guint i = 1; i < G_N_ELEMENTS (values); i++)
+      g_assert_null (values[i]);
+    wp_spa_pod_unref (values[0]);
+  }
+
+  /* schemas with more fields than fit on the stack */
+  {
+    g_autoptr (WpSpaPodSchema) big = NULL;
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+        "Spa:Pod:Object:Param:Props", "Props",
+        "id-01000000", "i", 0,
+        "id-01000027", "i", 39,
+        NULL);
+    gchar *keys[40];
+    const char *formats[40];
+    WpSpaPod *values[40] = { NULL, };
+    gint32 v = -1;
+
+    for (guint i = 0; i < G_N_ELEMENTS (keys); i++) {
+      keys[i] = g_strdup_printf ("id-%08x", 0x01000000 + i);
+      formats[i] = "?i";
+    }
+    big = wp_spa_pod_schema_new_with_fields ("Spa:Pod:Object:Param:Props",
+        G_N_ELEMENTS (keys), (const char * const *) keys, formats);
+    g_assert_nonnull (big);
+    for (guint i = 0; i < G_N_ELEMENTS (keys); i++)
+      g_free (keys[i]);
+
+    g_assert_true (wp_spa_pod_schema_get_pods (big, pod, NULL, values));
+    g_assert_nonnull (values[0]);
+    g_assert_nonnull (values[39]);
+    g_assert_true (wp_spa_pod_get_int (values[39], &v));
+    g_assert_cmpint (v, ==, 39);
+    for (guint i = 1; i < 39; i++)
+      g_assert_null (values[i]);
+    wp_spa_pod_unref (values[0]);
+    wp_spa_pod_unref (values[39]);
+  }
+}
+
 static void
 test_spa_pod_struct (void)
 {
@@ -1073,6 +1200,190 @@ test_spa_pod_port_config (void)
   g_assert_nonnull (pod);
 }
 
+static WpSpaPod *
+build_audio_format (WpSpaPod *rate, gint32 channels)
+{
+  g_autoptr (WpSpaPodBuilder) b = wp_spa_pod_builder_new_object (
+      "Spa:Pod:Object:Param:Format", "Format");
+  wp_spa_pod_builder_add (b,
+      "mediaType",    "K", "audio",
+      "mediaSubtype", "K", "raw",
+      "channels",     "i", channels,
+      NULL);
+  if (rate)
+    wp_spa_pod_builder_add (b, "rate", "P", rate, NULL);
+  return wp_spa_pod_builder_end (b);
+}
+
+static void
+test_spa_pod_intersects (void)
+{
+  g_autoptr (WpSpaPod) range = wp_spa_pod_new_choice (
+      "Range", "i", 48000, "i", 44100, "i", 96000, NULL);
+  g_autoptr (WpSpaPod) rate_48k = wp_spa_pod_new_int (48000);
+  g_autoptr (WpSpaPod) rate_22k = wp_spa_pod_new_int (22050);
+  g_autoptr (WpSpaPod) any_rate = build_audio_format (range, 2);
+  g_autoptr (WpSpaPod) stereo_48k = build_audio_format (rate_48k, 2);
+  g_autoptr (WpSpaPod) stereo_22k = build_audio_format (rate_22k, 2);
+  g_autoptr (WpSpaPod) surround_48k = build_audio_format (rate_48k, 6);
+  g_autoptr (WpSpaPod) stereo = build_audio_format (NULL, 2);
+
+  g_assert_true (wp_spa_pod_intersects (any_rate, stereo_48k));
+  g_assert_true (wp_spa_pod_intersects (stereo_48k, any_rate));
+  g_assert_false (wp_spa_pod_intersects (any_rate, stereo_22k));
+  g_assert_false (wp_spa_pod_intersects (stereo_48k, surround_48k));
+
+  /* unspecified properties accept any value */
+  g_assert_true (wp_spa_pod_intersects (stereo, stereo_22k));
+
+  /* same result as filtering */
+  {
+    g_autoptr (WpSpaPod) filtered = wp_spa_pod_filter (any_rate, stereo_48k);
+    g_autoptr (WpSpaPod) empty = wp_spa_pod_filter (any_rate, stereo_22k);
+    g_assert_nonnull (filtered);
+    g_assert_null (empty);
+  }
+}
+
+static WpSpaPod *
+build_scratch_props (WpCore *core, gfloat volume)
+{
+  g_autoptr (WpSpaPodBuilder) b = wp_spa_pod_builder_new_object (
+      "Spa:Pod:Object:Param:Props", "Props");
+  wp_spa_pod_builder_use_scratch (b, core);
+  wp_spa_pod_builder_add (b,
+      "volume", "f", volume,
+      "mute", "b", FALSE,
+      NULL);
+  return wp_spa_pod_builder_end (b);
+}
+
+static void
+test_spa_pod_scratch (void)
+{
+  g_autoptr (GMainContext) context = g_main_context_new ();
+  g_autoptr (WpCore) core = NULL;
+  g_autoptr (WpSpaPod) kept = NULL;
+  g_autoptr (WpSpaPod) pod = NULL;
+  const struct spa_pod *data = NULL;
+  gfloat volume = 0.0;
+
+  wp_init (WP_INIT_PIPEWIRE);
+  core = wp_core_new (context, NULL);
+
+  /* the memory of a dropped pod is reused by the next one */
+  pod = build_scratch_props (core, 0.1);
+  data = wp_spa_pod_get_spa_pod (pod);
+  g_clear_pointer (&pod, wp_spa_pod_unref);
+  pod = build_scratch_props (core, 0.2);
+  g_assert_true (wp_spa_pod_get_spa_pod (pod) == data);
+  g_assert_true (wp_spa_pod_get_object (pod, NULL, "volume", "f", &volume,
+      NULL));
+  g_assert_cmpfloat_with_epsilon (volume, 0.2, 0.001);
+
+  /* a pod that is kept alive is not overwritten by the next ones */
+  kept = g_steal_pointer (&pod);
+  pod = build_scratch_props (core, 0.3);
+  g_assert_true (wp_spa_pod_get_spa_pod (pod) != data);
+  g_clear_pointer (&pod, wp_spa_pod_unref);
+
+  /* nor by the next iteration */
+  while (g_main_context_iteration (context, FALSE));
+  pod = build_scratch_props (core, 0.4);
+  g_assert_true (wp_spa_pod_get_object (kept, NULL, "volume", "f", &volume,
+      NULL));
+  g_assert_cmpfloat_with_epsilon (volume, 0.2, 0.001);
+  g_clear_pointer (&pod, wp_spa_pod_unref);
+
+  /* builders that are opened while another one is open, or that grow
+     bigger than the scratch memory, move to the heap */
+  {
+    g_autoptr (WpSpaPodBuilder) outer = wp_spa_pod_builder_new_struct ();
+    g_autoptr (WpSpaPodBuilder) inner = wp_spa_pod_builder_new_array ();
+    g_autoptr (WpSpaPod) array = NULL;
+    g_autoptr (WpSpaPod) strukt = NULL;
+    g_autoptr (WpIterator) it = NULL;
+    g_auto (GValue) item = G_VALUE_INIT;
+    gint32 n = 0;
+
+    wp_spa_pod_builder_use_scratch (outer, core);
+    wp_spa_pod_builder_use_scratch (inner, core);
+
+    for (gint32 i = 0; i < 2048; i++)
+      wp_spa_pod_builder_add_int (inner, i);
+    array = wp_spa_pod_builder_end (inner);
+    wp_spa_pod_builder_add_pod (outer, array);
+    wp_spa_pod_builder_add_string (outer, "end");
+    strukt = wp_spa_pod_builder_end (outer);
+
+    g_assert_true (wp_spa_pod_is_struct (strukt));
+    it = wp_spa_pod_new_iterator (array);
+    for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
+      gint32 *v = g_value_get_pointer (&item);
+      g_assert_cmpint (*v, ==, n++);
+    }
+    g_assert_cmpint (n, ==, 2048);
+  }
+
+  /* pods outlive the core */
+  g_clear_object (&core);
+  g_assert_true (wp_spa_pod_get_object (kept, NULL, "volume", "f", &volume,
+      NULL));
+  g_assert_cmpfloat_with_epsilon (volume, 0.2, 0.001);
+}
+
+static void
+build_and_parse_props_pods (guint n)
+{
+  for (guint i = 0; i < n; i++) {
+    gboolean mute = TRUE;
+    float vol = 0.0;
+    gint32 frequency = 0;
+    const char *id_name, *device;
+    g_autoptr (WpSpaPodBuilder) b = wp_spa_pod_builder_new_object (
+        "Spa:Pod:Object:Param:Props", "Props");
+    wp_spa_pod_builder_add_property (b, "mute");
+    wp_spa_pod_builder_add_boolean (b, FALSE);
+    wp_spa_pod_builder_add_property (b, "volume");
+    wp_spa_pod_builder_add_float (b, 0.5);
+    wp_spa_pod_builder_add_property (b, "frequency");
+    wp_spa_pod_builder_add_int (b, 440);
+    wp_spa_pod_builder_add_property (b, "device");
+    wp_spa_pod_builder_add_string (b, "device-name");
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_builder_end (b);
+
+    g_assert_true (wp_spa_pod_get_object (pod,
+        &id_name,
+        "mute", "b", &mute,
+        "volume", "f", &vol,
+        "frequency", "i", &frequency,
+        "device", "s", &device,
+        NULL));
+    g_assert_cmpint (frequency, ==, 440);
+  }
+}
+
+/* run with -m perf */
+static void
+test_spa_pod_perf_build_parse (void)
+{
+  const guint n = 100000;
+  gdouble elapsed;
+
+  g_test_timer_start ();
+  build_and_parse_props_pods (n);
+  elapsed = g_test_timer_elapsed ();
+  g_test_message ("without type indexes: %.0f pods/s", n / elapsed);
+
+  wp_spa_dynamic_type_init ();
+  g_test_timer_start ();
+  build_and_parse_props_pods (n);
+  elapsed = g_test_timer_elapsed ();
+  wp_spa_dynamic_type_deinit ();
+  g_test_minimized_result (elapsed,
+      "with type indexes: %.0f pods/s", n / elapsed);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -1083,11 +1394,18 @@ main (int argc, char *argv[])
   g_test_add_func ("/wp/spa-pod/choice", test_spa_pod_choice);
   g_test_add_func ("/wp/spa-pod/array", test_spa_pod_array);
   g_test_add_func ("/wp/spa-pod/object", test_spa_pod_object);
+  g_test_add_func ("/wp/spa-pod/schema", test_spa_pod_schema);
   g_test_add_func ("/wp/spa-pod/struct", test_spa_pod_struct);
   g_test_add_func ("/wp/spa-pod/sequence", test_spa_pod_sequence);
   g_test_add_func ("/wp/spa-pod/iterator", test_spa_pod_iterator);
   g_test_add_func ("/wp/spa-pod/unique-owner", test_spa_pod_unique_owner);
   g_test_add_func ("/wp/spa-pod/port-config", test_spa_pod_port_config);
+  g_test_add_func ("/wp/spa-pod/scratch", test_spa_pod_scratch);
+  g_test_add_func ("/wp/spa-pod/intersects", test_spa_pod_intersects);
+
+  if (g_test_perf ())
+    g_test_add_func ("/wp/spa-pod/perf/build-parse",
+        test_spa_pod_perf_build_parse);
 
   return g_test_run ();
 }
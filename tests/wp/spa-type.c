@@ -374,6 +374,33 @@ test_spa_type_register (void)
     g_assert_false (wp_iterator_next (it, &value));
   }
 
+  /* the new entries are found by name */
+  g_assert_true (&custom_enum_info[1] ==
+      wp_spa_id_value_from_short_name ("Spa:Enum:CustomEnum", "Valid"));
+  g_assert_true (&custom_obj_info[3] ==
+      wp_spa_id_value_from_name ("Spa:Pod:Object:CustomObj:volume"));
+  g_assert_null (wp_spa_id_value_from_short_name ("Spa:Pod:Object:CustomObj",
+          "none"));
+
+  /* and so are those of later registrations, which may move the earlier
+     entries in memory */
+  for (guint i = 0; i < 64; i++)
+    wp_spa_dynamic_type_register ("Spa:Pod:Object:CustomObj:Filler",
+        SPA_TYPE_Object, custom_obj_info);
+  g_assert_cmpuint (obj_type, ==,
+      wp_spa_type_from_name ("Spa:Pod:Object:CustomObj"));
+  g_assert_cmpuint (obj_type + 1, ==,
+      wp_spa_type_from_name ("Spa:Pod:Object:CustomObj:Filler"));
+  g_assert_cmpstr (wp_spa_type_name (obj_type), ==, "Spa:Pod:Object:CustomObj");
+
+  wp_spa_dynamic_type_deinit ();
+}
+
+static void
+test_spa_type_basic_indexed (void)
+{
+  wp_spa_dynamic_type_init ();
+  test_spa_type_basic ();
   wp_spa_dynamic_type_deinit ();
 }
 
@@ -384,6 +411,7 @@ main (int argc, char *argv[])
   g_log_set_writer_func (wp_log_writer_default, NULL, NULL);
 
   g_test_add_func ("/wp/spa-type/basic", test_spa_type_basic);
+  g_test_add_func ("/wp/spa-type/basic-indexed", test_spa_type_basic_indexed);
   g_test_add_func ("/wp/spa-type/iterate", test_spa_type_iterate);
   g_test_add_func ("/wp/spa-type/register", test_spa_type_register);
 
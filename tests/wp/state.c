@@ -7,6 +7,7 @@
  */
 
 #include <wp/wp.h>
+#include <glib/gstdio.h>
 
 static void
 test_state_basic (void)
@@ -202,6 +203,140 @@ test_state_escaped (void)
   wp_state_clear (state);
 }
 
+static void
+test_state_deferred (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (WpState) state = wp_state_new ("deferred");
+  g_autoptr (WpState) state2 = wp_state_new ("deferred");
+  g_assert_nonnull (state);
+
+  /* Save a few times; only the last one matters */
+  for (guint i = 0; i < 10; i++) {
+    g_autoptr (WpProperties) props = wp_properties_new_empty ();
+    g_autofree gchar *val = g_strdup_printf ("value%u", i);
+    wp_properties_set (props, "key", val);
+    wp_properties_set (props, "key with spaces", "[v]");
+    wp_state_save_deferred (i % 2 ? state2 : state, props);
+  }
+
+  /* Load, possibly before the data is on the disk */
+  {
+    g_autoptr (WpProperties) props = wp_state_load (state);
+    g_assert_nonnull (props);
+    g_assert_cmpstr (wp_properties_get (props, "key"), ==, "value9");
+    g_assert_cmpstr (wp_properties_get (props, "key with spaces"), ==, "[v]");
+  }
+
+  g_assert_true (wp_state_flush (state, &error));
+  g_assert_no_error (error);
+
+  /* Verify the file contents */
+  {
+    g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+    g_autofree gchar *val = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autoptr (GDir) gdir = NULL;
+    const gchar *name;
+
+    g_assert_true (g_key_file_load_from_file (keyfile,
+            wp_state_get_location (state), G_KEY_FILE_NONE, NULL));
+    val = g_key_file_get_string (keyfile, "deferred", "key", NULL);
+    g_assert_cmpstr (val, ==, "value9");
+
+    /* no temporary files are left behind */
+    dir = g_path_get_dirname (wp_state_get_location (state));
+    gdir = g_dir_open (dir, 0, NULL);
+    g_assert_nonnull (gdir);
+    while ((name = g_dir_read_name (gdir)))
+      g_assert_false (g_str_has_prefix (name, "deferred."));
+  }
+
+  wp_state_clear (state);
+
+  /* Load empty */
+  {
+    g_autoptr (WpProperties) props = wp_state_load (state2);
+    g_assert_nonnull (props);
+    g_assert_null (wp_properties_get (props, "key"));
+  }
+
+  wp_state_flush_all ();
+}
+
+static void
+test_state_retry (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (WpState) state = wp_state_new ("retry");
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  const gchar *location = wp_state_get_location (state);
+
+  wp_properties_set (props, "key", "value");
+
+  /* a directory in place of the file makes the write fail */
+  g_assert_cmpint (g_mkdir_with_parents (location, 0700), ==, 0);
+  g_assert_false (wp_state_save (state, props, &error));
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+
+  /* the failure is reported to every waiter */
+  g_assert_false (wp_state_flush (state, &error));
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+  g_assert_false (wp_state_flush (state, NULL));
+
+  /* saving the same content again retries the write */
+  g_assert_cmpint (g_rmdir (location), ==, 0);
+  wp_state_save_deferred (state, props);
+  g_assert_true (wp_state_flush (state, &error));
+  g_assert_no_error (error);
+  g_assert_true (g_file_test (location, G_FILE_TEST_IS_REGULAR));
+
+  wp_state_clear (state);
+}
+
+static void
+test_state_external_change (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (WpState) state = wp_state_new ("external");
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  const gchar *location = wp_state_get_location (state);
+
+  wp_properties_set (props, "key", "value");
+  wp_state_save_deferred (state, props);
+  g_assert_true (wp_state_flush (state, &error));
+  g_assert_no_error (error);
+
+  /* the file is changed by someone else once nothing is pending */
+  g_assert_true (g_file_set_contents (location,
+          "[external]\nkey=other\n", -1, &error));
+  g_assert_no_error (error);
+
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (state);
+    g_assert_cmpstr (wp_properties_get (loaded, "key"), ==, "other");
+  }
+
+  /* saving the previous content again is not skipped */
+  wp_state_save_deferred (state, props);
+  g_assert_true (wp_state_flush (state, &error));
+  g_assert_no_error (error);
+
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (state);
+    g_assert_cmpstr (wp_properties_get (loaded, "key"), ==, "value");
+  }
+
+  /* the file is removed by someone else */
+  g_assert_cmpint (g_unlink (location), ==, 0);
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (state);
+    g_assert_null (wp_properties_get (loaded, "key"));
+  }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -212,6 +347,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/wp/state/empty", test_state_empty);
   g_test_add_func ("/wp/state/spaces", test_state_spaces);
   g_test_add_func ("/wp/state/escaped", test_state_escaped);
+  g_test_add_func ("/wp/state/deferred", test_state_deferred);
+  g_test_add_func ("/wp/state/retry", test_state_retry);
+  g_test_add_func ("/wp/state/external-change", test_state_external_change);
 
   return g_test_run ();
 }
@@ -0,0 +1,149 @@
+/* WirePlumber
+ *
+ * Copyright © 2023 The WirePlumber project contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+
+typedef struct {
+  WpBaseTestFixture base;
+  WpObjectManager *om;
+  guint n_fallback_added;
+  guint n_fallback_wanted;
+} TestFixture;
+
+static void
+test_fallback_sink_setup (TestFixture *f, gconstpointer data)
+{
+  wp_base_test_fixture_setup (&f->base, WP_BASE_TEST_FLAG_CLIENT_CORE);
+
+  /* load modules on the server side */
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&f->base.server);
+
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-spa-node-factory", NULL, NULL));
+    g_assert_nonnull (pw_context_load_module (f->base.server.context,
+            "libpipewire-module-adapter", NULL, NULL));
+  }
+
+  /* the fallback sink is a local node of the script's core */
+  {
+    g_autoptr (GError) error = NULL;
+    wp_core_load_component (f->base.core,
+        "libpipewire-module-adapter", "pw_module", NULL, &error);
+    g_assert_no_error (error);
+  }
+}
+
+static void
+test_fallback_sink_teardown (TestFixture *f, gconstpointer data)
+{
+  g_clear_object (&f->om);
+  wp_base_test_fixture_teardown (&f->base);
+}
+
+static void
+on_fallback_added (WpObjectManager *om, WpNode *node, TestFixture *f)
+{
+  f->n_fallback_added++;
+  if (f->n_fallback_added == f->n_fallback_wanted)
+    g_main_loop_quit (f->base.loop);
+}
+
+static void
+wait_for_fallback (TestFixture *f, guint n)
+{
+  f->n_fallback_wanted = n;
+  if (f->n_fallback_added < n)
+    g_main_loop_run (f->base.loop);
+  g_assert_cmpuint (f->n_fallback_added, ==, n);
+}
+
+static gboolean
+quit_loop (GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+test_fallback_sink_remove_sink (TestFixture *f, gconstpointer data)
+{
+  g_autoptr (WpPlugin) plugin = NULL;
+  g_autoptr (WpNode) sink = NULL;
+  g_autoptr (GError) error = NULL;
+
+  if (!test_is_spa_lib_installed (&f->base, "support.null-audio-sink")) {
+    g_test_skip ("The pipewire null-audio-sink factory was not found");
+    return;
+  }
+
+  f->om = wp_object_manager_new ();
+  wp_object_manager_add_interest (f->om, WP_TYPE_NODE,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "node.name", "=s", "auto_null",
+      NULL);
+  g_signal_connect (f->om, "object-added", G_CALLBACK (on_fallback_added), f);
+  wp_core_install_object_manager (f->base.client_core, f->om);
+
+  wp_core_load_component (f->base.core,
+      "libwireplumber-module-lua-scripting", "module", NULL, &error);
+  g_assert_no_error (error);
+
+  plugin = wp_plugin_find (f->base.core, "lua-scripting");
+  wp_object_activate (WP_OBJECT (plugin), WP_PLUGIN_FEATURE_ENABLED,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+  g_clear_object (&plugin);
+
+  wp_core_load_component (f->base.core, "fallback-sink.lua", "script/lua",
+      NULL, &error);
+  g_assert_no_error (error);
+
+  plugin = wp_plugin_find (f->base.core, "script:fallback-sink.lua");
+  g_assert_nonnull (plugin);
+  wp_object_activate (WP_OBJECT (plugin), WP_PLUGIN_FEATURE_ENABLED,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  /* there are no sinks, so the fallback sink is created */
+  wait_for_fallback (f, 1);
+
+  /* add a real sink and let the script see it */
+  sink = wp_node_new_from_factory (f->base.client_core, "adapter",
+      wp_properties_new (
+          "factory.name", "support.null-audio-sink",
+          "node.name", "test-sink",
+          "media.class", "Audio/Sink",
+          NULL));
+  g_assert_nonnull (sink);
+  wp_object_activate (WP_OBJECT (sink), WP_OBJECT_FEATURES_ALL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, f);
+  g_main_loop_run (f->base.loop);
+
+  wp_core_timeout_add (f->base.core, NULL, 1500, (GSourceFunc) quit_loop,
+      f->base.loop, NULL);
+  g_main_loop_run (f->base.loop);
+  g_assert_cmpuint (f->n_fallback_added, ==, 1);
+
+  /* remove the sink; the script must notice and create the fallback again */
+  wp_global_proxy_request_destroy (WP_GLOBAL_PROXY (sink));
+  g_clear_object (&sink);
+  wait_for_fallback (f, 2);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/lua/fallback-sink/remove-sink", TestFixture, NULL,
+      test_fallback_sink_setup, test_fallback_sink_remove_sink,
+      test_fallback_sink_teardown);
+
+  return g_test_run ();
+}
@@ -0,0 +1,187 @@
+-- Tests the index that policy-node.lua uses to handle only the streams that
+-- are affected by an event, and compares the cost of handling an event
+-- against a full rescan of all the streams
+
+local LinkablesIndex = require("linkables-index")
+local key = LinkablesIndex.key
+
+local N_DEVICES = 50
+local N_STREAMS = 500
+local N_EVENTS = 200
+
+local index = LinkablesIndex.new()
+local next_id = 1
+local n_handled = 0
+
+local function newLinkable(props)
+  local si = { id = next_id, properties = props }
+  next_id = next_id + 1
+  return si
+end
+
+-- a simplified handleLinkable(): looks up the defined target,
+-- falls back to the default one and records the dependencies
+local function handle(si)
+  n_handled = n_handled + 1
+  index:clearDeps(si.id)
+
+  local target_name = si.properties["target.object"]
+  if target_name then
+    index:addDep(si.id, key("node.name", target_name))
+    local target = index:lookupFirst("node.name", target_name)
+    if target then
+      index:addDep(si.id, key("link", target.id))
+      return target
+    end
+  end
+
+  index:addDep(si.id, "default")
+  return index:get(1)
+end
+
+local function rescan()
+  for _, si in ipairs(index:takeDirty()) do
+    if si.properties["item.node.type"] == "stream" then
+      handle(si)
+    end
+  end
+end
+
+-- the equivalent of the previous policy, which handled all the streams
+-- on every event and looked up targets by iterating over all the linkables
+local function fullRescan(linkables)
+  for _, si in ipairs(linkables) do
+    local name = si.properties["target.object"]
+    if si.properties["item.node.type"] == "stream" and name then
+      for _, target in ipairs(linkables) do
+        if target.properties["node.name"] == name then
+          break
+        end
+      end
+    end
+  end
+end
+
+local linkables = {}
+local function add(props)
+  local si = newLinkable(props)
+  table.insert(linkables, si)
+  index:addLinkable(si.id, si, props)
+  return si
+end
+
+for i = 1, N_DEVICES do
+  add {
+    ["item.node.type"] = "device",
+    ["node.name"] = "device" .. i,
+    ["node.id"] = tostring(1000 + i),
+  }
+end
+
+local streams = {}
+for i = 1, N_STREAMS do
+  -- every tenth stream follows the default target,
+  -- the others target one of the devices
+  local props = {
+    ["item.node.type"] = "stream",
+    ["node.name"] = "stream" .. i,
+    ["node.id"] = tostring(2000 + i),
+  }
+  if i % 10 ~= 0 then
+    props["target.object"] = "device" .. (i % N_DEVICES + 1)
+  end
+  table.insert(streams, add(props))
+end
+
+rescan()
+assert(n_handled == N_STREAMS)
+assert(not index:hasDirty())
+
+-- index lookups
+assert(index:lookupFirst("node.name", "device3").properties["node.id"] == "1003")
+assert(index:lookupFirst("node.id", 2001) == streams[1])
+assert(index:lookupFirst("node.name", "nonexistent") == nil)
+
+-- a default change affects only the streams that use the default target
+n_handled = 0
+index:markKey("default")
+rescan()
+assert(n_handled == N_STREAMS / 10)
+
+-- a link change affects only the streams that target one of its sides
+n_handled = 0
+local link = { id = 10000 }
+index:addLink(link, streams[1].id, 2)
+rescan()
+-- the streams that target device2 (i % 50 == 1), including stream1 itself
+assert(n_handled == N_STREAMS / N_DEVICES)
+n_handled = 0
+index:removeLink(link, streams[1].id, 2)
+rescan()
+assert(n_handled == N_STREAMS / N_DEVICES)
+
+-- removing a target affects only the streams that targeted it,
+-- which are then found to depend on the default target
+n_handled = 0
+local device5 = index:lookupFirst("node.name", "device5")
+index:removeLinkable(device5.id)
+rescan()
+assert(n_handled == N_STREAMS / N_DEVICES)
+n_handled = 0
+index:markKey("default")
+rescan()
+assert(n_handled == N_STREAMS / 10 + N_STREAMS / N_DEVICES)
+
+-- adding it back brings them back to it
+n_handled = 0
+index:addLinkable(device5.id, device5, device5.properties)
+rescan()
+assert(n_handled == N_STREAMS / N_DEVICES)
+
+-- removing a stream drops its dependencies
+index:removeLinkable(streams[N_STREAMS].id)
+n_handled = 0
+index:markKey("default")
+rescan()
+assert(n_handled == N_STREAMS / 10 - 1)
+
+-- a dirty id that is gone does not hide the dirty ids that sort after it;
+-- removing a link marks its sides even if they have been removed already
+local gone = streams[1]
+local l = { id = 10001 }
+index:addLink(l, gone.id, streams[2].id)
+rescan()
+index:removeLinkable(gone.id)
+index:removeLink(l, gone.id, streams[2].id)
+assert(index.dirty[gone.id])
+local taken = index:takeDirty()
+assert(#taken >= 1)
+local found = false
+for _, si in ipairs(taken) do
+  assert(si ~= gone)
+  if si == streams[2] then
+    found = true
+  end
+end
+assert(found)
+index:addLinkable(gone.id, gone, gone.properties)
+rescan()
+
+-- measure the cost of handling an event, compared to a full rescan
+local start = GLib.get_monotonic_time()
+for i = 1, N_EVENTS do
+  local l = { id = 20000 + i }
+  index:addLink(l, streams[i].id, (i % N_DEVICES) + 1)
+  rescan()
+end
+local incremental = GLib.get_monotonic_time() - start
+
+start = GLib.get_monotonic_time()
+for i = 1, N_EVENTS do
+  fullRescan(linkables)
+end
+local full = GLib.get_monotonic_time() - start
+
+Log.info(string.format(
+    "%d events on %d streams: incremental %d us, full rescan %d us",
+    N_EVENTS, N_STREAMS, incremental, full))
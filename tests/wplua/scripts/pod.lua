@@ -249,3 +249,50 @@ assert (val.properties["id-02000000"].properties.device == "my-sub-device")
 assert (val.properties["id-02000000"].properties["id-03000000"] == true)
 assert (val.properties["id-02000000"].properties["id-04000000"] == "string")
 assert (pod:get_type_name() == "Spa:Pod:Object:Param:Props")
+
+-- Schema
+local schema = Pod.Schema ("Spa:Pod:Object:Param:Props",
+    { "volume", "mute", "channelVolumes", "device", "id-01000000" })
+pod = Pod.Object {
+  "Spa:Pod:Object:Param:Props", "Props",
+  mute = true,
+  volume = 0.5,
+  channelVolumes = Pod.Array { "Spa:Float", 0.25, 0.75 },
+  ["id-01000000"] = Pod.Int (4),
+}
+local id, volume, mute, channelVolumes, device, custom = schema:parse (pod)
+assert (id == "Props")
+assert (volume == 0.5)
+assert (mute == true)
+assert (channelVolumes.pod_type == "Array")
+assert (channelVolumes[1] == 0.25)
+assert (channelVolumes[2] == 0.75)
+assert (device == nil)
+assert (custom == 4)
+
+pod = Pod.Object {
+  "Spa:Pod:Object:Param:Profile", "Profile",
+  index = 1,
+}
+assert (schema:parse (pod) == nil)
+
+local too_many = {}
+for i = 1, 65 do
+  too_many[i] = string.format ("id-%08x", 0x01000000 + i)
+end
+assert (not pcall (Pod.Schema, "Spa:Pod:Object:Param:Props", too_many))
+
+-- Pods that are kept alive stay valid after many more are built
+local kept = {}
+for i = 1, 500 do
+  kept[i] = Pod.Object {
+    "Spa:Pod:Object:Param:Props", "Props",
+    volume = i / 1000,
+    channelVolumes = Pod.Array { "Spa:Float", i / 1000, i / 1000 },
+  }
+end
+for i = 1, 500 do
+  local val = kept[i]:parse ()
+  assert (math.abs (val.properties.volume - i / 1000) < 0.0001)
+  assert (math.abs (val.properties.channelVolumes[2] - i / 1000) < 0.0001)
+end
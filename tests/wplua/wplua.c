@@ -240,6 +240,32 @@ l_test_object_new (lua_State * L)
   return 1;
 }
 
+typedef struct _TestItem TestItem;
+struct _TestItem
+{
+  WpSessionItem parent;
+};
+
+typedef struct _TestItemClass TestItemClass;
+struct _TestItemClass
+{
+  WpSessionItemClass parent_class;
+};
+
+G_DEFINE_TYPE (TestItem, test_item, WP_TYPE_SESSION_ITEM)
+
+#define TEST_TYPE_ITEM (test_item_get_type ())
+
+static void
+test_item_init (TestItem * self)
+{
+}
+
+static void
+test_item_class_init (TestItemClass * klass)
+{
+}
+
 static gboolean
 test_load_and_call (lua_State * L, const gchar *buf, gsize size,
     int nargs, int nres, GError **error)
@@ -668,6 +694,32 @@ test_wplua_convert_wp_properties ()
   wplua_unref (L);
 }
 
+static void
+test_wplua_convert_object_array ()
+{
+  g_autoptr (GError) error = NULL;
+  lua_State *L = wplua_new ();
+  g_auto (GValue) objects = G_VALUE_INIT;
+  g_autoptr (GPtrArray) objs = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_ptr_array_add (objs, g_object_new (TEST_TYPE_OBJECT, NULL));
+  g_ptr_array_add (objs, g_object_new (TEST_TYPE_OBJECT, NULL));
+
+  g_value_init (&objects, WP_TYPE_OBJECT_ARRAY);
+  g_value_set_boxed (&objects, objs);
+  wplua_gvalue_to_lua (L, &objects);
+  lua_setglobal (L, "objects");
+
+  const gchar code[] =
+    "assert (type (objects) == 'table')\n"
+    "assert (#objects == 2)\n"
+    "assert (type (objects[1]) == 'userdata')\n";
+  test_load_and_call (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  wplua_unref (L);
+}
+
 static void
 test_wplua_script_arguments ()
 {
@@ -702,6 +754,142 @@ test_wplua_script_arguments ()
   wplua_unref (L);
 }
 
+static void
+test_wplua_gc ()
+{
+  g_autoptr (TestObject) obj = g_object_new (TEST_TYPE_OBJECT, NULL);
+  g_autoptr (GError) error = NULL;
+  GClosure *closure;
+  WpLuaGcStats stats;
+  lua_State *L = wplua_new ();
+
+  const gchar code[] =
+    "function f()\n"
+    "  o = nil\n"
+    "end\n";
+  test_load_and_call (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  wplua_pushobject (L, g_object_ref (obj));
+  lua_setglobal (L, "o");
+  g_assert_cmpint (G_OBJECT (obj)->ref_count, ==, 2);
+
+  lua_getglobal (L, "f");
+  closure = wplua_function_to_closure (L, -1);
+  g_closure_ref (closure);
+  g_closure_sink (closure);
+  lua_pop (L, 1);
+
+  /* the garbage of the callback is collected on idle */
+  g_closure_invoke (closure, NULL, 0, NULL, NULL);
+  while (g_main_context_iteration (NULL, FALSE));
+  g_assert_cmpint (G_OBJECT (obj)->ref_count, ==, 1);
+
+  wplua_get_gc_stats (L, &stats);
+  g_assert_cmpuint (stats.heap_size, >, 0);
+  g_assert_cmpuint (stats.n_steps, >, 0);
+  g_assert_cmpuint (stats.n_cycles, >, 0);
+
+  wplua_unref (L);
+  g_closure_unref (closure);
+}
+
+static void
+test_wplua_properties_cache ()
+{
+  g_autoptr (WpSessionItem) item = g_object_new (TEST_TYPE_ITEM, NULL);
+  g_autoptr (GError) error = NULL;
+  lua_State *L = wplua_new ();
+
+  wp_session_item_set_properties (item,
+      wp_properties_new ("test.key", "1", NULL));
+  wplua_pushobject (L, g_object_ref (item));
+  lua_setglobal (L, "item");
+
+  /* the same table is returned while the properties don't change */
+  const gchar code[] =
+    "p = item.properties\n"
+    "assert (p['test.key'] == '1')\n"
+    "assert (p == item.properties)\n";
+  test_load_and_call (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  wp_session_item_set_properties (item,
+      wp_properties_new ("test.key", "2", NULL));
+
+  const gchar code2[] =
+    "local q = item.properties\n"
+    "assert (q ~= p)\n"
+    "assert (q['test.key'] == '2')\n"
+    "assert (q == item.properties)\n"
+    "assert (p['test.key'] == '1')\n";
+  test_load_and_call (L, code2, sizeof (code2) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  /* the cache entry goes away with the object */
+  lua_pushnil (L);
+  lua_setglobal (L, "item");
+  lua_gc (L, LUA_GCCOLLECT, 0);
+  g_assert_cmpint (G_OBJECT (item)->ref_count, ==, 1);
+  g_clear_object (&item);
+
+  wplua_unref (L);
+}
+
+static void
+test_wplua_method_dispatch ()
+{
+  const gint n_iterations = 100000;
+  g_autoptr (GError) error = NULL;
+  TestObject *obj;
+  gint64 start, elapsed;
+  lua_State *L = wplua_new ();
+
+  wplua_register_type_methods(L, TEST_TYPE_OBJECT,
+      l_test_object_new, l_test_object_methods);
+
+  /* unknown keys are not cached, only the ones that resolve */
+  const gchar code[] =
+    "o = TestObject_new()\n"
+    "assert (o.nonexistent == nil)\n"
+    "assert (o.nonexistent == nil)\n"
+    "assert (o['test-int'] == 0)\n";
+  test_load_and_call (L, code, sizeof (code) - 1, 0, 0, &error);
+  g_assert_no_error (error);
+
+  lua_pushliteral (L, "wplua_gobject_cache");
+  lua_gettable (L, LUA_REGISTRYINDEX);
+  g_assert_cmpint (lua_rawgetp (L, -1, GSIZE_TO_POINTER (TEST_TYPE_OBJECT)),
+      ==, LUA_TTABLE);
+  g_assert_cmpint (lua_getfield (L, -1, "nonexistent"), ==, LUA_TNIL);
+  g_assert_cmpint (lua_getfield (L, -2, "test-int"), ==, LUA_TLIGHTUSERDATA);
+  lua_pop (L, 4);
+
+  /* each iteration does a method call and a property read */
+  const gchar code2[] =
+    "for i = 1, n do\n"
+    "  o:toggle()\n"
+    "  local x = o['test-int']\n"
+    "end\n";
+  lua_pushinteger (L, n_iterations);
+  lua_setglobal (L, "n");
+
+  start = g_get_monotonic_time ();
+  test_load_and_call (L, code2, sizeof (code2) - 1, 0, 0, &error);
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+  g_assert_no_error (error);
+
+  g_assert_cmpint (lua_getglobal (L, "o"), ==, LUA_TUSERDATA);
+  obj = wplua_toobject (L, -1);
+  g_assert_false (obj->test_boolean);
+  lua_pop (L, 1);
+
+  g_test_message ("%d lookups in %" G_GINT64_FORMAT " us: %.0f lookups/s",
+      2 * n_iterations, elapsed, 2 * n_iterations * 1e6 / elapsed);
+
+  wplua_unref (L);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -711,6 +899,8 @@ main (gint argc, gchar *argv[])
   g_test_add_func ("/wplua/basic", test_wplua_basic);
   g_test_add_func ("/wplua/construct", test_wplua_construct);
   g_test_add_func ("/wplua/properties", test_wplua_properties);
+  g_test_add_func ("/wplua/properties/cache", test_wplua_properties_cache);
+  g_test_add_func ("/wplua/method_dispatch", test_wplua_method_dispatch);
   g_test_add_func ("/wplua/closure", test_wplua_closure);
   g_test_add_func ("/wplua/signals", test_wplua_signals);
   g_test_add_func ("/wplua/sandbox/script", test_wplua_sandbox_script);
@@ -720,7 +910,10 @@ main (gint argc, gchar *argv[])
       test_wplua_convert_gvariant_array);
   g_test_add_func ("/wplua/convert/wp_properties",
       test_wplua_convert_wp_properties);
+  g_test_add_func ("/wplua/convert/object_array",
+      test_wplua_convert_object_array);
   g_test_add_func ("/wplua/script_arguments", test_wplua_script_arguments);
+  g_test_add_func ("/wplua/gc", test_wplua_gc);
 
   return g_test_run ();
 }